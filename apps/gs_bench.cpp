@@ -0,0 +1,826 @@
+#include <args/args.hxx>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#include <eigen3/Eigen/Dense>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cpuraster.h>
+#include <cpusort.h>
+#include <gaussiancloud.h>
+#include <splathalf.h>
+#include <splatmath.h>
+#include <threadpool.h>
+
+// Headless CPU benchmarks, does not need a window or a GPU.
+
+static double TimeSeconds(const std::function<void()>& func) {
+    auto start = std::chrono::high_resolution_clock::now();
+    func();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+static bool BenchImport(const std::string& plyFile, int iterations, bool importFullSH) {
+    struct Variant {
+        const char* name;
+        bool serialImport;
+        bool genericImport;
+        bool planarLayout;
+    };
+    const Variant variants[] = {
+        { "generic, 1 thread", true, true, false },
+        { "specialized, 1 thread", true, false, false },
+        { "generic, all threads", false, true, false },
+        { "specialized, all threads", false, false, false },
+        { "specialized, planar", false, false, true },
+    };
+
+    spdlog::info("== import {} ({} iterations, {} kernels)", plyFile, iterations, GetSplatMathISA());
+    for (const Variant& variant : variants) {
+        GaussianCloud::Options options = {0};
+        options.importFullSH = importFullSH;
+        options.serialImport = variant.serialImport;
+        options.genericImport = variant.genericImport;
+        options.planarLayout = variant.planarLayout;
+
+        double bestSeconds = std::numeric_limits<double>::max();
+        size_t numGaussians = 0;
+        for (int i = 0; i < iterations; i++) {
+            GaussianCloud gaussianCloud(options);
+            bool ok = true;
+            double seconds = TimeSeconds([&]() { ok = gaussianCloud.ImportPly(plyFile); });
+            if (!ok) {
+                return false;
+            }
+            bestSeconds = std::min(bestSeconds, seconds);
+            numGaussians = gaussianCloud.GetNumGaussians();
+        }
+        spdlog::info("{:>26}: {:8.2f} ns/vertex ({:.3f} s)", variant.name, bestSeconds * 1.0e9 / numGaussians, bestSeconds);
+    }
+    return true;
+}
+
+// max |R * S * S^T * R^T - cov| over the 6 unique entries, relative to the trace of cov
+static double CovError(const float* cov, const Eigen::Matrix3d& V, const Eigen::Vector3d& eigenValues) {
+    Eigen::Matrix3d recon = V * eigenValues.asDiagonal() * V.transpose();
+    const int rows[6] = { 0, 0, 0, 1, 1, 2 };
+    const int cols[6] = { 0, 1, 2, 1, 2, 2 };
+    double trace = (double)cov[0] + cov[3] + cov[5];
+    double err = 0.0;
+    for (int k = 0; k < 6; k++) {
+        err = std::max(err, std::abs(recon(rows[k], cols[k]) - cov[k]) / trace);
+    }
+    return err;
+}
+
+// the batched Jacobi solver used by ExportPly on alpha and the upper triangle of cov3 as structure-of-arrays
+static void DecomposeJacobi(std::vector<float>& alpha, std::vector<float> cov[6], std::vector<float>& opacity,
+                            std::vector<float> logScale[3], std::vector<float> rot[4]) {
+    const size_t count = alpha.size();
+    opacity.resize(count);
+    for (int k = 0; k < 3; k++) {
+        logScale[k].resize(count);
+    }
+    for (int k = 0; k < 4; k++) {
+        rot[k].resize(count);
+    }
+    for (size_t begin = 0; begin < count; begin += SPLAT_BATCH_SIZE) {
+        SplatActivatedBatch in = { &alpha[begin], { &cov[0][begin], &cov[1][begin], &cov[2][begin], &cov[3][begin], &cov[4][begin], &cov[5][begin] } };
+        SplatParamsBatch out = { &opacity[begin], { &logScale[0][begin], &logScale[1][begin], &logScale[2][begin] },
+                                 { &rot[0][begin], &rot[1][begin], &rot[2][begin], &rot[3][begin] } };
+        DeactivateSplats(in, out, std::min(SPLAT_BATCH_SIZE, count - begin));
+    }
+}
+
+static void DecomposeEigen(const std::vector<float> cov[6], std::vector<Eigen::Matrix3f>& eigenVectors,
+                           std::vector<Eigen::Vector3f>& eigenValues) {
+    const size_t count = cov[0].size();
+    eigenVectors.resize(count);
+    eigenValues.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        Eigen::Matrix3f V;
+        V << cov[0][i], cov[1][i], cov[2][i],
+             cov[1][i], cov[3][i], cov[4][i],
+             cov[2][i], cov[4][i], cov[5][i];
+        Eigen::SelfAdjointEigenSolver<Eigen::Matrix3f> solver(V);
+        eigenVectors[i] = solver.eigenvectors();
+        eigenValues[i] = solver.eigenvalues();
+    }
+}
+
+// reconstruction error of both solvers, splats the jacobi solver turned into nan or inf are counted separately
+// largest error/trace the batched jacobi may reach, or its max error relative to eigen's when that is larger
+static const double DECOMPOSE_MAX_ERROR = 1.0e-5;
+static const double DECOMPOSE_MAX_ERROR_VS_EIGEN = 4.0;
+
+// Logs the errors of both solvers, returns false if the jacobi results are non finite or out of tolerance.
+static bool CheckDecomposeErrors(const char* name, const std::vector<float> cov[6], double jacobiSeconds, double eigenSeconds,
+                                 const std::vector<float> logScale[3], const std::vector<float> rot[4],
+                                 const std::vector<Eigen::Matrix3f>& eigenVectors, const std::vector<Eigen::Vector3f>& eigenValues) {
+    const size_t count = cov[0].size();
+    double jacobiMaxErr = 0.0, jacobiSumErr = 0.0;
+    double eigenMaxErr = 0.0, eigenSumErr = 0.0;
+    size_t numNonFinite = 0;
+    for (size_t i = 0; i < count; i++) {
+        const float c[6] = { cov[0][i], cov[1][i], cov[2][i], cov[3][i], cov[4][i], cov[5][i] };
+
+        Eigen::Quaterniond q(rot[0][i], rot[1][i], rot[2][i], rot[3][i]);
+        Eigen::Vector3d s(std::exp(2.0 * logScale[0][i]), std::exp(2.0 * logScale[1][i]), std::exp(2.0 * logScale[2][i]));
+        double err = CovError(c, q.toRotationMatrix(), s);
+        if (std::isfinite(err)) {
+            jacobiMaxErr = std::max(jacobiMaxErr, err);
+            jacobiSumErr += err;
+        } else {
+            numNonFinite++;
+        }
+
+        err = CovError(c, eigenVectors[i].cast<double>(), eigenValues[i].cast<double>().cwiseMax(0.0));
+        eigenMaxErr = std::max(eigenMaxErr, err);
+        eigenSumErr += err;
+    }
+
+    spdlog::info("== decompose {} {} covariances ({} kernels)", count, name, GetSplatMathISA());
+    spdlog::info("{:>26}: {:8.2f} ns/splat, error/trace max {:.3g} mean {:.3g}, {} non finite", "batched jacobi",
+                 jacobiSeconds * 1.0e9 / count, jacobiMaxErr, jacobiSumErr / count, numNonFinite);
+    spdlog::info("{:>26}: {:8.2f} ns/splat, error/trace max {:.3g} mean {:.3g}", "eigen",
+                 eigenSeconds * 1.0e9 / count, eigenMaxErr, eigenSumErr / count);
+
+    const double maxErr = std::max(DECOMPOSE_MAX_ERROR, DECOMPOSE_MAX_ERROR_VS_EIGEN * eigenMaxErr);
+    if (numNonFinite > 0 || jacobiMaxErr > maxErr) {
+        spdlog::error("batched jacobi failed on the {} covariances: max error/trace {:.3g} (limit {:.3g}), {} non finite",
+                      name, jacobiMaxErr, maxErr, numNonFinite);
+        return false;
+    }
+    return true;
+}
+
+// Covariances real scenes rarely contain, with a random rotation or axis aligned: repeated eigenvalues (spheres
+// and discs), zero eigenvalues (flat splats and needles) and both at once.
+static void MakeDegenerateCovs(size_t count, std::vector<float>& alpha, std::vector<float> cov[6]) {
+    std::mt19937 rng(1234);
+    std::normal_distribution<double> normal;
+    std::uniform_real_distribution<double> logVariance(-6.0, 0.0);
+    alpha.assign(count, 0.5f);
+    for (int k = 0; k < 6; k++) {
+        cov[k].resize(count);
+    }
+    for (size_t i = 0; i < count; i++) {
+        double a = std::pow(10.0, logVariance(rng));
+        double b = std::pow(10.0, logVariance(rng));
+        Eigen::Vector3d s;
+        switch (i % 5) {
+        case 0: s = Eigen::Vector3d(a, a, a); break;  // sphere, all repeated
+        case 1: s = Eigen::Vector3d(a, a, b); break;  // two repeated
+        case 2: s = Eigen::Vector3d(a, b, 0.0); break;  // flat
+        case 3: s = Eigen::Vector3d(a, a, 0.0); break;  // flat disc, repeated and zero
+        default: s = Eigen::Vector3d(a, 0.0, 0.0); break;  // needle, repeated zeros
+        }
+
+        // every fourth one of each kind stays axis aligned, where the off diagonals are exactly zero
+        Eigen::Matrix3d R = Eigen::Matrix3d::Identity();
+        if ((i / 5) % 4 != 0) {
+            R = Eigen::Quaterniond(normal(rng), normal(rng), normal(rng), normal(rng)).normalized().toRotationMatrix();
+        }
+        Eigen::Matrix3d C = R * s.asDiagonal() * R.transpose();
+        cov[0][i] = (float)C(0, 0); cov[1][i] = (float)C(0, 1); cov[2][i] = (float)C(0, 2);
+        cov[3][i] = (float)C(1, 1); cov[4][i] = (float)C(1, 2); cov[5][i] = (float)C(2, 2);
+    }
+}
+
+// Compares the batched Jacobi solver used by ExportPly against Eigen::SelfAdjointEigenSolver,
+// on the covariances of the ply and on synthetic degenerate ones.
+static bool BenchDecompose(const std::string& plyFile, int iterations) {
+    GaussianCloud::Options options = {0};
+    GaussianCloud gaussianCloud(options);
+    if (!gaussianCloud.ImportPly(plyFile)) {
+        return false;
+    }
+
+    // gather alpha and the upper triangle of cov3 as structure-of-arrays
+    const size_t numGaussians = gaussianCloud.GetNumGaussians();
+    const uint8_t* rawPtr = (const uint8_t*)gaussianCloud.GetRawDataPtr();
+    const size_t stride = gaussianCloud.GetStride();
+    std::vector<float> alpha(numGaussians);
+    std::vector<float> cov[6];
+    for (auto& c : cov) {
+        c.resize(numGaussians);
+    }
+    for (size_t i = 0; i < numGaussians; i++) {
+        const uint8_t* ptr = rawPtr + i * stride;
+        const float* col0 = gaussianCloud.GetCov3_Col0Attrib().Get<float>(ptr);
+        const float* col1 = gaussianCloud.GetCov3_Col1Attrib().Get<float>(ptr);
+        const float* col2 = gaussianCloud.GetCov3_Col2Attrib().Get<float>(ptr);
+        alpha[i] = gaussianCloud.GetPosWithAlphaAttrib().Get<float>(ptr)[3];
+        cov[0][i] = col0[0]; cov[1][i] = col0[1]; cov[2][i] = col0[2];
+        cov[3][i] = col1[1]; cov[4][i] = col1[2]; cov[5][i] = col2[2];
+    }
+
+    std::vector<float> opacity;
+    std::vector<float> logScale[3];
+    std::vector<float> rot[4];
+    std::vector<Eigen::Matrix3f> eigenVectors;
+    std::vector<Eigen::Vector3f> eigenValues;
+
+    double jacobiSeconds = std::numeric_limits<double>::max();
+    for (int iter = 0; iter < iterations; iter++) {
+        jacobiSeconds = std::min(jacobiSeconds, TimeSeconds([&]() { DecomposeJacobi(alpha, cov, opacity, logScale, rot); }));
+    }
+    double eigenSeconds = std::numeric_limits<double>::max();
+    for (int iter = 0; iter < iterations; iter++) {
+        eigenSeconds = std::min(eigenSeconds, TimeSeconds([&]() { DecomposeEigen(cov, eigenVectors, eigenValues); }));
+    }
+    bool ok = CheckDecomposeErrors("ply", cov, jacobiSeconds, eigenSeconds, logScale, rot, eigenVectors, eigenValues);
+
+    // accuracy only, the timing of the ply covariances is the one that matters
+    MakeDegenerateCovs(16 * SPLAT_BATCH_SIZE, alpha, cov);
+    jacobiSeconds = TimeSeconds([&]() { DecomposeJacobi(alpha, cov, opacity, logScale, rot); });
+    eigenSeconds = TimeSeconds([&]() { DecomposeEigen(cov, eigenVectors, eigenValues); });
+    ok = CheckDecomposeErrors("degenerate", cov, jacobiSeconds, eigenSeconds, logScale, rot, eigenVectors, eigenValues) && ok;
+    return ok;
+}
+
+// peak signal to noise ratio in dB of the squared error sum over count values
+static double PSNR(double sumSqErr, size_t count, double peak) {
+    double mse = sumSqErr / std::max(count, (size_t)1);
+    return mse > 0.0 ? 10.0 * std::log10(peak * peak / mse) : std::numeric_limits<double>::infinity();
+}
+
+// Round trips the ply through the compressed .gsz format and reports the size and the error of each attribute.
+static bool BenchCompress(const std::string& plyFile, int iterations, bool importFullSH) {
+    GaussianCloud::Options options = {0};
+    options.importFullSH = importFullSH;
+    options.exportFullSH = true;
+    options.keepRotScale = true;
+    GaussianCloud original(options);
+    if (!original.ImportPly(plyFile)) {
+        return false;
+    }
+
+    const std::string gszFile = (std::filesystem::temp_directory_path() / "gs_bench.gsz").string();
+    GaussianCloud decoded(options);
+    double exportSeconds = std::numeric_limits<double>::max();
+    double importSeconds = std::numeric_limits<double>::max();
+    for (int i = 0; i < iterations; i++) {
+        bool ok = true;
+        exportSeconds = std::min(exportSeconds, TimeSeconds([&]() { ok = original.ExportCompressed(gszFile); }));
+        if (!ok) {
+            return false;
+        }
+        importSeconds = std::min(importSeconds, TimeSeconds([&]() { ok = decoded.ImportCompressed(gszFile); }));
+        if (!ok) {
+            return false;
+        }
+    }
+
+    const size_t numGaussians = original.GetNumGaussians();
+    const size_t plySize = std::filesystem::file_size(plyFile);
+    const size_t gszSize = std::filesystem::file_size(gszFile);
+    std::filesystem::remove(gszFile);
+
+    // positions are compared against the scene extent, colors after evaluating the dc term like the shaders do
+    float aabbMin[3] = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+    float aabbMax[3] = { -aabbMin[0], -aabbMin[1], -aabbMin[2] };
+    original.ForEachPosWithAlpha([&](const float* pos) {
+        for (int k = 0; k < 3; k++) {
+            aabbMin[k] = std::min(aabbMin[k], pos[k]);
+            aabbMax[k] = std::max(aabbMax[k], pos[k]);
+        }
+    });
+    double extentSq = 0.0;
+    for (int k = 0; k < 3; k++) {
+        extentSq += (double)(aabbMax[k] - aabbMin[k]) * (aabbMax[k] - aabbMin[k]);
+    }
+    const double extent = std::sqrt(extentSq);
+
+    const float SH_C0 = 0.28209479177387814f;
+    const bool fullSH = original.HasFullSH() && decoded.HasFullSH();
+    double posErr = 0.0, alphaErr = 0.0, colorErr = 0.0, shErr = 0.0, shPeak = 0.0, covMaxErr = 0.0;
+    const uint8_t* aPtr = (const uint8_t*)original.GetRawDataPtr();
+    const uint8_t* bPtr = (const uint8_t*)decoded.GetRawDataPtr();
+    for (size_t i = 0; i < numGaussians; i++) {
+        const uint8_t* a = aPtr + i * original.GetStride();
+        const uint8_t* b = bPtr + i * decoded.GetStride();
+        const float* aPos = original.GetPosWithAlphaAttrib().Get<float>(a);
+        const float* bPos = decoded.GetPosWithAlphaAttrib().Get<float>(b);
+        for (int k = 0; k < 3; k++) {
+            posErr += (double)(aPos[k] - bPos[k]) * (aPos[k] - bPos[k]);
+        }
+        alphaErr += (double)(aPos[3] - bPos[3]) * (aPos[3] - bPos[3]);
+
+        const BinaryAttribute* sh0Attribs[2][3] = {
+            { &original.GetR_SH0Attrib(), &original.GetG_SH0Attrib(), &original.GetB_SH0Attrib() },
+            { &decoded.GetR_SH0Attrib(), &decoded.GetG_SH0Attrib(), &decoded.GetB_SH0Attrib() }
+        };
+        const BinaryAttribute* sh1Attribs[2][3] = {
+            { &original.GetR_SH1Attrib(), &original.GetG_SH1Attrib(), &original.GetB_SH1Attrib() },
+            { &decoded.GetR_SH1Attrib(), &decoded.GetG_SH1Attrib(), &decoded.GetB_SH1Attrib() }
+        };
+        for (int k = 0; k < 3; k++) {
+            const float* aSH0 = sh0Attribs[0][k]->Get<float>(a);
+            const float* bSH0 = sh0Attribs[1][k]->Get<float>(b);
+            float aColor = std::clamp(0.5f + SH_C0 * aSH0[0], 0.0f, 1.0f);
+            float bColor = std::clamp(0.5f + SH_C0 * bSH0[0], 0.0f, 1.0f);
+            colorErr += (double)(aColor - bColor) * (aColor - bColor);
+            if (fullSH) {
+                // sh1..sh3 are contiguous, so they are compared as 12 floats
+                const float* aSH1 = sh1Attribs[0][k]->Get<float>(a);
+                const float* bSH1 = sh1Attribs[1][k]->Get<float>(b);
+                for (int j = 0; j < 15; j++) {
+                    float aValue = j < 3 ? aSH0[j + 1] : aSH1[j - 3];
+                    float bValue = j < 3 ? bSH0[j + 1] : bSH1[j - 3];
+                    shErr += (double)(aValue - bValue) * (aValue - bValue);
+                    shPeak = std::max(shPeak, 2.0 * std::abs(aValue));
+                }
+            }
+        }
+
+        const BinaryAttribute* covAttribs[2][3] = {
+            { &original.GetCov3_Col0Attrib(), &original.GetCov3_Col1Attrib(), &original.GetCov3_Col2Attrib() },
+            { &decoded.GetCov3_Col0Attrib(), &decoded.GetCov3_Col1Attrib(), &decoded.GetCov3_Col2Attrib() }
+        };
+        double trace = 0.0, err = 0.0;
+        for (int k = 0; k < 3; k++) {
+            const float* aCol = covAttribs[0][k]->Get<float>(a);
+            const float* bCol = covAttribs[1][k]->Get<float>(b);
+            trace += aCol[k];
+            for (int j = 0; j < 3; j++) {
+                err = std::max(err, (double)std::abs(aCol[j] - bCol[j]));
+            }
+        }
+        covMaxErr = std::max(covMaxErr, trace > 0.0 ? err / trace : 0.0);
+    }
+
+    spdlog::info("== compress {} gaussians ({} iterations)", numGaussians, iterations);
+    spdlog::info("{:>26}: {:.1f} MB ply -> {:.1f} MB gsz, {:.2f}x, {:.1f} bytes/splat", "size",
+                 plySize / 1.0e6, gszSize / 1.0e6, (double)plySize / std::max(gszSize, (size_t)1), (double)gszSize / std::max(numGaussians, (size_t)1));
+    spdlog::info("{:>26}: export {:8.2f} ns/splat, import {:8.2f} ns/splat", "time",
+                 exportSeconds * 1.0e9 / numGaussians, importSeconds * 1.0e9 / numGaussians);
+    spdlog::info("{:>26}: {:.1f} dB (peak = scene extent)", "position psnr", PSNR(posErr, numGaussians * 3, extent));
+    spdlog::info("{:>26}: {:.1f} dB", "alpha psnr", PSNR(alphaErr, numGaussians, 1.0));
+    spdlog::info("{:>26}: {:.1f} dB", "dc color psnr", PSNR(colorErr, numGaussians * 3, 1.0));
+    if (fullSH) {
+        spdlog::info("{:>26}: {:.1f} dB (peak = coefficient range)", "sh rest psnr", PSNR(shErr, numGaussians * 45, shPeak));
+    }
+    spdlog::info("{:>26}: {:.3g}", "cov error/trace max", covMaxErr);
+    return true;
+}
+
+// SH basis for view direction v, same as ComputeRadianceFromSH() in splat_vert.glsl
+static void ComputeSHBasis(const float v[3], float b[16]) {
+    float vx2 = v[0] * v[0], vy2 = v[1] * v[1], vz2 = v[2] * v[2];
+    const float k1 = 0.4886025119029199f, k2 = 1.0925484305920792f, k3 = 0.31539156525252005f, k4 = 0.5462742152960396f;
+    const float k5 = 0.5900435899266435f, k6 = 2.8906114426405543f, k7 = 0.4570457994644658f, k8 = 0.37317633259011546f;
+    const float k9 = 1.4453057213202771f;
+    b[0] = 0.28209479177387814f;
+    b[1] = -k1 * v[1];
+    b[2] = k1 * v[2];
+    b[3] = -k1 * v[0];
+    b[4] = k2 * v[1] * v[0];
+    b[5] = -k2 * v[1] * v[2];
+    b[6] = k3 * (3.0f * vz2 - 1.0f);
+    b[7] = -k2 * v[0] * v[2];
+    b[8] = k4 * (vx2 - vy2);
+    b[9] = -k5 * v[1] * (3.0f * vx2 - vy2);
+    b[10] = k6 * v[1] * v[0] * v[2];
+    b[11] = -k7 * v[1] * (5.0f * vz2 - 1.0f);
+    b[12] = k8 * v[2] * (5.0f * vz2 - 3.0f);
+    b[13] = -k7 * v[0] * (5.0f * vz2 - 1.0f);
+    b[14] = k9 * v[2] * (vx2 - vy2);
+    b[15] = -k5 * v[0] * (vx2 - 3.0f * vy2);
+}
+
+// Compares the half precision gpu layout against the fp32 one: memory per splat, the view dependent
+// splat colors (over a fixed set of view directions) and the reconstructed covariance.
+static bool BenchHalf(const std::string& plyFile, int iterations, bool importFullSH) {
+    GaussianCloud::Options options = {0};
+    options.importFullSH = importFullSH;
+    GaussianCloud gaussianCloud(options);
+    if (!gaussianCloud.ImportPly(plyFile)) {
+        return false;
+    }
+
+    const size_t numGaussians = gaussianCloud.GetNumGaussians();
+    const size_t halfStride = GetHalfGaussianStride(gaussianCloud);
+    std::vector<uint8_t> halfData(numGaussians * halfStride);
+    double packSeconds = std::numeric_limits<double>::max();
+    for (int i = 0; i < iterations; i++) {
+        packSeconds = std::min(packSeconds, TimeSeconds([&]() {
+            PackHalfGaussians(gaussianCloud, 0, numGaussians, halfData.data());
+        }));
+    }
+
+    // axis aligned and diagonal view directions
+    std::vector<std::array<float, 3>> dirs;
+    for (int x = -1; x <= 1; x++) {
+        for (int y = -1; y <= 1; y++) {
+            for (int z = -1; z <= 1; z++) {
+                if (x || y || z) {
+                    float len = std::sqrt((float)(x * x + y * y + z * z));
+                    dirs.push_back({ x / len, y / len, z / len });
+                }
+            }
+        }
+    }
+
+    const bool fullSH = gaussianCloud.HasFullSH();
+    const int numCoeffs = fullSH ? 16 : 4;
+    const BinaryAttribute* sh0Attribs[3] = { &gaussianCloud.GetR_SH0Attrib(), &gaussianCloud.GetG_SH0Attrib(), &gaussianCloud.GetB_SH0Attrib() };
+    const BinaryAttribute* sh1Attribs[3] = { &gaussianCloud.GetR_SH1Attrib(), &gaussianCloud.GetG_SH1Attrib(), &gaussianCloud.GetB_SH1Attrib() };
+    double colorErr = 0.0, covMaxErr = 0.0, covSumErr = 0.0;
+    for (size_t i = 0; i < numGaussians; i++) {
+        const uint8_t* ptr = (const uint8_t*)gaussianCloud.GetRawDataPtr() + i * gaussianCloud.GetStride();
+        const HalfGaussianData* halfPtr = reinterpret_cast<const HalfGaussianData*>(halfData.data() + i * halfStride);
+        const FullHalfGaussianData* fullHalfPtr = reinterpret_cast<const FullHalfGaussianData*>(halfPtr);
+
+        // sh0 and sh1..sh3 (which are contiguous) of both layouts, per channel
+        float sh[3][16], halfSh[3][16];
+        const uint16_t* halfSh0[3] = { halfPtr->r_sh0, halfPtr->g_sh0, halfPtr->b_sh0 };
+        const uint16_t* halfSh1[3] = { fullHalfPtr->r_sh1, fullHalfPtr->g_sh1, fullHalfPtr->b_sh1 };
+        for (int k = 0; k < 3; k++) {
+            for (int j = 0; j < numCoeffs; j++) {
+                sh[k][j] = j < 4 ? sh0Attribs[k]->Get<float>(ptr)[j] : sh1Attribs[k]->Get<float>(ptr)[j - 4];
+                halfSh[k][j] = HalfToFloat(j < 4 ? halfSh0[k][j] : halfSh1[k][j - 4]);
+            }
+        }
+        for (const auto& dir : dirs) {
+            float b[16];
+            ComputeSHBasis(dir.data(), b);
+            for (int k = 0; k < 3; k++) {
+                float color = 0.5f, halfColor = 0.5f;
+                for (int j = 0; j < numCoeffs; j++) {
+                    color += b[j] * sh[k][j];
+                    halfColor += b[j] * halfSh[k][j];
+                }
+                float diff = std::clamp(color, 0.0f, 1.0f) - std::clamp(halfColor, 0.0f, 1.0f);
+                colorErr += (double)diff * diff;
+            }
+        }
+
+        // V = L * L^T
+        const float* col0 = gaussianCloud.GetCov3_Col0Attrib().Get<float>(ptr);
+        const float* col1 = gaussianCloud.GetCov3_Col1Attrib().Get<float>(ptr);
+        const float* col2 = gaussianCloud.GetCov3_Col2Attrib().Get<float>(ptr);
+        const float cov[6] = { col0[0], col0[1], col0[2], col1[1], col1[2], col2[2] };
+        double l00 = HalfToFloat(halfPtr->cov3_chol0[0]), l10 = HalfToFloat(halfPtr->cov3_chol0[1]);
+        double l20 = HalfToFloat(halfPtr->cov3_chol0[2]), l11 = HalfToFloat(halfPtr->cov3_chol0[3]);
+        double l21 = HalfToFloat(halfPtr->cov3_chol1[0]), l22 = HalfToFloat(halfPtr->cov3_chol1[1]);
+        const double recon[6] = { l00 * l00, l10 * l00, l20 * l00, l10 * l10 + l11 * l11, l20 * l10 + l21 * l11, l20 * l20 + l21 * l21 + l22 * l22 };
+        double trace = (double)cov[0] + cov[3] + cov[5];
+        double err = 0.0;
+        for (int k = 0; k < 6; k++) {
+            err = std::max(err, std::abs(recon[k] - cov[k]));
+        }
+        err = trace > 0.0 ? err / trace : 0.0;
+        covMaxErr = std::max(covMaxErr, err);
+        covSumErr += err;
+    }
+
+    spdlog::info("== half precision layout, {} gaussians ({} iterations)", numGaussians, iterations);
+    spdlog::info("{:>26}: {} -> {} bytes/splat ({:.1f} MB -> {:.1f} MB)", "gpu size", gaussianCloud.GetStride(), halfStride,
+                 gaussianCloud.GetTotalSize() / 1.0e6, halfData.size() / 1.0e6);
+    spdlog::info("{:>26}: {:8.2f} ns/splat", "pack", packSeconds * 1.0e9 / numGaussians);
+    spdlog::info("{:>26}: {:.1f} dB over {} view directions", "color psnr", PSNR(colorErr, numGaussians * dirs.size() * 3, 1.0), dirs.size());
+    spdlog::info("{:>26}: max {:.3g} mean {:.3g}", "cov error/trace", covMaxErr, covSumErr / std::max(numGaussians, (size_t)1));
+    return true;
+}
+
+// a projection and views that look at the center of the bounds of the cloud from outside and from the center
+struct BenchCameras {
+    glm::mat4 projMat;
+    glm::vec2 nearFar;
+    std::vector<glm::mat4> viewMats;
+};
+
+static BenchCameras GetBenchCameras(const GaussianCloud& gaussianCloud, float aspect) {
+    glm::vec3 minPos(std::numeric_limits<float>::max()), maxPos(-std::numeric_limits<float>::max());
+    gaussianCloud.ForEachPosWithAlpha([&](const float* pos) {
+        minPos = glm::min(minPos, glm::vec3(pos[0], pos[1], pos[2]));
+        maxPos = glm::max(maxPos, glm::vec3(pos[0], pos[1], pos[2]));
+    });
+
+    const glm::vec3 center = 0.5f * (minPos + maxPos);
+    const float radius = std::max(0.5f * glm::length(maxPos - minPos), 1.0e-3f);
+    BenchCameras cameras;
+    cameras.nearFar = glm::vec2(0.1f, 4.0f * radius);
+    cameras.projMat = glm::perspective(glm::radians(45.0f), aspect, cameras.nearFar.x, cameras.nearFar.y);
+    cameras.viewMats = {
+        glm::lookAt(center + glm::vec3(0.0f, 0.0f, 2.0f * radius), center, glm::vec3(0.0f, 1.0f, 0.0f)),
+        glm::lookAt(center + glm::vec3(2.0f * radius, 0.0f, 0.0f), center, glm::vec3(0.0f, 1.0f, 0.0f)),
+        glm::lookAt(center, center + glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f))
+    };
+    return cameras;
+}
+
+// independent reference for the range quantized keys of CpuSplatSorter, sorted ascending
+static std::vector<uint32_t> ReferenceDepthKeys(const std::vector<glm::vec4>& positions, const glm::mat4& modelViewProj,
+                                                uint32_t depthKeyBits, bool logDepthKeys) {
+    const float clip = 1.5f;
+    std::vector<float> depths;
+    for (auto&& p : positions) {
+        float px = modelViewProj[0][0] * p.x + modelViewProj[1][0] * p.y + modelViewProj[2][0] * p.z + modelViewProj[3][0];
+        float py = modelViewProj[0][1] * p.x + modelViewProj[1][1] * p.y + modelViewProj[2][1] * p.z + modelViewProj[3][1];
+        float depth = modelViewProj[0][3] * p.x + modelViewProj[1][3] * p.y + modelViewProj[2][3] * p.z + modelViewProj[3][3];
+        float xx = px / depth;
+        float yy = py / depth;
+        if (depth > 0.0f && xx < clip && xx > -clip && yy < clip && yy > -clip) {
+            depths.push_back(depth);
+        }
+    }
+    if (depths.empty()) {
+        return {};
+    }
+
+    const auto [minIt, maxIt] = std::minmax_element(depths.begin(), depths.end());
+    const float minDepth = *minIt, maxDepth = *maxIt;
+    const float depthRange = logDepthKeys ? std::max(logf(maxDepth / minDepth), 1e-20f) : std::max(maxDepth - minDepth, 1e-20f);
+    const uint32_t keyMax = (1u << depthKeyBits) - 1;
+    std::vector<uint32_t> keys;
+    keys.reserve(depths.size());
+    for (float depth : depths) {
+        float t = logDepthKeys ? logf(depth / minDepth) / depthRange : (depth - minDepth) / depthRange;
+        keys.push_back(keyMax - (uint32_t)(std::clamp(t, 0.0f, 1.0f) * (float)keyMax));
+    }
+    std::sort(keys.begin(), keys.end());
+    return keys;
+}
+
+static bool BenchCpuSort(const std::string& plyFile, int iterations, bool importFullSH) {
+    GaussianCloud::Options options = {0};
+    options.importFullSH = importFullSH;
+    GaussianCloud gaussianCloud(options);
+    if (!gaussianCloud.ImportPly(plyFile)) {
+        return false;
+    }
+
+    const size_t numGaussians = gaussianCloud.GetNumGaussians();
+    std::vector<glm::vec4> positions;
+    positions.reserve(numGaussians);
+    gaussianCloud.ForEachPosWithAlpha([&](const float* pos) {
+        positions.emplace_back(glm::vec4(pos[0], pos[1], pos[2], 1.0f));
+    });
+
+    const BenchCameras cameras = GetBenchCameras(gaussianCloud, 16.0f / 9.0f);
+    const glm::mat4& projMat = cameras.projMat;
+    const glm::vec2& nearFar = cameras.nearFar;
+    const std::vector<glm::mat4>& viewMats = cameras.viewMats;
+
+    spdlog::info("== cpu sort, {} gaussians, {} culling ({} iterations)", numGaussians, CpuSplatSorter::GetISA(), iterations);
+    CpuSplatSorter sorter, scalarSorter;
+    bool ok = true;
+    for (uint32_t depthKeyBits : { 32u, 24u, 16u }) {
+        CpuSplatSorter::Options sortOptions;
+        sortOptions.depthKeyBits = depthKeyBits;
+        CpuSplatSorter::Options scalarOptions = sortOptions;
+        scalarOptions.forceScalar = true;
+
+        double cullSeconds = 0.0, sortSeconds = 0.0, scalarCullSeconds = 0.0;
+        size_t numVisible = 0;
+        bool sorted = true, matches = true;
+        for (auto&& viewMat : viewMats) {
+            const glm::mat4 modelViewProj = projMat * viewMat;
+            double bestCull = std::numeric_limits<double>::max(), bestSort = std::numeric_limits<double>::max();
+            double bestScalarCull = std::numeric_limits<double>::max();
+            size_t count = 0, scalarCount = 0;
+            for (int i = 0; i < iterations; i++) {
+                count = sorter.Sort(positions.data(), numGaussians, modelViewProj, nearFar, sortOptions);
+                bestCull = std::min(bestCull, sorter.GetTimings().cullSeconds);
+                bestSort = std::min(bestSort, sorter.GetTimings().sortSeconds);
+                scalarCount = scalarSorter.Sort(positions.data(), numGaussians, modelViewProj, nearFar, scalarOptions);
+                bestScalarCull = std::min(bestScalarCull, scalarSorter.GetTimings().cullSeconds);
+            }
+            cullSeconds += bestCull;
+            sortSeconds += bestSort;
+            scalarCullSeconds += bestScalarCull;
+            numVisible += count;
+
+            // the simd kernel has to produce the same keys and order as the scalar one
+            const std::vector<uint32_t>& keys = sorter.GetSortedKeys();
+            sorted = sorted && std::is_sorted(keys.begin(), keys.begin() + count);
+            matches = matches && count == scalarCount &&
+                std::equal(keys.begin(), keys.begin() + count, scalarSorter.GetSortedKeys().begin()) &&
+                std::equal(sorter.GetSortedIndices().begin(), sorter.GetSortedIndices().begin() + count, scalarSorter.GetSortedIndices().begin());
+        }
+
+        const double numPoses = (double)viewMats.size();
+        spdlog::info("{:>10} bit keys: {:8.3f} ms cull ({:.3f} ms scalar), {:8.3f} ms sort, {:.0f} visible, {} {}", depthKeyBits,
+                     cullSeconds * 1.0e3 / numPoses, scalarCullSeconds * 1.0e3 / numPoses, sortSeconds * 1.0e3 / numPoses,
+                     numVisible / numPoses, sorted ? "sorted" : "NOT SORTED", matches ? "matches scalar" : "DIFFERS FROM SCALAR");
+        ok = ok && sorted && matches;
+    }
+
+    // the simd and scalar kernels share the range quantization, so check it against std::sort, once on the
+    // thread pool and once from inside a job where ParallelFor() runs every range serially
+    for (uint32_t depthKeyBits : { 24u, 16u }) {
+        for (bool logDepthKeys : { false, true }) {
+            CpuSplatSorter::Options sortOptions;
+            sortOptions.depthKeyBits = depthKeyBits;
+            sortOptions.logDepthKeys = logDepthKeys;
+            bool matches = true;
+            for (auto&& viewMat : viewMats) {
+                const glm::mat4 modelViewProj = projMat * viewMat;
+                const std::vector<uint32_t> reference = ReferenceDepthKeys(positions, modelViewProj, depthKeyBits, logDepthKeys);
+                for (bool serial : { false, true }) {
+                    size_t count = 0;
+                    if (serial) {
+                        ThreadPool::Get().ParallelFor(1, 1, [&](size_t, size_t) {
+                            count = sorter.Sort(positions.data(), numGaussians, modelViewProj, nearFar, sortOptions);
+                        });
+                    } else {
+                        count = sorter.Sort(positions.data(), numGaussians, modelViewProj, nearFar, sortOptions);
+                    }
+
+                    // allow one step of rounding in logf()
+                    const std::vector<uint32_t>& keys = sorter.GetSortedKeys();
+                    matches = matches && count == reference.size() &&
+                        std::equal(keys.begin(), keys.begin() + count, reference.begin(), [](uint32_t a, uint32_t b) {
+                            return std::max(a, b) - std::min(a, b) <= 1;
+                        });
+                }
+            }
+            spdlog::log(matches ? spdlog::level::info : spdlog::level::err, "{:>10} bit {} keys: {}", depthKeyBits,
+                        logDepthKeys ? "log" : "linear", matches ? "matches std::sort" : "DIFFERS FROM STD::SORT");
+            ok = ok && matches;
+        }
+    }
+    return ok;
+}
+
+// 8 bit binary ppm of premultiplied rgba over black, flipped to top to bottom rows
+static bool WritePPM(const std::string& filename, const std::vector<glm::vec4>& color, uint32_t width, uint32_t height) {
+    std::ofstream file(filename, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    file << "P6\n" << width << " " << height << "\n255\n";
+    std::vector<uint8_t> row(width * 3);
+    for (uint32_t y = height; y-- > 0;) {
+        for (uint32_t x = 0; x < width; x++) {
+            const glm::vec4& c = color[(size_t)y * width + x];
+            for (int k = 0; k < 3; k++) {
+                row[x * 3 + k] = (uint8_t)std::lround(std::clamp(c[k], 0.0f, 1.0f) * 255.0f);
+            }
+        }
+        file.write((const char*)row.data(), row.size());
+    }
+    return (bool)file;
+}
+
+static bool BenchRaster(const std::string& plyFile, int iterations, bool importFullSH, uint32_t width, uint32_t height,
+                        const std::string& outFile) {
+    GaussianCloud::Options options = {0};
+    options.importFullSH = importFullSH;
+    GaussianCloud gaussianCloud(options);
+    if (!gaussianCloud.ImportPly(plyFile)) {
+        return false;
+    }
+
+    const size_t numGaussians = gaussianCloud.GetNumGaussians();
+    const BenchCameras cameras = GetBenchCameras(gaussianCloud, (float)width / (float)height);
+
+    spdlog::info("== cpu raster, {} gaussians, {}x{}, {} kernel ({} iterations)", numGaussians, width, height,
+                 CpuSplatRasterizer::GetISA(), iterations);
+    CpuSplatRasterizer rasterizer, scalarRasterizer;
+    CpuSplatRasterizer::Options scalarOptions;
+    scalarOptions.forceScalar = true;
+    for (size_t view = 0; view < cameras.viewMats.size(); view++) {
+        const glm::mat4 cameraMat = glm::inverse(cameras.viewMats[view]);
+        CpuSplatRasterizer::Timings best;
+        best.sortSeconds = best.projectSeconds = best.rasterSeconds = std::numeric_limits<double>::max();
+        double bestTotal = std::numeric_limits<double>::max();
+        for (int i = 0; i < iterations; i++) {
+            double total = TimeSeconds([&]() {
+                rasterizer.Render(gaussianCloud, numGaussians, cameraMat, cameras.projMat, glm::mat4(1.0f), cameras.nearFar,
+                                  width, height, CpuSplatRasterizer::Options());
+            });
+            const CpuSplatRasterizer::Timings& timings = rasterizer.GetTimings();
+            best.sortSeconds = std::min(best.sortSeconds, timings.sortSeconds);
+            best.projectSeconds = std::min(best.projectSeconds, timings.projectSeconds);
+            best.rasterSeconds = std::min(best.rasterSeconds, timings.rasterSeconds);
+            bestTotal = std::min(bestTotal, total);
+        }
+
+        // the simd kernel only differs from the scalar one by its exp approximation
+        scalarRasterizer.Render(gaussianCloud, numGaussians, cameraMat, cameras.projMat, glm::mat4(1.0f), cameras.nearFar,
+                                width, height, scalarOptions);
+        float maxDiff = 0.0f;
+        for (size_t p = 0; p < rasterizer.GetColor().size(); p++) {
+            for (int k = 0; k < 4; k++) {
+                maxDiff = std::max(maxDiff, std::abs(rasterizer.GetColor()[p][k] - scalarRasterizer.GetColor()[p][k]));
+            }
+        }
+
+        const CpuSplatRasterizer::Stats& stats = rasterizer.GetStats();
+        spdlog::info("{:>10} view {}: {:8.2f} ms ({:.2f} sort, {:.2f} project, {:.2f} raster), {:.1f} M splats/s, {} visible, {:.1f} tiles/splat, max diff to scalar {:.2g}",
+                     "", view, bestTotal * 1.0e3, best.sortSeconds * 1.0e3, best.projectSeconds * 1.0e3, best.rasterSeconds * 1.0e3,
+                     numGaussians / bestTotal / 1.0e6, stats.numVisible, stats.numTileSplats / (double)std::max(stats.numVisible, (size_t)1),
+                     maxDiff);
+
+        if (!outFile.empty() && view == 0) {
+            if (!WritePPM(outFile, rasterizer.GetColor(), width, height)) {
+                spdlog::error("Error writing {}", outFile);
+                return false;
+            }
+            spdlog::info("{:>10} wrote {}", "", outFile);
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    args::ArgumentParser parser("GS Bench");
+    args::HelpFlag help(parser, "help", "Display this help menu", {'h', "help"});
+    args::Flag verbose(parser, "verbose", "Enable verbose logging", {'v', "verbose"});
+    args::ValueFlag<std::string> plyFileIn(parser, "ply", "Path to ply", {'i', "ply"}, "./test.ply");
+    args::ValueFlag<int> iterationsIn(parser, "iterations", "Number of iterations per benchmark (best is reported)", {'n', "iterations"}, 3);
+    args::Flag importFullSH(parser, "importFullSH", "Import full SH data from PLY", {'f', "fullsh"}, true);
+    args::Flag importBench(parser, "import", "Benchmark ply import", {"import"});
+    args::Flag decomposeBench(parser, "decompose", "Benchmark and check the covariance decomposition used by ply export", {"decompose"});
+    args::Flag compressBench(parser, "compress", "Report size, speed and error of the compressed .gsz format", {"compress"});
+    args::Flag halfBench(parser, "half", "Report size and error of the half precision gpu layout", {"half"});
+    args::Flag cpuSortBench(parser, "cpusort", "Benchmark and check the cpu culling and depth sort", {"cpusort"});
+    args::Flag rasterBench(parser, "raster", "Benchmark the cpu tile rasterizer", {"raster"});
+    args::ValueFlag<std::string> rasterSizeIn(parser, "rasterSize", "Resolution of the cpu rasterizer", {"raster-size"}, "1280x720");
+    args::ValueFlag<std::string> rasterOutIn(parser, "rasterOut", "Write the first view of the cpu rasterizer to this .ppm", {"raster-out"}, "");
+    try {
+        parser.ParseCLI(argc, argv);
+    } catch (args::Help) {
+        std::cout << parser;
+        return 0;
+    } catch (args::ParseError e) {
+        std::cerr << e.what() << std::endl;
+        std::cerr << parser;
+        return 1;
+    }
+
+    if (verbose) {
+        spdlog::set_level(spdlog::level::debug);
+    }
+
+    std::string plyFile = args::get(plyFileIn);
+    int iterations = std::max(1, args::get(iterationsIn));
+
+    // run every benchmark if none are selected
+    bool runAll = !importBench && !decomposeBench && !compressBench && !halfBench && !cpuSortBench && !rasterBench;
+
+    if (runAll || importBench) {
+        if (!BenchImport(plyFile, iterations, importFullSH)) {
+            spdlog::error("Error loading {}", plyFile);
+            return -1;
+        }
+    }
+
+    if (runAll || decomposeBench) {
+        if (!BenchDecompose(plyFile, iterations)) {
+            spdlog::error("decompose benchmark failed on {}", plyFile);
+            return -1;
+        }
+    }
+
+    if (runAll || compressBench) {
+        if (!BenchCompress(plyFile, iterations, importFullSH)) {
+            spdlog::error("Error compressing {}", plyFile);
+            return -1;
+        }
+    }
+
+    if (runAll || halfBench) {
+        if (!BenchHalf(plyFile, iterations, importFullSH)) {
+            spdlog::error("Error loading {}", plyFile);
+            return -1;
+        }
+    }
+
+    if (runAll || cpuSortBench) {
+        if (!BenchCpuSort(plyFile, iterations, importFullSH)) {
+            spdlog::error("cpu sort benchmark failed on {}", plyFile);
+            return -1;
+        }
+    }
+
+    if (runAll || rasterBench) {
+        std::string sizeStr = args::get(rasterSizeIn);
+        size_t pos = sizeStr.find('x');
+        uint32_t width = (uint32_t)std::max(1, std::stoi(sizeStr.substr(0, pos)));
+        uint32_t height = (uint32_t)std::max(1, std::stoi(sizeStr.substr(pos + 1)));
+        if (!BenchRaster(plyFile, iterations, importFullSH, width, height, args::get(rasterOutIn))) {
+            spdlog::error("Error rendering {}", plyFile);
+            return -1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,66 @@
+#include <args/args.hxx>
+
+#include <filesystem>
+#include <iostream>
+
+#include <spdlog/spdlog.h>
+
+#include <gaussiancloud.h>
+
+// Converts between .ply and the compressed .gsz format, picked by the file extensions.
+
+static bool IsCompressed(const std::string& filename) {
+    return std::filesystem::path(filename).extension() == ".gsz";
+}
+
+int main(int argc, char** argv) {
+    args::ArgumentParser parser("GS Convert");
+    args::HelpFlag help(parser, "help", "Display this help menu", {'h', "help"});
+    args::Flag verbose(parser, "verbose", "Enable verbose logging", {'v', "verbose"});
+    args::ValueFlag<std::string> inputIn(parser, "input", "Path to input .ply or .gsz", {'i', "input"});
+    args::ValueFlag<std::string> outputIn(parser, "output", "Path to output .ply or .gsz", {'o', "output"});
+    args::Flag dcOnly(parser, "dcOnly", "Drop the higher order SH coefficients", {"dc-only"});
+    try {
+        parser.ParseCLI(argc, argv);
+    } catch (args::Help) {
+        std::cout << parser;
+        return 0;
+    } catch (args::ParseError e) {
+        std::cerr << e.what() << std::endl;
+        std::cerr << parser;
+        return 1;
+    }
+
+    if (verbose) {
+        spdlog::set_level(spdlog::level::debug);
+    }
+
+    if (!inputIn || !outputIn) {
+        std::cerr << parser;
+        return 1;
+    }
+    std::string inputFile = args::get(inputIn);
+    std::string outputFile = args::get(outputIn);
+
+    GaussianCloud::Options options = {0};
+    options.importFullSH = !dcOnly;
+    options.exportFullSH = !dcOnly;
+    options.keepRotScale = true;  // avoids decomposing the covariances again when writing
+    GaussianCloud gaussianCloud(options);
+
+    bool loaded = IsCompressed(inputFile) ? gaussianCloud.ImportCompressed(inputFile) : gaussianCloud.ImportPly(inputFile);
+    if (!loaded) {
+        spdlog::error("Error loading {}", inputFile);
+        return -1;
+    }
+
+    bool written = IsCompressed(outputFile) ? gaussianCloud.ExportCompressed(outputFile) : gaussianCloud.ExportPly(outputFile);
+    if (!written) {
+        spdlog::error("Error writing {}", outputFile);
+        return -1;
+    }
+
+    spdlog::info("Converted {} gaussians, {:.1f} MB -> {:.1f} MB", gaussianCloud.GetNumGaussians(),
+                 std::filesystem::file_size(inputFile) / 1.0e6, std::filesystem::file_size(outputFile) / 1.0e6);
+    return 0;
+}
@@ -1,5 +1,7 @@
 #include <args/args.hxx>
 
+#include <filesystem>
+
 #include <OpenGLApp.h>
 #include <SceneLoader.h>
 #include <Windowing/GLFWWindow.h>
@@ -12,9 +14,11 @@
 
 using namespace quasar;
 
-static std::shared_ptr<GaussianCloud> LoadGaussianCloud(const std::string& plyFilename, const bool importFullSH = true)
+static std::shared_ptr<GaussianCloud> LoadGaussianCloud(const std::string& plyFilename, const bool importFullSH = true, const bool progressive = false,
+                                                         const bool useCache = false, const bool planarLayout = false)
 {
     GaussianCloud::Options options = {0};
+    options.planarLayout = planarLayout;
 #ifdef __ANDROID__
     options.importFullSH = false;
     options.exportFullSH = false;
@@ -23,11 +27,36 @@ static std::shared_ptr<GaussianCloud> LoadGaussianCloud(const std::string& plyFi
     options.exportFullSH = true;
 #endif
     auto gaussianCloud = std::make_shared<GaussianCloud>(options);
-    if (!gaussianCloud->ImportPly(plyFilename)) {
+
+    // compressed scenes decode quickly enough that neither the cache nor progressive loading apply to them
+    if (std::filesystem::path(plyFilename).extension() == ".gsz") {
+        if (!gaussianCloud->ImportCompressed(plyFilename)) {
+            spdlog::error("Error loading GaussianCloud!");
+            return nullptr;
+        }
+        return gaussianCloud;
+    }
+
+    const std::string cacheFilename = GaussianCloud::GetCacheFilename(plyFilename);
+    if (useCache && gaussianCloud->ImportCache(cacheFilename, plyFilename)) {
+        return gaussianCloud;
+    }
+
+    bool loaded = progressive ? gaussianCloud->ImportPlyProgressive(plyFilename) : gaussianCloud->ImportPly(plyFilename);
+    if (!loaded) {
         spdlog::error("Error loading GaussianCloud!");
         return nullptr;
     }
 
+    if (useCache) {
+        if (progressive) {
+            spdlog::warn("Not writing cache \"{}\" while loading progressively", cacheFilename);
+        }
+        else if (!gaussianCloud->ExportCache(cacheFilename, plyFilename)) {
+            spdlog::warn("Failed to write cache \"{}\"", cacheFilename);
+        }
+    }
+
     return gaussianCloud;
 }
 
@@ -39,9 +68,21 @@ int main(int argc, char** argv) {
     args::HelpFlag help(parser, "help", "Display this help menu", {'h', "help"});
     args::Flag verbose(parser, "verbose", "Enable verbose logging", {'v', "verbose"});
     args::ValueFlag<std::string> sizeIn(parser, "size", "Resolution of renderer", {'s', "size"}, "1920x1080");
-    args::ValueFlag<std::string> plyFileIn(parser, "ply", "Path to ply", {'i', "ply"}, "./test.ply");
+    args::ValueFlag<std::string> plyFileIn(parser, "ply", "Path to ply (or compressed .gsz)", {'i', "ply"}, "./test.ply");
     args::Flag novsync(parser, "novsync", "Disable VSync", {'V', "novsync"}, false);
     args::Flag importFullSH(parser, "importFullSH", "Import full SH data from PLY", {'f', "fullsh"}, true);
+    args::Flag progressiveLoad(parser, "progressive", "Start rendering while the PLY is still loading", {"progressive"});
+    args::Flag useCache(parser, "cache", "Load from (and write) a preprocessed .gscache next to the PLY", {"cache"});
+    args::Flag halfPrecision(parser, "half", "Store SH and covariance as fp16 on the GPU", {"half"});
+    args::Flag planarLayout(parser, "planar", "Store positions, covariance and SH as separate streams", {"planar"});
+    args::Flag sortReuse(parser, "sortReuse", "Skip re-sorting the splats while the camera barely moves", {"sort-reuse"});
+    args::ValueFlag<int> depthKeyBits(parser, "depthKeyBits", "Depth sort key size in bits (16, 24 or 32), 16 and 24 quantize the visible depth range", {"depth-key-bits"}, 32);
+    args::Flag logDepthKeys(parser, "logDepthKeys", "Quantize log depth when the depth keys are smaller than 32 bits", {"log-depth-keys"});
+    args::ValueFlag<std::string> sortBackendIn(parser, "sortBackend", "Depth sort backend: multi, onesweep, rgc, cpu or auto to time the gpu ones on startup", {"sort-backend"}, "multi");
+    args::ValueFlag<int> sortBlocksIn(parser, "sortBlocks", "Blocks of 256 keys per sort workgroup, 0 for the backend default", {"sort-blocks"}, 0);
+    args::Flag asyncSort(parser, "asyncSort", "Sort on a CPU worker thread and draw the newest finished order, one or more frames behind", {"async-sort"});
+    args::ValueFlag<std::string> rasterModeIn(parser, "rasterMode", "Splat rasterizer: geometry (geometry shader), quads (instanced quads, no geometry shader) or compute (16x16 pixel tiles in compute shaders)", {"raster-mode"}, "geometry");
+    args::Flag fusedPreprocess(parser, "fusedPreprocess", "Project, cull and shade the splats in one compute pass, so the sort and draw only see splats that cover a pixel", {"fused-preprocess"});
     try {
         parser.ParseCLI(argc, argv);
     } catch (args::Help) {
@@ -75,6 +116,26 @@ int main(int argc, char** argv) {
 
     OpenGLApp app(config);
     GSRenderer renderer(config);
+    renderer.splatOptions.halfPrecision = halfPrecision;
+    renderer.sortReuse.enabled = sortReuse;
+    renderer.splatOptions.depthKeyBits = (uint32_t)args::get(depthKeyBits);
+    renderer.splatOptions.logDepthKeys = logDepthKeys;
+    std::string sortBackendStr = args::get(sortBackendIn);
+    if (sortBackendStr == "auto") {
+        renderer.splatOptions.autotuneSort = true;
+    }
+    else if (!SortBackend::ParseType(sortBackendStr, &renderer.splatOptions.sortBackend.type)) {
+        std::cerr << "Unknown sort backend " << sortBackendStr << std::endl;
+        return 1;
+    }
+    renderer.splatOptions.sortBackend.blocksPerWorkgroup = (uint32_t)std::max(args::get(sortBlocksIn), 0);
+    renderer.splatOptions.asyncSort = asyncSort;
+    renderer.splatOptions.fusedPreprocess = fusedPreprocess;
+    std::string rasterModeStr = args::get(rasterModeIn);
+    if (!SplatRenderer::ParseRasterMode(rasterModeStr, &renderer.splatOptions.rasterMode)) {
+        std::cerr << "Unknown raster mode " << rasterModeStr << std::endl;
+        return 1;
+    }
 
     Scene scene;
     PerspectiveCamera camera(windowSize);
@@ -84,7 +145,7 @@ int main(int argc, char** argv) {
 
     // Load the given ply file
     std::string plyFile = args::get(plyFileIn);
-    auto gaussianCloud = LoadGaussianCloud(plyFile, importFullSH);
+    auto gaussianCloud = LoadGaussianCloud(plyFile, importFullSH, progressiveLoad, useCache, planarLayout);
     if (!gaussianCloud) {
         spdlog::error("Error loading GaussianCloud");
         return -1;
@@ -150,6 +211,19 @@ int main(int argc, char** argv) {
             else
                 ImGui::TextColored(ImVec4(1,0,0,1), "Draw Calls: %ld", renderStats.drawCalls);
 
+            const SplatRenderer::SortStats& sortStats = renderer.getSortStats();
+            uint64_t numSortCalls = sortStats.numSorted + sortStats.numReused;
+            ImGui::Text("Sort Reuse: %.1f%% (%lu of %lu)", numSortCalls ? 100.0 * sortStats.numReused / numSortCalls : 0.0,
+                        (unsigned long)sortStats.numReused, (unsigned long)numSortCalls);
+            ImGui::Text("Sort Backend: %s", renderer.getSortBackendDescription().c_str());
+            ImGui::Text("Rasterizer: %s (%.3f ms GPU)", SplatRenderer::GetRasterModeName(renderer.splatOptions.rasterMode),
+                        renderer.getDrawGpuMs());
+            if (renderer.splatOptions.asyncSort) {
+                const SplatRenderer::SortStaleness& staleness = renderer.getSortStaleness();
+                ImGui::Text("Sort Lag: %u frames, %.3f units, %.2f deg (%.2f ms sort)", staleness.frames,
+                            staleness.translation, staleness.angleDeg, staleness.sortSeconds * 1000.0);
+            }
+
             ImGui::Separator();
 
             cameraHeader.draw(now, dt);
@@ -165,6 +239,51 @@ int main(int argc, char** argv) {
                 }
             }
 
+            if (ImGui::CollapsingHeader("Sort Reuse")) {
+                ImGui::Checkbox("Enabled", &renderer.sortReuse.enabled);
+                ImGui::DragFloat("Max Angle (deg)", &renderer.sortReuse.maxAngleDeg, 0.01f, 0.0f, 10.0f);
+                ImGui::DragFloat("Max Translation", &renderer.sortReuse.maxTranslation, 0.001f, 0.0f, 1.0f);
+                int maxFrames = (int)renderer.sortReuse.maxFrames;
+                if (ImGui::DragInt("Max Frames", &maxFrames, 1.0f, 0, 1000)) {
+                    renderer.sortReuse.maxFrames = (uint32_t)std::max(maxFrames, 0);
+                }
+                if (ImGui::Button("Reset Stats")) {
+                    renderer.resetSortStats();
+                }
+                ImGui::Text("Depth Keys: %u bit%s", renderer.splatOptions.depthKeyBits,
+                            renderer.splatOptions.depthKeyBits < 32 && renderer.splatOptions.logDepthKeys ? " (log)" : "");
+                ImGui::Checkbox("Validate Sort (logs every sort)", &renderer.validateSort);
+            }
+
+            if (ImGui::CollapsingHeader("Overdraw")) {
+                ImGui::Checkbox("Opacity Bounds", &renderer.opacityBounds);
+                ImGui::Checkbox("Count Fragments", &renderer.countFragments);
+                if (renderer.countFragments) {
+                    // compare with opacity bounds on and off, the blended fragments stay the same
+                    const SplatRenderer::FragmentStats& fragmentStats = renderer.getFragmentStats();
+                    double numPixels = (double)windowSize.x * windowSize.y;
+                    ImGui::Text("Fragments Shaded: %.2f M (%.1f per pixel)", fragmentStats.numShaded / 1.0e6,
+                                numPixels > 0.0 ? fragmentStats.numShaded / numPixels : 0.0);
+                    ImGui::Text("Fragments Blended: %.2f M (%.1f%% of shaded)", fragmentStats.numBlended / 1.0e6,
+                                fragmentStats.numShaded ? 100.0 * fragmentStats.numBlended / fragmentStats.numShaded : 0.0);
+                }
+                ImGui::Checkbox("Heatmap (reads back every frame)", &renderer.overdrawDebug);
+                if (renderer.overdrawDebug) {
+                    ImGui::DragFloat("Heatmap Max", &renderer.overdrawHeatmapMax, 1.0f, 1.0f, 4096.0f);
+                    const SplatRenderer::OverdrawStats& overdrawStats = renderer.getOverdrawStats();
+                    ImGui::Text("Shaded: %.2f M, Discarded: %.2f M (%.1f%%)", overdrawStats.numShaded / 1.0e6,
+                                overdrawStats.numDiscarded / 1.0e6,
+                                overdrawStats.numShaded ? 100.0 * overdrawStats.numDiscarded / overdrawStats.numShaded : 0.0);
+                    ImGui::Text("Max Fragments per Pixel: %u", overdrawStats.maxPerPixel);
+                    float bins[SplatRenderer::OverdrawStats::NUM_BINS];
+                    for (int i = 0; i < SplatRenderer::OverdrawStats::NUM_BINS; i++) {
+                        bins[i] = (float)overdrawStats.histogram[i];
+                    }
+                    ImGui::PlotHistogram("Pixels", bins, SplatRenderer::OverdrawStats::NUM_BINS, 0,
+                                         "0, 1, 2-3, 4-7, ... fragments", 0.0f, FLT_MAX, ImVec2(0, 80));
+                }
+            }
+
             if (ImGui::CollapsingHeader("Background Settings")) {
                 if (ImGui::Button("Change Background Color", ImVec2(ImGui::GetContentRegionAvail().x, 0))) {
                     ImGui::OpenPopup("Background Color Popup");
@@ -18,6 +18,32 @@ class GSRenderer : public OpenGLRenderer {
 public:
     bool multiSampled = false;
 
+    // read once, when the splat renderer is initialized by the first drawSplats()
+    SplatRenderer::Options splatOptions = {};
+
+    // applied on every drawSplats()
+    SplatRenderer::SortReuseOptions sortReuse = {};
+    bool validateSort = false;
+    bool opacityBounds = true;
+    bool countFragments = false;
+    // debug mode, replaces the splats with a heatmap of the fragments shaded per pixel
+    bool overdrawDebug = false;
+    float overdrawHeatmapMax = 256.0f;
+
+    const SplatRenderer::SortStats& getSortStats() const { return splatRenderer->GetSortStats(); }
+    void resetSortStats() { splatRenderer->ResetSortStats(); }
+    const SplatRenderer::SortStaleness& getSortStaleness() const { return splatRenderer->GetSortStaleness(); }
+    // gpu time of the splat draw alone, without the sort, to compare the raster modes
+    double getDrawGpuMs() const { return splatRenderer->GetDrawGpuMs(); }
+    // fragments of the splat draw a few frames ago, while countFragments is set
+    const SplatRenderer::FragmentStats& getFragmentStats() const { return splatRenderer->GetFragmentStats(); }
+    // fragment counts and fragments per pixel histogram of the last drawSplats(), both eyes in vr, while overdrawDebug is set
+    const SplatRenderer::OverdrawStats& getOverdrawStats() const { return splatRenderer->GetOverdrawStats(); }
+    // empty until the first drawSplats() picked the sort backend
+    std::string getSortBackendDescription() const {
+        return splatRendererInitialized ? splatRenderer->GetSortBackendDescription() : std::string();
+    }
+
     FrameRenderTarget frameRT;
 
     GSRenderer(const Config& config);
@@ -49,7 +75,6 @@ public:
     }
 
 private:
-    bool useRgcSortOverride = false;
     bool isFramebufferSRGBEnabled = false;
 
     bool splatRendererInitialized = false;
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <condition_variable>
+#include <glm/glm.hpp>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+#include <cpusort.h>
+
+// Runs a CpuSplatSorter on a worker thread, so sorting overlaps with rendering instead of preceding it.
+// Request() hands the worker the newest pose; requests it has not started on yet are replaced.
+// Finished orders are triple buffered: the worker fills one slot, one holds the newest finished order
+// and the render thread draws from the third, so neither side ever waits for the other.
+class AsyncSplatSorter
+{
+public:
+    struct Result
+    {
+        std::vector<uint32_t> indices;  // visible splats, back to front
+        std::vector<uint32_t> keys;  // ascending, matching indices
+        size_t count = 0;
+        glm::mat4 cameraMat = glm::mat4(1.0f);  // the pose this order was sorted for
+        uint64_t requestId = 0;  // 0 until the first order is acquired
+        double sortSeconds = 0.0;  // cull and sort time on the worker
+    };
+
+    AsyncSplatSorter();
+    ~AsyncSplatSorter();
+    AsyncSplatSorter(const AsyncSplatSorter& orig) = delete;
+
+    // positions are read on the worker thread, the first numPoints have to stay valid and unchanged
+    // until the destructor. Returns the id of the request, ids count up from 1.
+    uint64_t Request(const glm::vec4* positions, size_t numPoints, const glm::mat4& cameraMat,
+                     const glm::mat4& modelViewProj, const glm::vec2& nearFar, const CpuSplatSorter::Options& options);
+
+    // swaps the newest finished order into GetCurrent(), returns false if there is none newer than the current one.
+    // wait blocks until the worker finishes one, for when there is nothing to draw yet.
+    bool AcquireNewest(bool wait);
+    const Result& GetCurrent() const { return slots[readSlot]; }
+
+protected:
+    void WorkerMain();
+
+    struct SortRequest
+    {
+        const glm::vec4* positions = nullptr;
+        size_t numPoints = 0;
+        glm::mat4 cameraMat;
+        glm::mat4 modelViewProj;
+        glm::vec2 nearFar;
+        CpuSplatSorter::Options options;
+        uint64_t id = 0;
+    };
+
+    CpuSplatSorter sorter;  // only used by the worker
+    std::thread worker;
+
+    std::mutex mutex;
+    std::condition_variable requestCv;
+    std::condition_variable readyCv;
+
+    Result slots[3];  // each slot is only touched by its current owner, the indices below change hands
+
+    // guarded by mutex
+    SortRequest pendingRequest;
+    uint64_t lastStartedId;
+    uint32_t writeSlot;  // filled by the worker
+    uint32_t readySlot;  // newest finished order
+    uint32_t readSlot;  // drawn by the render thread
+    bool readyIsNew;
+    bool quit;
+};
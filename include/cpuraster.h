@@ -0,0 +1,92 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <stdint.h>
+#include <vector>
+
+#include <cpusort.h>
+#include <gaussiancloud.h>
+
+// CPU reference of the splat rendering in splat_vert.glsl, splat_geom.glsl and splat_frag.glsl, does not need a GPU.
+// The visible splats are depth sorted with CpuSplatSorter, projected, and binned front to back into TILE_SIZE x TILE_SIZE
+// pixel tiles, which leaves every tile list sorted. The tiles are handed out to the ThreadPool one at a time and blended
+// front to back, 8 pixels per instruction with AVX2 when the cpu has it, until all of their pixels are opaque.
+class CpuSplatRasterizer
+{
+public:
+    static constexpr uint32_t TILE_SIZE = 16;
+
+    struct Options
+    {
+        bool framebufferSRGB = false;  // convert the splat colors to linear, like FRAMEBUFFER_SRGB
+        // a pixel stops blending once less than this much of the splats behind it could still show
+        float minTransmittance = 1.0f / 256.0f;
+        bool forceScalar = false;  // skip the AVX2 kernel, to compare against the scalar reference
+        bool opacityBounds = true;  // size the splat bounds by opacity like SplatRenderer::opacityBounds
+    };
+
+    struct Timings
+    {
+        double sortSeconds = 0.0;  // culling and depth sort
+        double projectSeconds = 0.0;  // covariance projection, color and tile binning
+        double rasterSeconds = 0.0;
+    };
+
+    struct Stats
+    {
+        size_t numVisible = 0;  // splats that passed the culling and the guard band of splat_geom.glsl
+        size_t numTileSplats = 0;  // sum of the tile list lengths
+    };
+
+    // Renders the first numPoints splats of cloud into a width x height image. Same as SplatRenderer::Render()
+    // with viewport (0, 0, width, height) into a framebuffer cleared to transparent black.
+    void Render(const GaussianCloud& cloud, size_t numPoints, const glm::mat4& cameraMat, const glm::mat4& projMat,
+                const glm::mat4& modelMat, const glm::vec2& nearFar, uint32_t widthIn, uint32_t heightIn,
+                const Options& options);
+
+    uint32_t GetWidth() const { return width; }
+    uint32_t GetHeight() const { return height; }
+    // premultiplied rgba per pixel, rows from bottom to top like glReadPixels()
+    const std::vector<glm::vec4>& GetColor() const { return color; }
+    // view space depth of the splat centers weighted by their contribution to the pixel, 0 where nothing was drawn
+    const std::vector<float>& GetDepth() const { return depth; }
+    const Timings& GetTimings() const { return timings; }
+    const Stats& GetStats() const { return stats; }
+
+    // name of the raster kernel selected at runtime, e.g. "avx2"
+    static const char* GetISA();
+
+    // a splat after splat_vert.glsl and splat_geom.glsl
+    struct ProjectedSplat
+    {
+        float px, py;  // window space center
+        float conicA, conicB, conicC;  // inverse of the 2d covariance, (a b, b c)
+        float r, g, b, alpha;
+        float depth;  // view space
+        uint32_t tileMin[2];  // covered tiles are [tileMin, tileMax)
+        uint32_t tileMax[2];
+    };
+
+protected:
+    void Project(const GaussianCloud& cloud, size_t count, const glm::mat4& cameraMat, const glm::mat4& projMat,
+                 const glm::mat4& modelMat, const glm::vec2& nearFar, const Options& options);
+    void BinTiles(size_t count);
+
+    CpuSplatSorter sorter;
+    std::vector<glm::vec4> posVec;  // copy of the positions of an interleaved cloud
+
+    std::vector<ProjectedSplat> projected;  // front to back, tileMin == tileMax for culled splats
+    std::vector<uint32_t> chunkTileCounts;  // per chunk of projected splats and tile
+    std::vector<uint32_t> tileOffsets;  // start of every tile list in tileSplats, numTiles + 1
+    std::vector<uint32_t> tileSplats;  // indices into projected
+
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t numTilesX = 0;
+    uint32_t numTilesY = 0;
+    std::vector<glm::vec4> color;
+    std::vector<float> depth;
+
+    Timings timings;
+    Stats stats;
+};
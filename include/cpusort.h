@@ -0,0 +1,60 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <stdint.h>
+#include <vector>
+
+// CPU version of the depth sort stage of SplatRenderer::Sort(), does not need a GPU.
+// Culls and generates the keys like presort_compute.glsl (and presort_quantize_compute.glsl for keys
+// smaller than 32 bits), using AVX2 when the cpu has it, then radix sorts the (key, index) pairs on the ThreadPool.
+class CpuSplatSorter
+{
+public:
+    struct Options
+    {
+        uint32_t depthKeyBits = 32;  // see SplatRenderer::Options::depthKeyBits
+        bool logDepthKeys = false;
+        bool forceScalar = false;  // skip the AVX2 kernel, to compare against the scalar reference
+    };
+
+    struct Timings
+    {
+        double cullSeconds = 0.0;  // culling, key generation and compaction
+        double sortSeconds = 0.0;
+    };
+
+    // positions holds numPoints (x, y, z, w) positions, w is ignored.
+    // Returns the number of visible splats. Their indices are in GetSortedIndices(), back to front,
+    // and GetSortedKeys() holds the matching keys in ascending order.
+    size_t Sort(const glm::vec4* positions, size_t numPoints, const glm::mat4& modelViewProj,
+                const glm::vec2& nearFar, const Options& options);
+
+    const std::vector<uint32_t>& GetSortedKeys() const { return *sortedKeys; }
+    const std::vector<uint32_t>& GetSortedIndices() const { return *sortedIndices; }
+    const Timings& GetTimings() const { return timings; }
+
+    // name of the culling kernel selected at runtime, e.g. "avx2"
+    static const char* GetISA();
+
+protected:
+    void RadixSort(size_t count, uint32_t numBytes);
+
+    // per chunk visible counts and depth range of the cull pass
+    struct ChunkResult
+    {
+        size_t count;
+        uint32_t minDepthBits;
+        uint32_t maxDepthBits;
+    };
+    std::vector<ChunkResult> chunkResults;
+    std::vector<uint32_t> chunkKeys;  // visible keys of each chunk, at the start of the chunk's range
+    std::vector<uint32_t> chunkIndices;
+
+    std::vector<uint32_t> keys[2];
+    std::vector<uint32_t> indices[2];
+    std::vector<uint32_t> blockHistograms;
+    std::vector<uint32_t>* sortedKeys = &keys[0];
+    std::vector<uint32_t>* sortedIndices = &indices[0];
+
+    Timings timings;
+};
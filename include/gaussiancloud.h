@@ -5,9 +5,11 @@
 
 #pragma once
 
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <glm/glm.hpp>
@@ -21,21 +23,51 @@ public:
     {
         bool importFullSH;
         bool exportFullSH;
+        bool serialImport;  // convert ply vertices on the calling thread only
+        bool genericImport;  // always use the per-property ply decoder, even for known vertex layouts
+        bool keepRotScale;  // keep the imported rot and scale, so ExportPly can write them back without an eigen decomposition
+        bool planarLayout;  // store position with alpha, sh0, cov3 and sh1..sh3 as separate tightly packed streams
     };
 
     GaussianCloud(const Options& options);
+    GaussianCloud(const GaussianCloud& orig) = delete;
+    ~GaussianCloud();
 
     bool ImportPly(const std::string& plyFilename);
+
+    // Parses the ply header and allocates storage, then converts the vertices in order on a background thread.
+    // GetNumResidentGaussians() grows as each chunk finishes, GetNumGaussians() is the final count.
+    bool ImportPlyProgressive(const std::string& plyFilename);
+
+    // expects the cloud to be fully loaded, see WaitForLoad()
     bool ExportPly(const std::string& plyFilename) const;
 
+    // Native cache that stores the gpu-ready data as is, so loading it is just a mmap.
+    // ImportCache fails if the cache is missing, was written by another version or with other import options,
+    // or if sourcePlyFilename changed since the cache was written.
+    bool ImportCache(const std::string& cacheFilename, const std::string& sourcePlyFilename);
+    bool ExportCache(const std::string& cacheFilename, const std::string& sourcePlyFilename) const;
+    static std::string GetCacheFilename(const std::string& plyFilename);
+
+    // Compact .gsz format for storage and transfer, see splatcompress.h. Positions, alpha, scale, rotation
+    // and SH are quantized per chunk of splats, so the round trip is lossy. Chunks are encoded and decoded in parallel.
+    bool ImportCompressed(const std::string& filename);
+    bool ExportCompressed(const std::string& filename) const;
+
     void InitDebugCloud();
 
     // only keep the nearest splats
     void PruneSplats(const glm::vec3& origin, uint32_t numGaussians);
 
     size_t GetNumGaussians() const { return numGaussians; }
+    // number of gaussians at the front of the data that are fully converted and safe to read.
+    size_t GetNumResidentGaussians() const { return numResident.load(std::memory_order_acquire); }
+    bool IsLoading() const { return GetNumResidentGaussians() < numGaussians; }
+    void WaitForLoad();
+    // size of one gaussian, summed over all streams for the planar layout
     size_t GetStride() const { return gaussianSize; }
     size_t GetTotalSize() const { return GetNumGaussians() * gaussianSize; }
+    bool IsPlanar() const { return opt.planarLayout; }
     void* GetRawDataPtr() { return data.get(); }
     const void* GetRawDataPtr() const { return data.get(); }
 
@@ -56,15 +88,39 @@ public:
     const BinaryAttribute& GetCov3_Col1Attrib() const { return cov3_col1Attrib; }
     const BinaryAttribute& GetCov3_Col2Attrib() const { return cov3_col2Attrib; }
 
+    // Distance in bytes between consecutive gaussians for the attribs of each stream.
+    // All of them equal GetStride() for the interleaved layout.
+    size_t GetPosWithAlphaStride() const { return posWithAlphaStride; }
+    size_t GetSH0Stride() const { return sh0Stride; }  // r_sh0, g_sh0 and b_sh0
+    size_t GetSHRestStride() const { return shRestStride; }  // r_sh1..b_sh3
+    size_t GetCov3Stride() const { return cov3Stride; }
+
+    // calls cb with the byte range of the data holding gaussians [begin, end),
+    // once for the interleaved layout and once per stream for the planar layout.
+    using DataRangeCallback = std::function<void(size_t offset, size_t size)>;
+    void ForEachDataRange(size_t begin, size_t end, const DataRangeCallback& cb) const;
+
     using ForEachPosWithAlphaCallback = std::function<void(const float*)>;
     void ForEachPosWithAlpha(const ForEachPosWithAlphaCallback& cb) const;
+    void ForEachPosWithAlphaInRange(size_t begin, size_t end, const ForEachPosWithAlphaCallback& cb) const;
 
     bool HasFullSH() const { return hasFullSH; }
 
 protected:
+    bool LoadPly(const std::string& plyFilename, bool progressive);
+    // expects numGaussians, gaussianSize and hasFullSH to be set
     void InitAttribs();
+    // allocates uninitialized data for numGaussians
+    void AllocData();
+    // Interleaved records (BaseGaussianData or FullGaussianData) of gaussians [begin, begin + count).
+    // For the interleaved layout these point into data. For the planar layout the records live in scratch
+    // (count * gaussianSize bytes): GetRecordsForRead() gathers them from the streams, StoreRecords() scatters them back.
+    uint8_t* GetRecordsForWrite(size_t begin, uint8_t* scratch);
+    void StoreRecords(size_t begin, size_t count, const uint8_t* records);
+    const uint8_t* GetRecordsForRead(size_t begin, size_t count, uint8_t* scratch) const;
 
     std::shared_ptr<void> data;
+    std::vector<float> rotScaleData;  // only filled with Options::keepRotScale
 
     BinaryAttribute posWithAlphaAttrib;
     BinaryAttribute r_sh0Attrib;
@@ -83,9 +139,18 @@ protected:
     BinaryAttribute cov3_col1Attrib;
     BinaryAttribute cov3_col2Attrib;
 
+    size_t posWithAlphaStride;
+    size_t sh0Stride;
+    size_t shRestStride;
+    size_t cov3Stride;
+
     size_t numGaussians;
     size_t gaussianSize;
 
+    std::thread loadThread;
+    std::atomic<size_t> numResident;
+    std::atomic<bool> cancelLoad;
+
     Options opt;
     bool hasFullSH;
 };
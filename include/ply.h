@@ -20,27 +20,57 @@ class Ply
 {
 public:
     Ply();
+    ~Ply();
+    Ply(const Ply& orig) = delete;
+
     bool Parse(std::ifstream& plyFile);
+
+    // parses the header, then memory-maps the vertex payload instead of reading it into memory.
+    // falls back to Parse() on platforms without mmap support.
+    bool ParseMapped(const std::string& plyFilename);
     void Dump(std::ofstream& plyFile) const;
 
+    // for streaming writers: set the vertex count without allocating data, write the header,
+    // then write GetVertexSize() bytes per vertex directly to the file.
+    void SetVertexCount(size_t numVertices) { vertexCount = numVertices; }
+    void DumpHeader(std::ofstream& plyFile) const;
+
     bool GetProperty(const std::string& key, BinaryAttribute& attributeOut) const;
     void AddProperty(const std::string& key, BinaryAttribute::Type type);
     void AllocData(size_t numVertices);
 
     using VertexCallback = std::function<void(const void*, size_t)>;
     void ForEachVertex(const VertexCallback& cb) const;
+    void ForEachVertexInRange(size_t begin, size_t end, const VertexCallback& cb) const;
 
     using VertexCallbackMut = std::function<void(void*, size_t)>;
     void ForEachVertexMut(const VertexCallbackMut& cb);
 
     size_t GetVertexCount() const { return vertexCount; }
+    size_t GetVertexSize() const { return vertexSize; }
+    const uint8_t* GetVertexData(size_t index) const { return GetData() + index * vertexSize; }
+    bool IsMapped() const { return mappedBase != nullptr; }
 
 protected:
     bool ParseHeader(std::ifstream& plyFile);
-    void DumpHeader(std::ofstream& plyFile) const;
+    // reads the vertex data that follows the header, false if the file is too short
+    bool ReadData(std::ifstream& plyFile);
+
+    enum class MapResult
+    {
+        Mapped,
+        Unavailable,  // no mmap support or the mapping failed, the data can still be read
+        Truncated  // the file is too short for the vertex data of the header
+    };
+    MapResult MapData(const std::string& plyFilename, size_t dataOffset);
+    void UnmapData();
+    const uint8_t* GetData() const { return mappedData ? mappedData : data.get(); }
 
     std::unordered_map<std::string, BinaryAttribute> propertyMap;
     std::unique_ptr<uint8_t> data;
+    void* mappedBase;
+    size_t mappedSize;
+    const uint8_t* mappedData;
     size_t vertexCount;
     size_t vertexSize;
 };
@@ -32,6 +32,8 @@ public:
 
     int GetUniformLoc(const std::string& name) const;
     int GetAttribLoc(const std::string& name) const;
+    // true if both programs have the same active attributes at the same locations, so they can share a vertex array
+    bool HasSameAttribs(const Program& other) const;
 
     template <typename T>
     void SetUniform(const std::string& name, T value) const
@@ -47,6 +49,7 @@ public:
     void SetUniformRaw(int loc, uint32_t value) const;
     void SetUniformRaw(int loc, float value) const;
     void SetUniformRaw(int loc, const glm::vec2& value) const;
+    void SetUniformRaw(int loc, const glm::uvec2& value) const;
     void SetUniformRaw(int loc, const glm::vec3& value) const;
     void SetUniformRaw(int loc, const glm::vec4& value) const;
     void SetUniformRaw(int loc, const glm::mat2& value) const;
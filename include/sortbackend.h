@@ -0,0 +1,82 @@
+#pragma once
+
+#include <memory>
+#include <stdint.h>
+#include <string>
+
+#include <vertexbuffer.h>
+
+class CpuSplatSorter;
+
+// Sorts the depth keys written by the pre-sort together with the splat indices, see SplatRenderer::Sort().
+// The number of keys is only known on the gpu, backends read it from the sort args written by
+// presort_args_compute.glsl: the element count at offset 0 and the DispatchIndirectCommand of the
+// sort workgroups at dispatchOffset.
+class SortBackend
+{
+public:
+    enum class Type
+    {
+        MultiRadix = 0,  // multi_radixsort_histograms.glsl + multi_radixsort.glsl
+        Onesweep,  // onesweep_histograms.glsl + onesweep_scatter.glsl
+        Rgc,  // rgc::radix_sort
+        Cpu,  // CpuSplatSorter, replaces the gpu pre-sort as well
+        NumTypes
+    };
+
+    struct Params
+    {
+        Type type = Type::MultiRadix;
+        uint32_t blocksPerWorkgroup = 0;  // blocks of 256 keys per sort workgroup, 0 for the backend default
+    };
+
+    static const uint32_t BLOCK_SIZE = 256;  // keys per block, the workgroup size of all sort shaders
+
+    static std::shared_ptr<SortBackend> Create(const Params& params);
+    static const char* GetTypeName(Type type);
+    // returns false if name is not one of the GetTypeName() names
+    static bool ParseType(const std::string& name, Type* typeOut);
+
+    // times every gpu backend and parameter combination on numElements keys of numBytes and returns the fastest.
+    // results are kept per gpu, driver and scene size in cacheFilename, so later runs skip the timing.
+    static Params Autotune(size_t numElements, uint32_t numBytes, const std::string& cacheFilename);
+
+    virtual ~SortBackend() {}
+
+    // allocates the key and val buffers for up to maxElements
+    virtual bool Init(size_t maxElements) = 0;
+    // sorts by the low numBytes of the keys, numPoints is the number of keys the pre-sort ran on.
+    // Backends with GetCpuSorter() have no gpu keys, they log an error and keep the previous order.
+    virtual void Sort(std::shared_ptr<BufferObject> sortArgsBuffer, intptr_t dispatchOffset,
+                      uint32_t numBytes, uint32_t numPoints) = 0;
+    // rgc::radix_sort sorts all numPoints keys, so the keys past the visible count have to sort last
+    virtual bool NeedsPaddedKeys() const { return false; }
+    // non null for backends that cull and sort on the cpu, they only upload the sorted indices to GetValBuffer()
+    virtual CpuSplatSorter* GetCpuSorter() { return nullptr; }
+
+    const Params& GetParams() const { return params; }
+    uint32_t GetBlocksPerWorkgroup() const { return params.blocksPerWorkgroup; }
+    // keys per sort workgroup, the sort args dispatch one workgroup for every this many keys
+    uint32_t GetKeysPerWorkgroup() const { return params.blocksPerWorkgroup * BLOCK_SIZE; }
+    std::string GetDescription() const;
+
+    // the pre-sort writes keys and indices here
+    std::shared_ptr<BufferObject> GetKeyBuffer() const { return keyBuffer; }
+    std::shared_ptr<BufferObject> GetValBuffer() const { return valBuffer; }
+    // where the last Sort() left them, the val buffers are element buffers the splats are drawn from
+    std::shared_ptr<BufferObject> GetSortedKeyBuffer() const { return sortedKeyBuffer; }
+    std::shared_ptr<BufferObject> GetSortedValBuffer() const { return sortedValBuffer; }
+
+protected:
+    explicit SortBackend(const Params& paramsIn) : params(paramsIn) {}
+    // pingPong allocates keyBuffer2 and valBuffer2 for backends that alternate between them every pass
+    void CreateBuffers(size_t maxElements, bool pingPong);
+
+    Params params;
+    std::shared_ptr<BufferObject> keyBuffer;
+    std::shared_ptr<BufferObject> keyBuffer2;
+    std::shared_ptr<BufferObject> valBuffer;
+    std::shared_ptr<BufferObject> valBuffer2;
+    std::shared_ptr<BufferObject> sortedKeyBuffer;
+    std::shared_ptr<BufferObject> sortedValBuffer;
+};
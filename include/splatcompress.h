@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+//
+// Quantized chunk codec for the compressed splat format, see GaussianCloud::ExportCompressed().
+// Each chunk is self-contained (it carries its own quantization ranges), so chunks encode and decode independently.
+//
+// Per splat: 16-bit positions relative to the chunk bounds, 8-bit alpha, 8-bit log scales,
+// a 32-bit smallest-three quaternion and 8-bit SH coefficients.
+// That is 17 bytes per splat without, and 62 bytes with the 45 higher order SH coefficients.
+//
+
+// number of splats per chunk, the last chunk of a cloud may hold fewer.
+static const size_t COMPRESSED_CHUNK_SIZE = 16384;
+
+// number of SH coefficients per color channel
+static const int COMPRESSED_MAX_SH_COEFFS = 16;
+
+// Structure-of-arrays view of the splats in one chunk.
+struct SplatChunk
+{
+    float* pos[3];
+    float* alpha;
+    float* logScale[3];
+    float* rot[4];  // w x y z, need not be normalized when encoding, unit length after decoding
+    float* sh[3][COMPRESSED_MAX_SH_COEFFS];  // per channel, only the first numSHCoeffs are used
+};
+
+// number of bytes of an encoded chunk of count splats, numSHCoeffs is 1 (dc only) or 16
+size_t GetCompressedChunkSize(size_t count, int numSHCoeffs);
+
+// dst must be 4 byte aligned and hold GetCompressedChunkSize(count, numSHCoeffs) bytes.
+void EncodeSplatChunk(const SplatChunk& in, size_t count, int numSHCoeffs, uint8_t* dst);
+
+// decodes count splats from src, which must be 4 byte aligned. numSHCoeffsOut coefficients are written per channel,
+// extra encoded ones are skipped and missing ones are zeroed.
+void DecodeSplatChunk(const uint8_t* src, size_t count, int numSHCoeffs, int numSHCoeffsOut, const SplatChunk& out);
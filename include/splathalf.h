@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+class GaussianCloud;
+
+//
+// Half precision gpu layout, see SplatRenderer::Options::halfPrecision.
+// Positions (and alpha) stay fp32, SH coefficients are converted to fp16, and the covariance is stored as
+// its lower triangular cholesky factor L (cov = L * L^T) in fp16. L scales with the size of the splat rather
+// than its square, so tiny and huge splats both stay well within the range of fp16.
+//
+
+struct HalfGaussianData
+{
+    float posWithAlpha[4];
+    uint16_t r_sh0[4];
+    uint16_t g_sh0[4];
+    uint16_t b_sh0[4];
+    uint16_t cov3_chol0[4];  // l00, l10, l20, l11
+    uint16_t cov3_chol1[4];  // l21, l22, unused, unused
+};
+
+struct FullHalfGaussianData : public HalfGaussianData
+{
+    uint16_t r_sh1[4];
+    uint16_t r_sh2[4];
+    uint16_t r_sh3[4];
+    uint16_t g_sh1[4];
+    uint16_t g_sh2[4];
+    uint16_t g_sh3[4];
+    uint16_t b_sh1[4];
+    uint16_t b_sh2[4];
+    uint16_t b_sh3[4];
+};
+
+// round to nearest even, values outside of the fp16 range are clamped to the largest finite half.
+uint16_t FloatToHalf(float value);
+float HalfToFloat(uint16_t value);
+
+// lower triangle of the cholesky factor of cov (xx, xy, xz, yy, yz, zz), as l00, l10, l20, l11, l21, l22.
+// degenerate (flat) covariances give zero rows instead of NaNs.
+void ComputeCovCholesky(const float cov[6], float cholOut[6]);
+
+// sizeof(HalfGaussianData) or sizeof(FullHalfGaussianData), depending on cloud.HasFullSH()
+size_t GetHalfGaussianStride(const GaussianCloud& cloud);
+
+// converts gaussians [begin, end) of cloud into the half layout, dst holds (end - begin) * GetHalfGaussianStride(cloud) bytes.
+void PackHalfGaussians(const GaussianCloud& cloud, size_t begin, size_t end, void* dst);
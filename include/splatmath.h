@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+
+//
+// Batched structure-of-arrays kernels for splat parameter activation.
+// Dispatches at runtime to AVX-512, AVX2 or a scalar fallback, depending on the cpu.
+//
+
+// number of splats activated per batch, sized so the staging arrays stay in L1/L2.
+static const size_t SPLAT_BATCH_SIZE = 1024;
+
+// Raw per-splat parameters as stored in a 3dgs ply file.
+struct SplatParamsBatch
+{
+    float* opacity;  // logit of alpha
+    float* logScale[3];  // log of the scale along each axis
+    float* rot[4];  // unnormalized quaternion, w x y z
+};
+
+// Activated parameters.
+struct SplatActivatedBatch
+{
+    float* alpha;  // sigmoid(opacity)
+    float* cov[6];  // upper triangle of the 3x3 covariance matrix: xx, xy, xz, yy, yz, zz
+};
+
+// alpha = sigmoid(opacity), cov = R * S * S^T * R^T with S = diag(exp(logScale)), R = normalized rot.
+void ActivateSplats(const SplatParamsBatch& in, const SplatActivatedBatch& out, size_t count);
+
+// Inverse of ActivateSplats: opacity = logit(alpha), rot and logScale from the eigen decomposition of cov.
+// Uses a fixed number of cyclic Jacobi sweeps that accumulate the rotation directly as a unit quaternion.
+// The axes come out in no particular order, but R * S * S^T * R^T reproduces cov to ~1e-6 of its trace.
+void DeactivateSplats(const SplatActivatedBatch& in, const SplatParamsBatch& out, size_t count);
+
+// name of the instruction set selected at runtime, e.g. "avx2"
+const char* GetSplatMathISA();
@@ -8,26 +8,106 @@
 #include <glm/glm.hpp>
 #include <memory>
 #include <stdint.h>
+#include <string>
 #include <vector>
 
 #include <program.h>
 #include <vertexbuffer.h>
 
+#include <asyncsort.h>
 #include <gaussiancloud.h>
-
-namespace rgc::radix_sort
-{
-    struct sorter;
-}
+#include <sortbackend.h>
 
 class SplatRenderer
 {
 public:
+    enum class RasterMode
+    {
+        GeometryShader = 0,  // splat_geom.glsl expands every splat into a quad
+        InstancedQuads,  // splat_vert.glsl with INSTANCED_QUADS draws one instanced quad per splat, no geometry shader
+        ComputeTiles,  // compute tile rasterizer, see SortTiles() and RenderTiles()
+        NumModes
+    };
+    static const char* GetRasterModeName(RasterMode mode);
+    // returns false if name is not one of the GetRasterModeName() names
+    static bool ParseRasterMode(const std::string& name, RasterMode* modeOut);
+
+    struct Options
+    {
+        bool halfPrecision;  // store SH and covariance as fp16 on the gpu, see splathalf.h
+        // 32 quantizes depth / far into the sort keys. 16 or 24 quantize the visible depth range instead,
+        // which keeps the depth resolution with one or two fewer radix sort passes.
+        uint32_t depthKeyBits = 32;
+        bool logDepthKeys = false;  // quantize log(depth) when depthKeyBits is 16 or 24
+        SortBackend::Params sortBackend;
+        // time every sort backend on the first Init() and use the fastest instead of sortBackend,
+        // the result is remembered per gpu and driver in sortTuneCacheFile.
+        bool autotuneSort = false;
+        std::string sortTuneCacheFile = "sort_autotune.txt";
+        // cull and sort on a worker thread per viewport with the cpu sorter and draw the newest finished order, see AsyncSplatSorter.
+        // Hides the sort latency at the cost of at least one frame of order lag, sortBackend and sortReuse are ignored.
+        bool asyncSort = false;
+        // ComputeTiles sorts (tile, depth) keys on the gpu, depthKeyBits, asyncSort and the cpu sort backend are ignored.
+        RasterMode rasterMode = RasterMode::GeometryShader;
+        // the tile keys are first allocated for this many tiles per splat on average. Views that need more drop
+        // the rest for a few frames, until the instance count is read back and the keys are grown to fit.
+        uint32_t avgTilesPerSplat = 4;
+        // project, cull and shade the splats once in preprocess_compute.glsl instead of the pre-sort, so the sort and
+        // the draw only see splats that cover a pixel. Needs the gpu sort, ignored with ComputeTiles and asyncSort.
+        bool fusedPreprocess = false;
+    };
+
+    // Sort() keeps the previous sort while the camera stays close to the pose it was sorted for.
+    // Changes to the projection, near/far, model matrix or the number of uploaded splats always re-sort.
+    // Every viewport, like each eye in VR, has its own previous sort.
+    struct SortReuseOptions
+    {
+        bool enabled = false;
+        float maxAngleDeg = 0.5f;  // camera rotation since the last sort
+        float maxTranslation = 0.01f;  // camera translation since the last sort, in world units
+        uint32_t maxFrames = 30;  // re-sort after this many reused frames, 0 for no limit
+    };
+
+    // fragments of the splat draw, counted with Render() when countFragments is set
+    struct FragmentStats
+    {
+        uint64_t numShaded = 0;  // fragment shader invocations, the quads rasterized
+        uint64_t numBlended = 0;  // samples that were not discarded, the fragments without multisampling
+    };
+
+    // fragments of the splat draws with overdrawDebug, summed over the Render() calls since ResetOverdrawStats()
+    struct OverdrawStats
+    {
+        static const int NUM_BINS = 16;
+        uint64_t numShaded = 0;  // fragment shader invocations
+        uint64_t numDiscarded = 0;  // fragments below the 1/256 alpha threshold
+        uint32_t maxPerPixel = 0;  // most fragments shaded on one pixel
+        // pixels by the number of fragments shaded on them. Bin 0 holds the pixels without fragments,
+        // bin i the ones with [2^(i - 1), 2^i) fragments and the last bin everything above.
+        uint64_t histogram[NUM_BINS] = {};
+    };
+
+    struct SortStats
+    {
+        uint64_t numSorted = 0;
+        uint64_t numReused = 0;
+    };
+
+    // how far the order being drawn lags behind the camera, only with Options::asyncSort. With several views
+    // like the eyes in VR, each has its own worker and this is the lag of the view sorted last.
+    struct SortStaleness
+    {
+        uint32_t frames = 0;  // Sort() calls since the pose of the order was requested
+        float translation = 0.0f;  // camera translation since that pose, in world units
+        float angleDeg = 0.0f;  // camera rotation since that pose
+        double sortSeconds = 0.0;  // worker time of the order
+    };
+
     SplatRenderer();
     ~SplatRenderer();
 
     bool Init(std::shared_ptr<GaussianCloud> gaussianCloud,
-              bool isFramebufferSRGBEnabledIn, bool useRgcSortOverrideIn);
+              bool isFramebufferSRGBEnabledIn, const Options& optionsIn);
 
     void Sort(const glm::mat4& cameraMat, const glm::mat4& projMat,
               const glm::mat4& modelMat, const glm::vec4& viewport,
@@ -38,32 +118,187 @@ public:
                 const glm::mat4& modelMat, const glm::vec4& viewport,
                 const glm::vec2& nearFar);
 public:
-    uint32_t numBlocksPerWorkgroup = 1024;
+    SortReuseOptions sortReuse;
+    // read back the sorted keys after every sort and log whether they are in order, stalls the pipeline.
+    bool validateSort = false;
+    // size every splat quad by the radius where its alpha falls below the 1/256 discard threshold instead of a fixed
+    // 3.5 sigma, and cull splats that are too transparent to show at all. Same image with fewer fragments.
+    bool opacityBounds = true;
+    // count the fragments of the splat draw with pipeline statistics queries, read back a few frames later.
+    // Not available on GLES or with RasterMode::ComputeTiles.
+    bool countFragments = false;
+    const FragmentStats& GetFragmentStats() const { return fragmentStats; }
+    // count the fragments of every splat draw per pixel with atomics in splat_frag.glsl and replace the splats with
+    // an overdraw heatmap, reads the counts back after every draw. The counting shaders are a separate program built
+    // the first time this is set. Not available on GLES or with RasterMode::ComputeTiles.
+    bool overdrawDebug = false;
+    float overdrawHeatmapMax = 256.0f;  // fragments per pixel at the red end of the heatmap
+    const OverdrawStats& GetOverdrawStats() const { return overdrawStats; }
+    void ResetOverdrawStats() { overdrawStats = OverdrawStats(); }
+    // counts every Sort() call, a VR frame sorts once per eye.
+    const SortStats& GetSortStats() const { return sortStats; }
+    void ResetSortStats() { sortStats = SortStats(); }
+    const SortStaleness& GetSortStaleness() const { return sortStaleness; }
+    // the backend Init() picked, after autotuning if enabled
+    const SortBackend::Params& GetSortBackendParams() const { return sortBackend->GetParams(); }
+    std::string GetSortBackendDescription() const { return sortBackend->GetDescription(); }
+    // number of splats uploaded to the gpu, less than the cloud size while it is loading progressively.
+    size_t GetNumUploadedSplats() const { return numUploaded; }
+    // size in bytes of the per splat vertex data on the gpu
+    size_t GetGpuDataSize() const { return gpuStride * cloud->GetNumGaussians(); }
+    // gpu time of the newest finished Render() call, measured with timer queries a few frames behind.
+    // 0 where timer queries are not available.
+    double GetDrawGpuMs() const { return drawGpuMs; }
 protected:
     void BuildVertexArrayObject(std::shared_ptr<GaussianCloud> gaussianCloud);
+    void UploadResidentSplats();
+    struct SortedState;
+    bool CanReuseSort(const SortedState& view, const glm::mat4& cameraMat, const glm::mat4& projMat,
+                      const glm::mat4& modelMat, const glm::vec2& nearFar) const;
+    // the sort state of the view drawn into viewport, a new one if the viewport was not drawn recently
+    SortedState& GetSortView(const glm::vec4& viewport);
+    // saves the new order of view for sortReuse while more than one view is drawn
+    void FinishSort(SortedState& view, size_t numPoints);
+    // draws the saved order of view again
+    void RestoreSort(const SortedState& view);
+    // binds the val buffer of sortBackend holding the sorted indices as the element buffer of splatVao
+    void SetSortedElementBuffer(std::shared_ptr<BufferObject> sortedValBuffer);
+    // copies splats [begin, end) into gaussianDataBuffer, converting them to the half layout if needed
+    void UploadSplatData(size_t begin, size_t end);
+    // culls, sorts and uploads the indices with the CpuSplatSorter of the cpu sort backend
+    void SortOnCpu(CpuSplatSorter* cpuSorter, const glm::mat4& modelViewProj, const glm::vec2& nearFar, size_t numPoints);
+    // requests a sort for this pose from the async sorter of view and uploads its newest finished order
+    void SortAsync(SortedState& view, const glm::mat4& cameraMat, const glm::mat4& modelViewProj,
+                   const glm::vec2& nearFar, size_t numPoints);
+    // positions of the uploaded splats for the cpu sorters
+    const glm::vec4* GetCpuPositions() const;
+    // writes what the gpu pre-sort and sort would have, the sorted indices and the draw count
+    void UploadSortedIndices(const uint32_t* sortedIndices, size_t sortCount);
+    void ValidateSort(std::shared_ptr<BufferObject> sortedKeyBuffer, size_t numPoints);
+    void LogSortCheck(const uint32_t* sortedKeys, uint32_t sortCount) const;
+    // uniforms of splat_common.glsl
+    void SetSplatUniforms(std::shared_ptr<Program> prog, const glm::mat4& cameraMat, const glm::mat4& projMat,
+                          const glm::mat4& modelMat, const glm::vec4& viewport, const glm::vec2& nearFar);
+    // compute tile rasterizer: projects the splats, writes one key per splat and overlapped tile, sorts them
+    // and finds the splat list of every tile
+    void SortTiles(const glm::mat4& cameraMat, const glm::mat4& projMat, const glm::mat4& modelMat,
+                   const glm::vec4& viewport, const glm::vec2& nearFar, size_t numPoints);
+    // checks the tile instance count of an earlier SortTiles() call and grows the sort backend if it overflowed
+    void ReadTileCount();
+    // blends every tile front to back in shared memory and composites the result into the viewport
+    void RenderTiles(const glm::vec4& viewport);
+    // (re)allocates the tile ranges and the output image for this viewport size
+    void ResizeTiles(uint32_t width, uint32_t height);
+    // #defines of splat_common.glsl for the cloud and options
+    std::string GetSplatDefines(std::shared_ptr<GaussianCloud> gaussianCloud) const;
+    // #defines with the word offsets and strides of the splat data for splat_common.glsl with VERTEX_PULLING
+    std::string GetVertexPullingDefines(std::shared_ptr<GaussianCloud> gaussianCloud) const;
+    void BeginDrawTimer();
+    void EndDrawTimer();
+    void BeginFragmentCount();
+    void EndFragmentCount();
+    // builds overdrawSplatProg on first use, false if overdrawDebug is not available
+    bool LoadOverdrawSplatProg();
+    // clears the overdraw counters and binds them for splat_frag.glsl with OVERDRAW_DEBUG
+    void BeginOverdraw(const glm::vec4& viewport);
+    // builds the histogram, reads back the counts and draws the heatmap over the viewport
+    void EndOverdraw(const glm::vec4& viewport);
 
-    std::shared_ptr<rgc::radix_sort::sorter> sorter;
+    std::shared_ptr<SortBackend> sortBackend;
     std::shared_ptr<Program> splatProg;
+    std::string splatDefines;  // #defines of splatProg
     std::shared_ptr<Program> preSortProg;
-    std::shared_ptr<Program> histogramProg;
-    std::shared_ptr<Program> sortProg;
+    std::shared_ptr<Program> preprocessProg;  // replaces preSortProg with Options::fusedPreprocess
+    std::shared_ptr<Program> preSortArgsProg;
+    std::shared_ptr<Program> preSortQuantizeProg;
+    std::shared_ptr<Program> tileKeysProg;
+    std::shared_ptr<Program> tileRangesProg;
+    std::shared_ptr<Program> tileRasterProg;
+    std::shared_ptr<Program> tileCompositeProg;
+    std::shared_ptr<Program> overdrawSplatProg;  // splatProg with OVERDRAW_DEBUG, built when overdrawDebug is first set
+    std::shared_ptr<Program> overdrawHistogramProg;  // nullptr where overdrawDebug is not available
+    std::shared_ptr<Program> overdrawHeatmapProg;
     std::shared_ptr<VertexArrayObject> splatVao;
+    std::shared_ptr<VertexArrayObject> compositeVao;  // no attributes, the fullscreen triangle comes from gl_VertexID
+    std::shared_ptr<GaussianCloud> cloud;
 
-    std::vector<uint32_t> indexVec;
-    std::vector<uint32_t> depthVec;
     std::vector<glm::vec4> posVec;
     std::vector<uint32_t> atomicCounterVec;
+    std::vector<uint32_t> indirectArgsVec;
+    std::vector<uint32_t> depthRangeVec;
+    size_t maxSortKeys;  // size the sort backend was initialized for
 
     std::shared_ptr<BufferObject> gaussianDataBuffer;
-    std::shared_ptr<BufferObject> keyBuffer;
-    std::shared_ptr<BufferObject> keyBuffer2;
-    std::shared_ptr<BufferObject> histogramBuffer;
-    std::shared_ptr<BufferObject> valBuffer;
-    std::shared_ptr<BufferObject> valBuffer2;
     std::shared_ptr<BufferObject> posBuffer;
     std::shared_ptr<BufferObject> atomicCounterBuffer;
+    std::shared_ptr<BufferObject> indirectArgsBuffer;  // draw and sort dispatch args, see presort_args_compute.glsl
+    std::shared_ptr<BufferObject> depthRangeBuffer;  // visible depth range for depthKeyBits < 32
+    std::shared_ptr<BufferObject> validateKeyBuffer;  // readable copy of the sorted keys, see ValidateSort()
+    std::shared_ptr<BufferObject> projectedSplatBuffer;  // written by splat_vert.glsl with TILE_PROJECT
+    std::shared_ptr<BufferObject> preprocessedSplatBuffer;  // visible splats of preprocess_compute.glsl
+    std::vector<uint32_t> tileRangeVec;  // always zero
+    std::shared_ptr<BufferObject> tileRangeBuffer;  // [start, end) of every tile in the sorted keys
+    uint32_t tileColorTexture;  // rgba16f output of tile_raster_compute.glsl, 0 until ResizeTiles()
+    uint32_t tileWidth;  // size tileColorTexture and tileRangeBuffer are allocated for
+    uint32_t tileHeight;
+    uint32_t tileDepthBits;  // low bits of the tile keys that hold the depth
+    static const int NUM_TILE_COUNT_READS = 4;  // tile instance counts are read back this many SortTiles() calls later
+    std::shared_ptr<BufferObject> tileCountBuffers[NUM_TILE_COUNT_READS];  // copies of the tile instance count
+    bool tileCountPending[NUM_TILE_COUNT_READS];
+    int tileCountIndex;
+    size_t tileKeysOverflow;  // largest instance count the sort backend could not grow to, 0 if none
+
+    std::vector<uint32_t> overdrawCounterVec;  // shaded and discarded fragments, always zero
+    std::shared_ptr<BufferObject> overdrawCounterBuffer;  // atomic counters of splat_frag.glsl
+    std::vector<uint32_t> overdrawPixelVec;  // always zero
+    std::shared_ptr<BufferObject> overdrawPixelBuffer;  // fragments shaded per pixel of the viewport
+    std::vector<uint32_t> overdrawHistogramVec;  // always zero, the max and the bins of overdraw_histogram_compute.glsl
+    std::shared_ptr<BufferObject> overdrawHistogramBuffer;
+    OverdrawStats overdrawStats;
+
+    static const int NUM_DRAW_QUERIES = 4;  // results are read back this many Render() calls later
+    uint32_t drawQueries[NUM_DRAW_QUERIES][2];  // start and end timestamps
+    bool drawQueryPending[NUM_DRAW_QUERIES];
+    int drawQueryIndex;
+    double drawGpuMs;
+    uint32_t fragmentQueries[NUM_DRAW_QUERIES][2];  // fragment shader invocations and samples passed
+    bool fragmentQueryPending[NUM_DRAW_QUERIES];
+    int fragmentQueryIndex;
+    FragmentStats fragmentStats;
+
+    Options opt;
+
+    // pose and state the last order of one view was sorted for. Views are told apart by their viewport,
+    // so each eye in VR reuses its own sort.
+    struct SortedState
+    {
+        glm::vec4 viewport = glm::vec4(0.0f);
+        glm::mat4 cameraMat = glm::mat4(1.0f);
+        glm::mat4 projMat = glm::mat4(1.0f);
+        glm::mat4 modelMat = glm::mat4(1.0f);
+        glm::vec2 nearFar = glm::vec2(0.0f);
+        size_t numPoints = 0;
+        bool valid = false;
+        uint32_t numReusedSinceSort = 0;
+        uint64_t lastUse = 0;  // numSortCalls of the last Sort() of this view
+        // copies of the sorted indices and the draw args, the sort backend only holds the order sorted last
+        std::shared_ptr<BufferObject> valBuffer;
+        std::shared_ptr<BufferObject> argsBuffer;
+        bool saved = false;  // valBuffer and argsBuffer hold the order of this state
+        // the worker of Options::asyncSort for this view, it reads posVec or the cloud, so it is stopped before they change
+        std::unique_ptr<AsyncSplatSorter> asyncSorter;
+    };
+    static const int MAX_SORT_VIEWS = 2;  // both eyes in VR
+    SortedState sortViews[MAX_SORT_VIEWS];
+    int numSortViews;
+    uint64_t numSortCalls;
+    const AsyncSplatSorter* asyncUploadedSorter;  // the async sorter whose order is in the val buffer
+    SortStats sortStats;
+    SortStaleness sortStaleness;
 
-    uint32_t sortCount;
+    size_t numUploaded;
+    size_t gpuStride;
+    bool sharedPosStream;  // pre-sort reads the position stream of a planar cloud from gaussianDataBuffer, no posBuffer
+    bool progressive;
     bool isFramebufferSRGBEnabled;
-    bool useRgcSortOverride;
 };
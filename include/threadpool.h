@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent pool of worker threads used to split CPU-heavy loops (ply import, export etc.) across cores.
+class ThreadPool
+{
+public:
+    using RangeCallback = std::function<void(size_t begin, size_t end)>;
+
+    // numThreadsIn = 0 will use one thread per hardware core (including the calling thread).
+    explicit ThreadPool(uint32_t numThreadsIn = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool& orig) = delete;
+
+    // shared pool, created on first use
+    static ThreadPool& Get();
+
+    uint32_t GetNumThreads() const { return (uint32_t)workers.size() + 1; }
+
+    // Splits [0, count) into chunks of grainSize elements and calls cb(begin, end) for each chunk.
+    // Chunks are handed out dynamically, so threads that finish early pick up remaining work.
+    // The calling thread participates and the call blocks until every chunk is done.
+    // Nested calls from inside cb run serially on the calling thread.
+    void ParallelFor(size_t count, size_t grainSize, const RangeCallback& cb);
+
+    // For background work that is split into many short ParallelFor() calls, like the progressive import.
+    // Returns once no other thread is waiting to start a ParallelFor(), so the render thread goes first.
+    void WaitForOtherCallers() const;
+
+protected:
+    void WorkerMain();
+    void RunChunks();
+
+    std::vector<std::thread> workers;
+
+    std::mutex jobMutex;  // serializes ParallelFor() callers
+    std::atomic<uint32_t> numWaitingCallers;  // ParallelFor() callers blocked on jobMutex
+    std::mutex mutex;
+    std::condition_variable wakeCv;
+    std::condition_variable doneCv;
+
+    const RangeCallback* jobCb;
+    size_t jobCount;
+    size_t jobGrainSize;
+    std::atomic<size_t> nextChunk;
+    uint64_t jobId;
+    uint32_t activeWorkers;
+    bool quit;
+};
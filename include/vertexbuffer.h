@@ -50,6 +50,8 @@ public:
 	void Update(const std::vector<glm::vec3>& data);
 	void Update(const std::vector<glm::vec4>& data);
 	void Update(const std::vector<uint32_t>& data);
+	// update size bytes starting at offset, requires GL_DYNAMIC_STORAGE_BIT
+	void Update(size_t offset, const void* data, size_t size);
 
 	void Read(std::vector<uint32_t>& data);
 
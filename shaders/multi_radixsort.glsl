@@ -10,17 +10,25 @@
 
 #define WORKGROUP_SIZE 256// assert WORKGROUP_SIZE >= RADIX_SORT_BINS
 #define RADIX_SORT_BINS 256
-#define SUBGROUP_SIZE 32// 32 NVIDIA; 64 AMD
+/*%%DEFINES%%*/
+#ifndef SUBGROUP_SIZE
+#define SUBGROUP_SIZE 32// 32 NVIDIA; 64 AMD, set from GL_SUBGROUP_SIZE_KHR by MultiRadixSortBackend
+#endif
 
 #define BITS 32// sorting uint32_t
 
 layout (local_size_x = WORKGROUP_SIZE) in;
 
-uniform uint g_num_elements;
 uniform uint g_shift;
-uniform uint g_num_workgroups;
 uniform uint g_num_blocks_per_workgroup;
 
+// indirect args written by presort_args_compute.glsl, the element count is only known on the gpu
+layout (std430, binding = 5) readonly buffer sort_args {
+    uint g_num_elements;// DrawElementsIndirectCommand.count
+    uint g_draw_args[4];
+    uint g_num_workgroups;// DispatchIndirectCommand.num_groups_x
+};
+
 layout (std430, binding = 0) buffer elements_in {
     uint g_elements_in[];
 };
@@ -79,7 +87,7 @@ void main() {
     barrier();
 
     if (lID < RADIX_SORT_BINS) {
-        const uint sums_prefix_sum = subgroupBroadcast(subgroupExclusiveAdd(sums[lsID]), sID);
+        const uint sums_prefix_sum = subgroupBroadcast(subgroupExclusiveAdd(lsID < RADIX_SORT_BINS / SUBGROUP_SIZE ? sums[lsID] : 0u), sID);
         const uint global_histogram = sums_prefix_sum + prefix_sum;
         global_offsets[lID] = global_histogram + local_histogram;
     }
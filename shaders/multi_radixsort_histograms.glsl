@@ -8,11 +8,14 @@
 #define WORKGROUP_SIZE 256 // assert WORKGROUP_SIZE >= RADIX_SORT_BINS
 #define RADIX_SORT_BINS 256
 
-uniform uint g_num_elements;
 uniform uint g_shift;
-//uniform uint g_num_workgroups;
 uniform uint g_num_blocks_per_workgroup;
 
+// indirect args written by presort_args_compute.glsl, the element count is only known on the gpu
+layout (std430, binding = 5) readonly buffer sort_args {
+    uint g_num_elements; // DrawElementsIndirectCommand.count
+};
+
 layout (local_size_x = WORKGROUP_SIZE) in;
 
 layout (std430, binding = 0) buffer elements_in {
@@ -0,0 +1,75 @@
+/*%%HEADER%%*/
+/*%%DEFINES%%*/
+
+// First pass of the onesweep radix sort, see onesweep_scatter.glsl.
+// Counts the digits of every radix pass in one read of the keys, and clears the look-back
+// status of this workgroup's tile for the scatter passes that follow.
+
+#define WORKGROUP_SIZE 256
+#define RADIX_SORT_BINS 256
+#define MAX_PASSES 4
+
+layout(local_size_x = WORKGROUP_SIZE) in;
+
+uniform uint g_num_passes;
+uniform uint g_max_tiles;
+
+// indirect args written by presort_args_compute.glsl, the element count is only known on the gpu
+layout(std430, binding = 5) readonly buffer sort_args
+{
+    uint g_num_elements;  // DrawElementsIndirectCommand.count
+};
+
+layout(std430, binding = 0) readonly buffer elements_in
+{
+    uint g_elements_in[];
+};
+
+layout(std430, binding = 1) buffer digit_counts
+{
+    // [pass 0 digit counts | ... | pass 3 digit counts | tile counter of each pass]
+    uint g_digit_counts[];
+};
+
+layout(std430, binding = 6) writeonly buffer tile_status
+{
+    uint g_tile_status[];  // [pass][tile][bin]
+};
+
+shared uint histogram[MAX_PASSES * RADIX_SORT_BINS];
+
+void main()
+{
+    uint lID = gl_LocalInvocationID.x;
+    uint wID = gl_WorkGroupID.x;
+
+    for (uint pass = 0u; pass < MAX_PASSES; pass++)
+    {
+        histogram[pass * RADIX_SORT_BINS + lID] = 0u;
+    }
+    barrier();
+
+    for (uint index = 0u; index < BLOCKS_PER_TILE; index++)
+    {
+        uint elementId = (wID * BLOCKS_PER_TILE + index) * WORKGROUP_SIZE + lID;
+        if (elementId < g_num_elements)
+        {
+            uint key = g_elements_in[elementId];
+            for (uint pass = 0u; pass < g_num_passes; pass++)
+            {
+                atomicAdd(histogram[pass * RADIX_SORT_BINS + ((key >> (8u * pass)) & uint(RADIX_SORT_BINS - 1))], 1u);
+            }
+        }
+    }
+    barrier();
+
+    for (uint pass = 0u; pass < g_num_passes; pass++)
+    {
+        uint count = histogram[pass * RADIX_SORT_BINS + lID];
+        if (count != 0u)
+        {
+            atomicAdd(g_digit_counts[pass * RADIX_SORT_BINS + lID], count);
+        }
+        g_tile_status[(pass * g_max_tiles + wID) * RADIX_SORT_BINS + lID] = 0u;
+    }
+}
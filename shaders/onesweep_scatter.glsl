@@ -0,0 +1,192 @@
+/*%%HEADER%%*/
+/*%%DEFINES%%*/
+
+// One digit pass of a onesweep radix sort (Adinets and Merrill, "Onesweep: A Faster Least Significant
+// Digit Radix Sort for GPUs"). The global digit offsets come from onesweep_histograms.glsl, so unlike
+// multi_radixsort.glsl there is no histogram pass per digit. Each tile publishes its digit counts and
+// finds the counts of the tiles before it with a decoupled look-back, then scatters its keys stably.
+
+#define WORKGROUP_SIZE 256
+#define RADIX_SORT_BINS 256
+#define MAX_PASSES 4
+#define BITS 32
+
+// tile status, the flag sits in the top two bits of the count
+#define FLAG_NOT_READY 0u
+#define FLAG_AGGREGATE 1u  // count of this tile only
+#define FLAG_PREFIX 2u  // count of this tile and all tiles before it
+#define FLAG_SHIFT 30u
+#define COUNT_MASK 0x3fffffffu
+
+layout(local_size_x = WORKGROUP_SIZE) in;
+
+uniform uint g_pass;
+uniform uint g_max_tiles;
+
+// indirect args written by presort_args_compute.glsl, the element count is only known on the gpu
+layout(std430, binding = 5) readonly buffer sort_args
+{
+    uint g_num_elements;  // DrawElementsIndirectCommand.count
+};
+
+layout(std430, binding = 0) readonly buffer elements_in
+{
+    uint g_elements_in[];
+};
+
+layout(std430, binding = 1) writeonly buffer elements_out
+{
+    uint g_elements_out[];
+};
+
+layout(std430, binding = 2) readonly buffer indices_in
+{
+    uint g_indices_in[];
+};
+
+layout(std430, binding = 3) writeonly buffer indices_out
+{
+    uint g_indices_out[];
+};
+
+layout(std430, binding = 4) buffer digit_counts
+{
+    // [pass 0 digit counts | ... | pass 3 digit counts | tile counter of each pass]
+    uint g_digit_counts[];
+};
+
+layout(std430, binding = 6) coherent buffer tile_status
+{
+    uint g_tile_status[];  // [pass][tile][bin]
+};
+
+struct BinFlags
+{
+    uint flags[WORKGROUP_SIZE / BITS];
+};
+
+shared uint tile_id;
+shared uint local_counts[RADIX_SORT_BINS];
+shared uint global_offsets[RADIX_SORT_BINS];
+shared BinFlags bin_flags[RADIX_SORT_BINS];
+
+void main()
+{
+    uint lID = gl_LocalInvocationID.x;
+    uint shift = 8u * g_pass;
+
+    // tiles are numbered in the order they start, so the tiles a look-back waits on are already running
+    if (lID == 0u)
+    {
+        tile_id = atomicAdd(g_digit_counts[MAX_PASSES * RADIX_SORT_BINS + g_pass], 1u);
+    }
+    local_counts[lID] = 0u;
+    global_offsets[lID] = g_digit_counts[g_pass * RADIX_SORT_BINS + lID];
+    barrier();
+
+    uint tile = tile_id;
+
+    // the keys stay in registers from the tile count to the scatter
+    uint keys[BLOCKS_PER_TILE];
+    for (uint index = 0u; index < BLOCKS_PER_TILE; index++)
+    {
+        uint elementId = (tile * BLOCKS_PER_TILE + index) * WORKGROUP_SIZE + lID;
+        keys[index] = 0u;
+        if (elementId < g_num_elements)
+        {
+            keys[index] = g_elements_in[elementId];
+            atomicAdd(local_counts[(keys[index] >> shift) & uint(RADIX_SORT_BINS - 1)], 1u);
+        }
+    }
+
+    // inclusive scan of the global digit counts
+    for (uint offset = 1u; offset < RADIX_SORT_BINS; offset <<= 1u)
+    {
+        uint sum = (lID >= offset) ? global_offsets[lID - offset] : 0u;
+        barrier();
+        global_offsets[lID] += sum;
+        barrier();
+    }
+
+    // ==== decoupled look-back, one thread per bin =====
+    uint bin_count = local_counts[lID];
+    uint digit_start = global_offsets[lID] - g_digit_counts[g_pass * RADIX_SORT_BINS + lID];
+    uint status_base = g_pass * g_max_tiles * RADIX_SORT_BINS + lID;
+
+    uint exclusive = 0u;
+    if (tile == 0u)
+    {
+        atomicExchange(g_tile_status[status_base], (FLAG_PREFIX << FLAG_SHIFT) | bin_count);
+    }
+    else
+    {
+        atomicExchange(g_tile_status[status_base + tile * RADIX_SORT_BINS], (FLAG_AGGREGATE << FLAG_SHIFT) | bin_count);
+
+        uint lookback = tile - 1u;
+        while (true)
+        {
+            uint status = atomicAdd(g_tile_status[status_base + lookback * RADIX_SORT_BINS], 0u);
+            uint flag = status >> FLAG_SHIFT;
+            if (flag == FLAG_NOT_READY)
+            {
+                continue;
+            }
+            exclusive += status & COUNT_MASK;
+            if (flag == FLAG_PREFIX)
+            {
+                break;
+            }
+            lookback--;
+        }
+
+        atomicExchange(g_tile_status[status_base + tile * RADIX_SORT_BINS], (FLAG_PREFIX << FLAG_SHIFT) | (exclusive + bin_count));
+    }
+    global_offsets[lID] = digit_start + exclusive;
+
+    // ==== scatter keys according to global offsets, same stable ranking as multi_radixsort.glsl =====
+    const uint flags_bin = lID / BITS;
+    const uint flags_bit = 1u << (lID % BITS);
+
+    for (uint index = 0u; index < BLOCKS_PER_TILE; index++)
+    {
+        uint elementId = (tile * BLOCKS_PER_TILE + index) * WORKGROUP_SIZE + lID;
+
+        for (uint i = 0u; i < WORKGROUP_SIZE / BITS; i++)
+        {
+            bin_flags[lID].flags[i] = 0u;
+        }
+        barrier();
+
+        uint binID = 0u;
+        uint binOffset = 0u;
+        if (elementId < g_num_elements)
+        {
+            binID = (keys[index] >> shift) & uint(RADIX_SORT_BINS - 1);
+            binOffset = global_offsets[binID];
+            atomicAdd(bin_flags[binID].flags[flags_bin], flags_bit);
+        }
+        barrier();
+
+        if (elementId < g_num_elements)
+        {
+            uint prefix = 0u;
+            uint count = 0u;
+            for (uint i = 0u; i < WORKGROUP_SIZE / BITS; i++)
+            {
+                uint bits = bin_flags[binID].flags[i];
+                uint full_count = uint(bitCount(bits));
+                uint partial_count = uint(bitCount(bits & (flags_bit - 1u)));
+                prefix += (i < flags_bin) ? full_count : 0u;
+                prefix += (i == flags_bin) ? partial_count : 0u;
+                count += full_count;
+            }
+            g_elements_out[binOffset + prefix] = keys[index];
+            g_indices_out[binOffset + prefix] = g_indices_in[elementId];
+            if (prefix == count - 1u)
+            {
+                atomicAdd(global_offsets[binID], count);
+            }
+        }
+        barrier();
+    }
+}
@@ -0,0 +1,34 @@
+/*%%HEADER%%*/
+
+// replaces the splats in the viewport with the fragments shaded per pixel by splat_frag.glsl with OVERDRAW_DEBUG,
+// on a log scale from black (none) over blue and green to red (maxOverdraw or more)
+
+uniform vec4 viewport;  // x, y, WIDTH, HEIGHT
+uniform float maxOverdraw;
+
+layout(std430, binding = 0) readonly buffer OverdrawPixelBuffer
+{
+    uint pixelCounts[];
+};
+
+out vec4 out_color;
+
+// blue, cyan, green, yellow, red for t from 0 to 1
+vec3 HeatColor(float t)
+{
+    return clamp(vec3(1.5f - abs(4.0f * t - 4.0f), 1.5f - abs(4.0f * t - 2.0f), 1.5f - abs(4.0f * t)), 0.0f, 1.0f);
+}
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy - viewport.xy);
+    uint count = pixelCounts[pixel.y * int(viewport.z) + pixel.x];
+    if (count == 0u)
+    {
+        out_color = vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        return;
+    }
+
+    float t = clamp(log2(float(count) + 1.0f) / log2(maxOverdraw + 1.0f), 0.0f, 1.0f);
+    out_color = vec4(HeatColor(t), 1.0f);
+}
@@ -0,0 +1,59 @@
+/*%%HEADER%%*/
+
+// Runs after a splat draw with SplatRenderer::overdrawDebug, bins the pixels of the viewport by the number of
+// fragments splat_frag.glsl shaded on them. Bin 0 holds the pixels without fragments, bin i the ones with
+// [2^(i - 1), 2^i) fragments and the last bin everything above.
+
+layout(local_size_x = 256) in;
+
+#define NUM_BINS 16u  // SplatRenderer::OverdrawStats::NUM_BINS
+
+uniform uint numPixels;
+
+layout(std430, binding = 0) readonly buffer OverdrawPixelBuffer
+{
+    uint pixelCounts[];
+};
+
+layout(std430, binding = 1) buffer HistogramBuffer
+{
+    uint maxCount;
+    uint bins[NUM_BINS];
+};
+
+shared uint groupBins[NUM_BINS];
+shared uint groupMaxCount;
+
+void main()
+{
+    uint idx = gl_GlobalInvocationID.x;
+
+    // binned per workgroup first, so there are only a few global atomics per group
+    if (gl_LocalInvocationIndex < NUM_BINS)
+    {
+        groupBins[gl_LocalInvocationIndex] = 0u;
+    }
+    if (gl_LocalInvocationIndex == 0u)
+    {
+        groupMaxCount = 0u;
+    }
+    barrier();
+
+    if (idx < numPixels)
+    {
+        uint count = pixelCounts[idx];
+        uint bin = count == 0u ? 0u : min(uint(findMSB(count)) + 1u, NUM_BINS - 1u);
+        atomicAdd(groupBins[bin], 1u);
+        atomicMax(groupMaxCount, count);
+    }
+    barrier();
+
+    if (gl_LocalInvocationIndex < NUM_BINS && groupBins[gl_LocalInvocationIndex] > 0u)
+    {
+        atomicAdd(bins[gl_LocalInvocationIndex], groupBins[gl_LocalInvocationIndex]);
+    }
+    if (gl_LocalInvocationIndex == 0u)
+    {
+        atomicMax(maxCount, groupMaxCount);
+    }
+}
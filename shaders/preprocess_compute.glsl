@@ -0,0 +1,168 @@
+/*%%HEADER%%*/
+
+/*%%DEFINES%%*/
+
+/*%%SPLAT_COMMON%%*/
+
+// Fused replacement of presort_compute.glsl for Options::fusedPreprocess. Every splat is projected once, with the
+// covariance and sh of splat_vert.glsl, and only the ones that can write a fragment are kept. The survivors are
+// written compactly as PreprocessedSplat records together with their sort keys, so the sort and the draw only ever
+// see visible splats and splat_vert.glsl with PREPROCESSED just reads the record back. The keys, the depth range
+// and the visible count are the ones presort_compute.glsl writes, the rest of the sort runs unchanged.
+
+layout(local_size_x = 256) in;
+
+const float MIN_ALPHA = 1.0f / 256.0f;  // the discard threshold of splat_frag.glsl
+
+uniform vec2 nearFar;
+uniform uint keyMax;
+uniform uint numPoints;  // may be less than the splat data while the cloud is still loading
+uniform uint depthRangeKeys;  // write the raw depth and its range, presort_quantize_compute.glsl makes the keys
+
+struct PreprocessedSplat
+{
+    vec4 center;  // screen space center in xy, ndc depth in z, clip w in w
+    vec4 conic;  // inverse of the 2D screen space covariance matrix (a, b, c)
+    vec4 color;  // radiance and alpha
+};
+
+layout(std430, binding = 0) writeonly buffer PreprocessedSplatBuffer
+{
+    PreprocessedSplat preprocessedSplats[];
+};
+
+// binding 1 is the splat data of splat_common.glsl
+
+layout(std430, binding = 2) writeonly buffer KeyBuffer
+{
+    uint quantizedZs[];
+};
+
+// bit patterns of the nearest and farthest visible depth, positive floats order like uints
+layout(std430, binding = 3) buffer DepthRangeBuffer
+{
+    uint minDepthBits;
+    uint maxDepthBits;
+};
+
+layout(std430, binding = 4) writeonly buffer ValBuffer
+{
+    uint indices[];
+};
+
+layout(std430, binding = 5) buffer CountBuffer
+{
+    uint visibleCount;
+};
+
+shared uint groupCount;
+shared uint groupBase;
+shared uint groupMinDepthBits;
+shared uint groupMaxDepthBits;
+
+// false if the splat cannot write a single fragment, the tests are conservative so culling never changes the image
+bool IsVisible(vec4 p4, vec4 cov2, vec2 p, float alpha)
+{
+    // the guard band of splat_geom.glsl, and splats behind the camera or the far plane which are clipped entirely
+    vec3 ndcP = p4.xyz / p4.w;
+    if (!(p4.w > 0.0f) || ndcP.z < 0.25f || ndcP.z > 1.0f ||
+        ndcP.x > 2.0f || ndcP.x < -2.0f ||
+        ndcP.y > 2.0f || ndcP.y < -2.0f)
+    {
+        return false;
+    }
+
+    // splat_frag.glsl discards every fragment of near transparent splats
+    if (!(alpha > MIN_ALPHA))
+    {
+        return false;
+    }
+
+    float det = cov2.x * cov2.w - cov2.y * cov2.y;
+    if (!(det > 0.0f))
+    {
+        return false;
+    }
+
+    // fragments are only kept where alpha * exp(-0.5 * r2) > MIN_ALPHA, with r2 = d^T cov2^-1 d. That is inside
+    // the ellipse r2 = 2 ln(alpha / MIN_ALPHA), which spans sqrt(r2 * cov_xx) in x and sqrt(r2 * cov_yy) in y.
+    // Splats whose ellipse bounds hold no pixel center k + 0.5 of the viewport are sub-pixel or off screen.
+    float r2 = 2.0f * log(alpha / MIN_ALPHA);
+    vec2 extent = sqrt(r2 * vec2(cov2.x, cov2.w));
+    vec2 firstPixel = max(ceil(p - extent - 0.5f), viewport.xy);
+    vec2 lastPixel = min(floor(p + extent - 0.5f), viewport.xy + viewport.zw - 1.0f);
+    return all(lessThanEqual(firstPixel, lastPixel));
+}
+
+void main()
+{
+    uint idx = gl_GlobalInvocationID.x;
+
+    if (gl_LocalInvocationIndex == 0u)
+    {
+        groupCount = 0u;
+        groupMinDepthBits = 0xffffffffu;
+        groupMaxDepthBits = 0u;
+    }
+    barrier();
+
+    PreprocessedSplat s;
+    bool visible = false;
+    uint localSlot = 0u;
+    if (idx < numPoints)
+    {
+        LoadSplat(idx);
+        vec4 cov2;
+        vec2 p;
+        vec4 color;
+        vec4 p4 = ProjectSplat(cov2, p, color);
+        visible = IsVisible(p4, cov2, p, color.a);
+        if (visible)
+        {
+            float det = cov2.x * cov2.w - cov2.y * cov2.y;
+            s.center = vec4(p, p4.z / p4.w, p4.w);
+            s.conic = vec4(cov2.w / det, -cov2.y / det, cov2.x / det, 0.0f);
+            s.color = color;
+
+            // slots are handed out in shared memory, the whole workgroup reserves them with one global atomic below
+            localSlot = atomicAdd(groupCount, 1u);
+            if (depthRangeKeys != 0u)
+            {
+                uint depthBits = floatBitsToUint(p4.w);
+                atomicMin(groupMinDepthBits, depthBits);
+                atomicMax(groupMaxDepthBits, depthBits);
+            }
+        }
+    }
+
+    barrier();
+    if (gl_LocalInvocationIndex == 0u)
+    {
+        groupBase = groupCount > 0u ? atomicAdd(visibleCount, groupCount) : 0u;
+        if (depthRangeKeys != 0u && groupMinDepthBits <= groupMaxDepthBits)
+        {
+            atomicMin(minDepthBits, groupMinDepthBits);
+            atomicMax(maxDepthBits, groupMaxDepthBits);
+        }
+    }
+    barrier();
+
+    if (visible)
+    {
+        uint i = groupBase + localSlot;
+        preprocessedSplats[i] = s;
+
+        float depth = s.center.w;
+        if (depthRangeKeys != 0u)
+        {
+            quantizedZs[i] = floatBitsToUint(depth);
+        }
+        else
+        {
+            quantizedZs[i] = keyMax - uint((depth / nearFar.y) * keyMax);
+        }
+
+        // the sort permutes the record indices, the draw reads the records through them
+        indices[i] = i;
+    }
+}
@@ -0,0 +1,81 @@
+/*%%HEADER%%*/
+
+// Runs right after presort_compute.glsl and turns the number of visible splats into the indirect
+// arguments of the sort and draw, so the count never has to be read back on the cpu.
+
+layout(local_size_x = 256) in;
+
+uniform uint numPoints;  // keys the pre-sort could have written
+uniform uint keysPerWorkgroup;  // SortBackend::GetKeysPerWorkgroup(), one sort workgroup per this many keys
+uniform uint padKeys;  // sorts that always process numPoints keys need the invisible ones pushed to the end
+uniform uint quantizeLocalSize;  // local size of presort_quantize_compute.glsl
+
+layout(std430, binding = 0) readonly buffer CountBuffer
+{
+    uint visibleCount;  // the atomic counter of presort_compute.glsl
+};
+
+layout(std430, binding = 1) writeonly buffer KeyBuffer
+{
+    uint keys[];
+};
+
+layout(std430, binding = 3) writeonly buffer IndirectArgsBuffer
+{
+    // DrawElementsIndirectCommand
+    uint drawCount;
+    uint drawInstanceCount;
+    uint drawFirstIndex;
+    int drawBaseVertex;
+    uint drawBaseInstance;
+
+    // DispatchIndirectCommand for the radix sort passes
+    uint sortNumGroupsX;
+    uint sortNumGroupsY;
+    uint sortNumGroupsZ;
+
+    // DispatchIndirectCommand for presort_quantize_compute.glsl
+    uint quantizeNumGroupsX;
+    uint quantizeNumGroupsY;
+    uint quantizeNumGroupsZ;
+
+    // DrawArraysIndirectCommand for the instanced quads of splat_vert.glsl with INSTANCED_QUADS
+    uint quadDrawCount;
+    uint quadDrawInstanceCount;
+    uint quadDrawFirst;
+    uint quadDrawBaseInstance;
+};
+
+void main()
+{
+    uint idx = gl_GlobalInvocationID.x;
+    // the tile keys of tile_keys_compute.glsl count the instances past the end of the key buffer as well
+    uint count = min(visibleCount, numPoints);
+
+    if (idx == 0u)
+    {
+        drawCount = count;
+        drawInstanceCount = 1u;
+        drawFirstIndex = 0u;
+        drawBaseVertex = 0;
+        drawBaseInstance = 0u;
+
+        sortNumGroupsX = (count + keysPerWorkgroup - 1u) / keysPerWorkgroup;
+        sortNumGroupsY = 1u;
+        sortNumGroupsZ = 1u;
+
+        quantizeNumGroupsX = (count + quantizeLocalSize - 1u) / quantizeLocalSize;
+        quantizeNumGroupsY = 1u;
+        quantizeNumGroupsZ = 1u;
+
+        quadDrawCount = 4u;
+        quadDrawInstanceCount = count;
+        quadDrawFirst = 0u;
+        quadDrawBaseInstance = 0u;
+    }
+
+    if (padKeys != 0u && idx >= count && idx < numPoints)
+    {
+        keys[idx] = 0xffffffffu;
+    }
+}
@@ -10,6 +10,8 @@ layout(local_size_x = 256) in;
 uniform mat4 modelViewProj;
 uniform vec2 nearFar;
 uniform uint keyMax;
+uniform uint numPoints;  // may be less than positions.length() while the cloud is still loading
+uniform uint depthRangeKeys;  // write the raw depth and its range, presort_quantize_compute.glsl makes the keys
 
 layout(binding = 4, offset = 0) uniform atomic_uint output_count;
 
@@ -28,30 +30,62 @@ layout(std430, binding = 2) writeonly buffer OutputBuffer2
     uint indices[];
 };
 
+// bit patterns of the nearest and farthest visible depth, positive floats order like uints
+layout(std430, binding = 3) buffer DepthRangeBuffer
+{
+    uint minDepthBits;
+    uint maxDepthBits;
+};
+
+shared uint groupMinDepthBits;
+shared uint groupMaxDepthBits;
+
 void main()
 {
     uint idx = gl_GlobalInvocationID.x;
 
-	uint len = uint(positions.length());
-    if (idx >= len)
+    // the range is reduced per workgroup first, so there are only two global atomics per group
+    if (gl_LocalInvocationIndex == 0u)
     {
-        return;
+        groupMinDepthBits = 0xffffffffu;
+        groupMaxDepthBits = 0u;
     }
+    barrier();
 
-    // NOTE: alpha is encoded into the w component of the positions
-    vec4 p = modelViewProj * vec4(positions[idx].xyz, 1.0f);
-    float depth = p.w;
-    float xx = p.x / depth;
-    float yy = p.y / depth;
+    if (idx < numPoints)
+    {
+        // NOTE: alpha is encoded into the w component of the positions
+        vec4 p = modelViewProj * vec4(positions[idx].xyz, 1.0f);
+        float depth = p.w;
+        float xx = p.x / depth;
+        float yy = p.y / depth;
+
+        const float CLIP = 1.5f;
+        if (depth > 0.0f && xx < CLIP && xx > -CLIP && yy < CLIP && yy > -CLIP)
+        {
+            uint count = atomicCounterIncrement(output_count);
+            if (depthRangeKeys != 0u)
+            {
+                uint depthBits = floatBitsToUint(depth);
+                atomicMin(groupMinDepthBits, depthBits);
+                atomicMax(groupMaxDepthBits, depthBits);
+                quantizedZs[count] = depthBits;
+            }
+            else
+            {
+                // 16.16 fixed point
+                //uint fixedPointZ = uint(0xffffffff) - uint(clamp(depth, 0.0f, 65535.0f) * 65536.0f);
+                uint fixedPointZ = keyMax - uint((depth / nearFar.y) * keyMax);
+                quantizedZs[count] = fixedPointZ;
+            }
+            indices[count] = idx;
+        }
+    }
 
-    const float CLIP = 1.5f;
-    if (depth > 0.0f && xx < CLIP && xx > -CLIP && yy < CLIP && yy > -CLIP)
+    barrier();
+    if (depthRangeKeys != 0u && gl_LocalInvocationIndex == 0u && groupMinDepthBits <= groupMaxDepthBits)
     {
-        uint count = atomicCounterIncrement(output_count);
-        // 16.16 fixed point
-        //uint fixedPointZ = uint(0xffffffff) - uint(clamp(depth, 0.0f, 65535.0f) * 65536.0f);
-		uint fixedPointZ = keyMax - uint((depth / nearFar.y) * keyMax);
-        quantizedZs[count] = fixedPointZ;
-        indices[count] = idx;
+        atomicMin(minDepthBits, groupMinDepthBits);
+        atomicMax(maxDepthBits, groupMaxDepthBits);
     }
 }
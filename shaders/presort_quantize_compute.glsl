@@ -0,0 +1,53 @@
+/*%%HEADER%%*/
+
+// Runs after presort_args_compute.glsl when SplatRenderer::Options::depthKeyBits is below 32.
+// presort_compute.glsl wrote the raw view depth of every visible splat as its key, this maps the depths
+// onto the visible range [minDepth, maxDepth] so 16 or 24 bit keys keep the resolution of the full 32 bit ones.
+
+layout(local_size_x = 256) in;
+
+uniform uint keyMax;  // (1 << depthKeyBits) - 1
+uniform uint logDepth;  // spend the key resolution evenly on log(depth) instead of depth
+
+layout(std430, binding = 1) buffer KeyBuffer
+{
+    uint keys[];
+};
+
+layout(std430, binding = 3) readonly buffer DepthRangeBuffer
+{
+    uint minDepthBits;
+    uint maxDepthBits;
+};
+
+layout(std430, binding = 5) readonly buffer IndirectArgsBuffer
+{
+    uint visibleCount;  // DrawElementsIndirectCommand.count
+};
+
+void main()
+{
+    uint idx = gl_GlobalInvocationID.x;
+
+    if (idx >= visibleCount)
+    {
+        return;
+    }
+
+    float minDepth = uintBitsToFloat(minDepthBits);
+    float maxDepth = uintBitsToFloat(maxDepthBits);
+    float depth = uintBitsToFloat(keys[idx]);
+
+    float t;
+    if (logDepth != 0u)
+    {
+        t = log(depth / minDepth) / max(log(maxDepth / minDepth), 1e-20f);
+    }
+    else
+    {
+        t = (depth - minDepth) / max(maxDepth - minDepth, 1e-20f);
+    }
+
+    // far splats get the small keys, so they are drawn first
+    keys[idx] = keyMax - uint(clamp(t, 0.0f, 1.0f) * float(keyMax));
+}
@@ -9,12 +9,28 @@
 
 /*%%HEADER%%*/
 
+/*%%DEFINES%%*/
+
 in vec4 frag_color;  // radiance of splat
 in vec4 frag_cov2inv;  // inverse of the 2D screen space covariance matrix of the guassian
 in vec2 frag_p;  // 2D screen space center of the guassian
 
 out vec4 out_color;
 
+#ifdef OVERDRAW_DEBUG
+// only in the program SplatRenderer::overdrawDebug draws with, counts every fragment,
+// see overdraw_histogram_compute.glsl and overdraw_heatmap_frag.glsl
+uniform vec4 viewport;  // x, y, WIDTH, HEIGHT
+
+layout(binding = 0, offset = 0) uniform atomic_uint numShaded;
+layout(binding = 0, offset = 4) uniform atomic_uint numDiscarded;
+
+layout(std430, binding = 3) buffer OverdrawPixelBuffer
+{
+    uint pixelCounts[];  // fragments shaded per pixel of the viewport, row major
+};
+#endif
+
 void main()
 {
     vec2 d = gl_FragCoord.xy - frag_p;
@@ -27,15 +43,22 @@ void main()
     out_color.rgb = frag_color.a * g * frag_color.rgb;
     out_color.a = frag_color.a * g;
 
-    /*
-    // can be used to determine overdraw.
-    float epsilon = 1.0f / 256.0f;
-    out_color.rgb = frag_color.a * g * frag_color.rgb;
-    out_color.rgb = frag_color.rgb * 0.00000001f + vec3(epsilon, epsilon, epsilon);
-    out_color.a = 0.0f;
-    */
+    bool discarded = (frag_color.a * g) <= (1.0f / 256.0f);
+
+#ifdef OVERDRAW_DEBUG
+    atomicCounterIncrement(numShaded);
+    if (discarded)
+    {
+        atomicCounterIncrement(numDiscarded);
+    }
+    ivec2 pixel = ivec2(gl_FragCoord.xy - viewport.xy);
+    if (all(greaterThanEqual(pixel, ivec2(0))) && all(lessThan(pixel, ivec2(viewport.zw))))
+    {
+        atomicAdd(pixelCounts[pixel.y * int(viewport.z) + pixel.x], 1u);
+    }
+#endif
 
-    if ((frag_color.a * g) <= (1.0f / 256.0f))
+    if (discarded)
     {
         discard;
     }
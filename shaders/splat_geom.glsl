@@ -6,6 +6,7 @@
 /*%%HEADER%%*/
 
 uniform vec4 viewport;  // x, y, WIDTH, HEIGHT
+uniform uint opacityBounds;  // size the quad by the opacity of the splat instead of a fixed 3.5 sigma
 
 layout(points) in;
 layout(triangle_strip, max_vertices = 4) out;
@@ -53,9 +54,21 @@ void main()
         return;
     }
 
+    // splat_frag.glsl discards where alpha * exp(-0.5 * k^2) <= 1/256, so the quad only has to reach that k
+    float k = 3.5f;
+    if (opacityBounds != 0u)
+    {
+        float alpha = geom_color[0].a;
+        if (alpha <= (1.0f / 256.0f))
+        {
+            // every fragment would be discarded
+            return;
+        }
+        k = min(sqrt(2.0f * log(alpha * 256.0f)), 3.5f);
+    }
+
     // compute 2d extents for the splat, using covariance matrix ellipse
     // see https://cookierobotics.com/007/
-    float k = 3.5f;
     float a = cov2D[0][0];
     float b = cov2D[0][1];
     float c = cov2D[1][1];
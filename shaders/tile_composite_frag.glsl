@@ -0,0 +1,13 @@
+/*%%HEADER%%*/
+
+// blends the premultiplied output of tile_raster_compute.glsl with GL_ONE, GL_ONE_MINUS_SRC_ALPHA like the splats
+
+uniform vec4 viewport;  // x, y, WIDTH, HEIGHT
+uniform sampler2D tileColor;
+
+out vec4 out_color;
+
+void main()
+{
+    out_color = texelFetch(tileColor, ivec2(gl_FragCoord.xy - viewport.xy), 0);
+}
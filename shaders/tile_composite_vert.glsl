@@ -0,0 +1,9 @@
+/*%%HEADER%%*/
+
+// fullscreen triangle over the viewport, drawn without vertex attributes
+
+void main(void)
+{
+    vec2 uv = vec2(float((gl_VertexID << 1) & 2), float(gl_VertexID & 2));
+    gl_Position = vec4(uv * 2.0f - 1.0f, 0.0f, 1.0f);
+}
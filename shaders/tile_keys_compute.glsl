@@ -0,0 +1,128 @@
+/*%%HEADER%%*/
+
+// First pass of the compute tile rasterizer, runs after splat_vert.glsl wrote the projected splats with TILE_PROJECT.
+// Culls with the guard band and the extents of splat_geom.glsl and writes one key per tile the splat overlaps:
+// the tile index in the high bits and the log depth in the low ones, so sorting the keys groups the splats by tile
+// and orders every tile front to back. The splat is rewritten in place with the inverse covariance for tile_raster_compute.glsl.
+
+layout(local_size_x = 256) in;
+
+#define TILE_SIZE 16.0f
+
+uniform uint numPoints;
+uniform uint maxInstances;  // size of the key buffer, instances past it are dropped
+uniform vec4 viewport;  // x, y, WIDTH, HEIGHT
+uniform uvec2 numTiles;
+uniform uint depthBits;  // the tile index is stored above the low depthBits of the keys
+uniform uint depthKeyMax;  // (1 << depthBits) - 1
+uniform vec2 nearFar;
+uniform uint opacityBounds;  // same as splat_geom.glsl
+
+struct ProjectedSplat
+{
+    vec4 clipPos;
+    vec4 cov2;  // inverse covariance (a, b, c) after this pass
+    vec4 color;
+    vec4 p;  // window space center, relative to the viewport after this pass
+};
+
+layout(std430, binding = 0) buffer ProjectedSplatBuffer
+{
+    ProjectedSplat splats[];
+};
+
+layout(std430, binding = 1) writeonly buffer KeyBuffer
+{
+    uint keys[];
+};
+
+layout(std430, binding = 2) writeonly buffer ValBuffer
+{
+    uint vals[];
+};
+
+layout(std430, binding = 3) buffer CountBuffer
+{
+    uint instanceCount;  // may end up past maxInstances
+};
+
+void main()
+{
+    uint idx = gl_GlobalInvocationID.x;
+    if (idx >= numPoints)
+    {
+        return;
+    }
+
+    ProjectedSplat s = splats[idx];
+
+    // discard splats that end up outside of a guard band
+    vec3 ndcP = s.clipPos.xyz / s.clipPos.w;
+    if (ndcP.z < 0.25f ||
+        ndcP.x > 2.0f || ndcP.x < -2.0f ||
+        ndcP.y > 2.0f || ndcP.y < -2.0f)
+    {
+        return;
+    }
+
+    float a = s.cov2.x;
+    float b = s.cov2.y;
+    float c = s.cov2.w;
+    float det = a * c - b * b;
+    if (!(det > 0.0f))
+    {
+        return;
+    }
+
+    float k = 3.5f;
+    if (opacityBounds != 0u)
+    {
+        // every pixel would fall below the 1/256 alpha threshold of tile_raster_compute.glsl
+        if (s.color.a <= (1.0f / 256.0f))
+        {
+            return;
+        }
+        k = min(sqrt(2.0f * log(s.color.a * 256.0f)), 3.5f);
+    }
+
+    // axis aligned bounds of the quad of splat_geom.glsl
+    float apco2 = (a + c) / 2.0f;
+    float amco2 = (a - c) / 2.0f;
+    float term = sqrt(amco2 * amco2 + b * b);
+    float maj = apco2 + term;
+    float min = max(apco2 - term, 0.0f);
+    float theta = (b == 0.0f) ? ((a >= c) ? 0.0f : radians(90.0f)) : atan(maj - a, b);
+    float r1 = k * sqrt(maj);
+    float r2 = k * sqrt(min);
+    vec2 extent = vec2(abs(r1 * cos(theta)) + abs(r2 * sin(theta)),
+                       abs(r1 * sin(theta)) + abs(r2 * cos(theta)));
+
+    // clamped as floats, huge splats would overflow the conversion to uint
+    vec2 center = s.p.xy - viewport.xy;
+    uvec2 tileMin = uvec2(clamp(floor((center - extent) / TILE_SIZE), vec2(0.0f), vec2(numTiles)));
+    uvec2 tileMax = uvec2(clamp(floor((center + extent) / TILE_SIZE) + 1.0f, vec2(0.0f), vec2(numTiles)));
+    uint count = (tileMax.x - tileMin.x) * (tileMax.y - tileMin.y);
+    if (count == 0u)
+    {
+        return;
+    }
+
+    splats[idx].cov2 = vec4(c / det, -b / det, a / det, 0.0f);
+    splats[idx].p = vec4(center, 0.0f, 0.0f);
+
+    // w is the view depth, near splats get the small keys
+    float t = log(s.clipPos.w / nearFar.x) / log(nearFar.y / nearFar.x);
+    // float(depthKeyMax) can round up past it, which would carry into the tile bits
+    uint depthKey = min(uint(clamp(t, 0.0f, 1.0f) * float(depthKeyMax)), depthKeyMax);
+
+    uint instance = atomicAdd(instanceCount, count);
+    for (uint y = tileMin.y; y < tileMax.y; y++)
+    {
+        for (uint x = tileMin.x; x < tileMax.x && instance < maxInstances; x++)
+        {
+            keys[instance] = ((y * numTiles.x + x) << depthBits) | depthKey;
+            vals[instance] = idx;
+            instance++;
+        }
+    }
+}
@@ -0,0 +1,10 @@
+/*%%HEADER%%*/
+
+// splat_vert.glsl with TILE_PROJECT runs with GL_RASTERIZER_DISCARD, this only completes the program.
+
+out vec4 out_color;
+
+void main()
+{
+    out_color = vec4(0.0f);
+}
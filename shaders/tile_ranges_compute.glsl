@@ -0,0 +1,43 @@
+/*%%HEADER%%*/
+
+// Runs after the tile keys of tile_keys_compute.glsl are sorted, finds where the list of every tile starts and ends.
+// Tiles no splat overlaps keep the empty range the buffer was cleared to.
+
+layout(local_size_x = 256) in;
+
+uniform uint depthBits;
+
+layout(std430, binding = 0) readonly buffer KeyBuffer
+{
+    uint keys[];
+};
+
+layout(std430, binding = 1) writeonly buffer TileRangeBuffer
+{
+    uvec2 tileRanges[];  // [start, end) in the sorted keys
+};
+
+layout(std430, binding = 5) readonly buffer IndirectArgsBuffer
+{
+    uint instanceCount;  // DrawElementsIndirectCommand.count
+};
+
+void main()
+{
+    uint idx = gl_GlobalInvocationID.x;
+    uint count = instanceCount;
+    if (idx >= count)
+    {
+        return;
+    }
+
+    uint tile = keys[idx] >> depthBits;
+    if (idx == 0u || (keys[idx - 1u] >> depthBits) != tile)
+    {
+        tileRanges[tile].x = idx;
+    }
+    if (idx == count - 1u || (keys[idx + 1u] >> depthBits) != tile)
+    {
+        tileRanges[tile].y = idx + 1u;
+    }
+}
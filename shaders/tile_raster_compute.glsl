@@ -0,0 +1,116 @@
+/*%%HEADER%%*/
+
+// Last pass of the compute tile rasterizer, one workgroup per 16x16 pixel tile and one invocation per pixel.
+// The splats of the tile are fetched into shared memory a batch at a time and blended front to back, which
+// matches the GL_ONE, GL_ONE_MINUS_SRC_ALPHA blending of splat_frag.glsl. A pixel stops once almost nothing
+// behind it could still show, the workgroup stops once all of its pixels have.
+
+layout(local_size_x = 16, local_size_y = 16) in;
+
+#define BATCH_SIZE 256u
+const float MIN_ALPHA = 1.0f / 256.0f;  // the discard threshold of splat_frag.glsl
+const float MIN_TRANSMITTANCE = 1.0f / 256.0f;
+
+uniform uvec2 numTiles;
+uniform uvec2 viewportSize;
+
+// premultiplied color, the composite pass blends it over the framebuffer
+layout(rgba16f, binding = 0) uniform writeonly image2D outColor;
+
+struct ProjectedSplat
+{
+    vec4 clipPos;
+    vec4 conic;  // inverse covariance (a, b, c), see tile_keys_compute.glsl
+    vec4 color;
+    vec4 p;  // center relative to the viewport
+};
+
+layout(std430, binding = 0) readonly buffer ProjectedSplatBuffer
+{
+    ProjectedSplat splats[];
+};
+
+layout(std430, binding = 1) readonly buffer ValBuffer
+{
+    uint vals[];  // splat indices, sorted by tile and depth
+};
+
+layout(std430, binding = 2) readonly buffer TileRangeBuffer
+{
+    uvec2 tileRanges[];
+};
+
+shared vec4 batchCenterAlpha[BATCH_SIZE];  // center in xy, alpha in z
+shared vec4 batchConic[BATCH_SIZE];
+shared vec4 batchColor[BATCH_SIZE];
+shared uint numDone;
+
+void main()
+{
+    uvec2 pixel = gl_GlobalInvocationID.xy;
+    uint tile = gl_WorkGroupID.y * numTiles.x + gl_WorkGroupID.x;
+    uvec2 range = tileRanges[tile];
+
+    // gl_FragCoord is at the pixel center
+    vec2 fragCoord = vec2(pixel) + vec2(0.5f);
+    bool inside = pixel.x < viewportSize.x && pixel.y < viewportSize.y;
+    bool done = !inside;
+
+    if (gl_LocalInvocationIndex == 0u)
+    {
+        numDone = 0u;
+    }
+    barrier();
+    if (done)
+    {
+        atomicAdd(numDone, 1u);
+    }
+
+    float T = 1.0f;
+    vec3 C = vec3(0.0f);
+    for (uint batchStart = range.x; batchStart < range.y; batchStart += BATCH_SIZE)
+    {
+        // numDone only changes after the second barrier, so every invocation sees the same count here
+        barrier();
+        if (numDone == BATCH_SIZE)
+        {
+            break;
+        }
+
+        uint i = batchStart + gl_LocalInvocationIndex;
+        if (i < range.y)
+        {
+            ProjectedSplat s = splats[vals[i]];
+            batchCenterAlpha[gl_LocalInvocationIndex] = vec4(s.p.xy, s.color.a, 0.0f);
+            batchConic[gl_LocalInvocationIndex] = s.conic;
+            batchColor[gl_LocalInvocationIndex] = s.color;
+        }
+        barrier();
+
+        uint batchCount = min(BATCH_SIZE, range.y - batchStart);
+        for (uint j = 0u; j < batchCount && !done; j++)
+        {
+            vec2 d = fragCoord - batchCenterAlpha[j].xy;
+            vec3 conic = batchConic[j].xyz;
+            float power = -0.5f * (conic.x * d.x * d.x + 2.0f * conic.y * d.x * d.y + conic.z * d.y * d.y);
+            float alpha = batchCenterAlpha[j].z * exp(power);
+            if (alpha <= MIN_ALPHA)
+            {
+                continue;
+            }
+
+            C += T * alpha * batchColor[j].rgb;
+            T *= 1.0f - alpha;
+            if (T < MIN_TRANSMITTANCE)
+            {
+                done = true;
+                atomicAdd(numDone, 1u);
+            }
+        }
+    }
+
+    if (inside)
+    {
+        imageStore(outColor, ivec2(pixel), vec4(C, 1.0f - T));
+    }
+}
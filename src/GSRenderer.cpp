@@ -33,11 +33,18 @@ void GSRenderer::setScreenShaderUniforms(const Shader& screenShader) {
 
 RenderStats GSRenderer::drawSplats(std::shared_ptr<GaussianCloud> gaussianCloud, const Scene& scene, const Camera& camera, uint32_t clearMask) {
     RenderStats stats;
-    if (!splatRendererInitialized && !splatRenderer->Init(gaussianCloud, isFramebufferSRGBEnabled, useRgcSortOverride)) {
+    if (!splatRendererInitialized && !splatRenderer->Init(gaussianCloud, isFramebufferSRGBEnabled, splatOptions)) {
         spdlog::error("Error initializing splat renderer!");
         return stats;
     }
     splatRendererInitialized = true;
+    splatRenderer->sortReuse = sortReuse;
+    splatRenderer->validateSort = validateSort;
+    splatRenderer->opacityBounds = opacityBounds;
+    splatRenderer->countFragments = countFragments;
+    splatRenderer->overdrawDebug = overdrawDebug;
+    splatRenderer->overdrawHeatmapMax = overdrawHeatmapMax;
+    splatRenderer->ResetOverdrawStats();
 
     beginRendering();
 
@@ -78,7 +85,7 @@ RenderStats GSRenderer::drawSplats(std::shared_ptr<GaussianCloud> gaussianCloud,
         frameRT.setViewport({ 0, 0, width, height });
         frameRT.setScissor({ 0, 0, width, height });
 
-        stats.trianglesDrawn = static_cast<uint>(gaussianCloud->GetNumGaussians()) * 2;
+        stats.trianglesDrawn = static_cast<uint>(splatRenderer->GetNumUploadedSplats()) * 2;
         stats.drawCalls = 2;
     }
     else {
@@ -96,7 +103,7 @@ RenderStats GSRenderer::drawSplats(std::shared_ptr<GaussianCloud> gaussianCloud,
         splatRenderer->Sort(cameraMat, projMat, modelMat, viewport, nearFar);
         splatRenderer->Render(cameraMat, projMat, modelMat, viewport, nearFar);
 
-        stats.trianglesDrawn = static_cast<uint>(gaussianCloud->GetNumGaussians());
+        stats.trianglesDrawn = static_cast<uint>(splatRenderer->GetNumUploadedSplats());
         stats.drawCalls = 1;
     }
 
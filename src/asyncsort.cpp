@@ -0,0 +1,96 @@
+#include <asyncsort.h>
+
+#ifdef TRACY_ENABLE
+#include <tracy/Tracy.hpp>
+#else
+#define ZoneScoped
+#define ZoneScopedNC(NAME, COLOR)
+#endif
+
+AsyncSplatSorter::AsyncSplatSorter() :
+    lastStartedId(0),
+    writeSlot(0),
+    readySlot(1),
+    readSlot(2),
+    readyIsNew(false),
+    quit(false)
+{
+    worker = std::thread(&AsyncSplatSorter::WorkerMain, this);
+}
+
+AsyncSplatSorter::~AsyncSplatSorter()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    requestCv.notify_all();
+    readyCv.notify_all();
+    worker.join();
+}
+
+uint64_t AsyncSplatSorter::Request(const glm::vec4* positions, size_t numPoints, const glm::mat4& cameraMat,
+                                   const glm::mat4& modelViewProj, const glm::vec2& nearFar, const CpuSplatSorter::Options& options)
+{
+    uint64_t id;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        id = pendingRequest.id + 1;
+        pendingRequest = { positions, numPoints, cameraMat, modelViewProj, nearFar, options, id };
+    }
+    requestCv.notify_one();
+    return id;
+}
+
+bool AsyncSplatSorter::AcquireNewest(bool wait)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (wait)
+    {
+        readyCv.wait(lock, [this]() { return readyIsNew || quit; });
+    }
+    if (!readyIsNew)
+    {
+        return false;
+    }
+
+    std::swap(readySlot, readSlot);
+    readyIsNew = false;
+    return true;
+}
+
+void AsyncSplatSorter::WorkerMain()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        requestCv.wait(lock, [this]() { return quit || pendingRequest.id > lastStartedId; });
+        if (quit)
+        {
+            return;
+        }
+
+        // sort the newest pose, requests that come in meanwhile replace each other
+        const SortRequest request = pendingRequest;
+        lastStartedId = request.id;
+        Result& result = slots[writeSlot];
+        lock.unlock();
+
+        {
+            ZoneScopedNC("AsyncSplatSorter::Sort", tracy::Color::Red4);
+
+            const size_t count = sorter.Sort(request.positions, request.numPoints, request.modelViewProj, request.nearFar, request.options);
+            result.indices.assign(sorter.GetSortedIndices().begin(), sorter.GetSortedIndices().begin() + count);
+            result.keys.assign(sorter.GetSortedKeys().begin(), sorter.GetSortedKeys().begin() + count);
+            result.count = count;
+            result.cameraMat = request.cameraMat;
+            result.requestId = request.id;
+            result.sortSeconds = sorter.GetTimings().cullSeconds + sorter.GetTimings().sortSeconds;
+        }
+
+        lock.lock();
+        std::swap(writeSlot, readySlot);
+        readyIsNew = true;
+        readyCv.notify_all();
+    }
+}
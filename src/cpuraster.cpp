@@ -0,0 +1,575 @@
+#include <cpuraster.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#ifdef TRACY_ENABLE
+#include <tracy/Tracy.hpp>
+#else
+#define ZoneScoped
+#define ZoneScopedNC(NAME, COLOR)
+#endif
+
+#include <threadpool.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CPURASTER_X86
+#include <immintrin.h>
+#endif
+
+static const uint32_t TILE_SIZE = CpuSplatRasterizer::TILE_SIZE;
+static const uint32_t TILE_PIXELS = TILE_SIZE * TILE_SIZE;
+
+// splats projected per ThreadPool chunk
+static const size_t PROJECT_GRAIN_SIZE = 4096;
+static const size_t POS_GRAIN_SIZE = 16384;
+
+// smallest number of splats a binning block is worth spreading over a thread
+static const size_t BIN_MIN_BLOCK_SIZE = 16384;
+
+// same as splat_geom.glsl and splat_frag.glsl
+static const float EXTENT_SIGMAS = 3.5f;
+static const float MIN_ALPHA = 1.0f / 256.0f;
+
+using ProjectedSplat = CpuSplatRasterizer::ProjectedSplat;
+
+static float SRGBToLinear(float srgb)
+{
+    return srgb <= 0.04045f ? srgb / 12.92f : powf((srgb + 0.055f) / 1.055f, 2.4f);
+}
+
+// SH basis for view direction v, same as ComputeRadianceFromSH() in splat_vert.glsl
+static void ComputeSHBasis(const glm::vec3& v, float b[16])
+{
+    float vx2 = v.x * v.x, vy2 = v.y * v.y, vz2 = v.z * v.z;
+    const float k1 = 0.4886025119029199f, k2 = 1.0925484305920792f, k3 = 0.31539156525252005f, k4 = 0.5462742152960396f;
+    const float k5 = 0.5900435899266435f, k6 = 2.8906114426405543f, k7 = 0.4570457994644658f, k8 = 0.37317633259011546f;
+    const float k9 = 1.4453057213202771f;
+    b[0] = 0.28209479177387814f;
+    b[1] = -k1 * v.y;
+    b[2] = k1 * v.z;
+    b[3] = -k1 * v.x;
+    b[4] = k2 * v.y * v.x;
+    b[5] = -k2 * v.y * v.z;
+    b[6] = k3 * (3.0f * vz2 - 1.0f);
+    b[7] = -k2 * v.x * v.z;
+    b[8] = k4 * (vx2 - vy2);
+    b[9] = -k5 * v.y * (3.0f * vx2 - vy2);
+    b[10] = k6 * v.y * v.x * v.z;
+    b[11] = -k7 * v.y * (5.0f * vz2 - 1.0f);
+    b[12] = k8 * v.z * (5.0f * vz2 - 3.0f);
+    b[13] = -k7 * v.x * (5.0f * vz2 - 1.0f);
+    b[14] = k9 * v.z * (vx2 - vy2);
+    b[15] = -k5 * v.x * (vx2 - 3.0f * vy2);
+}
+
+// per pixel blend state of one tile
+struct TileState
+{
+    alignas(32) float transmittance[TILE_PIXELS];
+    alignas(32) float r[TILE_PIXELS];
+    alignas(32) float g[TILE_PIXELS];
+    alignas(32) float b[TILE_PIXELS];
+    alignas(32) float depth[TILE_PIXELS];
+};
+
+//
+// scalar fallback
+//
+
+static void RasterTileScalar(const ProjectedSplat* splats, const uint32_t* tileSplats, size_t numTileSplats,
+                             float tileX, float tileY, float minTransmittance, TileState& state)
+{
+    uint32_t numOpaque = 0;
+    for (size_t i = 0; i < numTileSplats && numOpaque < TILE_PIXELS; i++)
+    {
+        const ProjectedSplat& s = splats[tileSplats[i]];
+        for (uint32_t y = 0; y < TILE_SIZE; y++)
+        {
+            // gl_FragCoord is at the pixel center
+            const float dy = tileY + (float)y + 0.5f - s.py;
+            for (uint32_t x = 0; x < TILE_SIZE; x++)
+            {
+                const uint32_t p = y * TILE_SIZE + x;
+                const float t = state.transmittance[p];
+                if (t < minTransmittance)
+                {
+                    continue;
+                }
+
+                const float dx = tileX + (float)x + 0.5f - s.px;
+                const float power = -0.5f * (dx * (s.conicA * dx + s.conicB * dy) + dy * (s.conicB * dx + s.conicC * dy));
+                const float a = s.alpha * expf(power);
+                if (a <= MIN_ALPHA)
+                {
+                    continue;
+                }
+
+                // front to back version of the GL_ONE, GL_ONE_MINUS_SRC_ALPHA blending of the gl path
+                const float w = t * a;
+                state.r[p] += w * s.r;
+                state.g[p] += w * s.g;
+                state.b[p] += w * s.b;
+                state.depth[p] += w * s.depth;
+                state.transmittance[p] = t * (1.0f - a);
+                if (state.transmittance[p] < minTransmittance)
+                {
+                    numOpaque++;
+                }
+            }
+        }
+    }
+}
+
+#ifdef CPURASTER_X86
+
+// Cephes style expf, clamped to the range of normal floats, see splatmath.cpp
+static const float EXP_HI = 88.3762626647949f;
+static const float EXP_LO = -87.3365478515625f;
+static const float LOG2EF = 1.44269504088896341f;
+static const float EXP_C1 = 0.693359375f;
+static const float EXP_C2 = -2.12194440e-4f;
+static const float EXP_P0 = 1.9875691500e-4f;
+static const float EXP_P1 = 1.3981999507e-3f;
+static const float EXP_P2 = 8.3334519073e-3f;
+static const float EXP_P3 = 4.1665795894e-2f;
+static const float EXP_P4 = 1.6666665459e-1f;
+static const float EXP_P5 = 5.0000001201e-1f;
+
+//
+// AVX2, 8 pixels of a tile row per iteration
+//
+
+__attribute__((target("avx2,fma")))
+static inline __m256 Exp8(__m256 x)
+{
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(EXP_LO)), _mm256_set1_ps(EXP_HI));
+    __m256 n = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(LOG2EF)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    x = _mm256_fnmadd_ps(n, _mm256_set1_ps(EXP_C1), x);
+    x = _mm256_fnmadd_ps(n, _mm256_set1_ps(EXP_C2), x);
+    __m256 y = _mm256_set1_ps(EXP_P0);
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P1));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P2));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P3));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P4));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P5));
+    y = _mm256_fmadd_ps(y, _mm256_mul_ps(x, x), _mm256_add_ps(x, _mm256_set1_ps(1.0f)));
+    __m256i pow2n = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+    return _mm256_mul_ps(y, _mm256_castsi256_ps(pow2n));
+}
+
+__attribute__((target("avx2,fma")))
+static void RasterTileAVX2(const ProjectedSplat* splats, const uint32_t* tileSplats, size_t numTileSplats,
+                           float tileX, float tileY, float minTransmittance, TileState& state)
+{
+    const __m256 laneX = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+    const __m256 minT = _mm256_set1_ps(minTransmittance);
+    const __m256 minAlpha = _mm256_set1_ps(MIN_ALPHA);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 negHalf = _mm256_set1_ps(-0.5f);
+
+    for (size_t i = 0; i < numTileSplats; i++)
+    {
+        const ProjectedSplat& s = splats[tileSplats[i]];
+        const __m256 conicA = _mm256_set1_ps(s.conicA);
+        const __m256 conicB = _mm256_set1_ps(s.conicB);
+        const __m256 conicC = _mm256_set1_ps(s.conicC);
+        const __m256 alpha = _mm256_set1_ps(s.alpha);
+        const __m256 r = _mm256_set1_ps(s.r);
+        const __m256 g = _mm256_set1_ps(s.g);
+        const __m256 b = _mm256_set1_ps(s.b);
+        const __m256 depth = _mm256_set1_ps(s.depth);
+
+        __m256 anyOpen = _mm256_setzero_ps();
+        for (uint32_t y = 0; y < TILE_SIZE; y++)
+        {
+            const __m256 dy = _mm256_set1_ps(tileY + (float)y + 0.5f - s.py);
+            const __m256 bdy = _mm256_mul_ps(conicB, dy);
+            const __m256 cdy = _mm256_mul_ps(conicC, dy);
+            for (uint32_t x = 0; x < TILE_SIZE; x += 8)
+            {
+                const uint32_t p = y * TILE_SIZE + x;
+                const __m256 t = _mm256_load_ps(state.transmittance + p);
+                const __m256 dx = _mm256_add_ps(laneX, _mm256_set1_ps(tileX + (float)x - s.px));
+                const __m256 q = _mm256_add_ps(_mm256_mul_ps(dx, _mm256_fmadd_ps(conicA, dx, bdy)),
+                                               _mm256_mul_ps(dy, _mm256_fmadd_ps(conicB, dx, cdy)));
+                const __m256 a = _mm256_mul_ps(alpha, Exp8(_mm256_mul_ps(negHalf, q)));
+
+                // pixels that are still open and that the splat is not discarded for
+                const __m256 open = _mm256_cmp_ps(t, minT, _CMP_GE_OQ);
+                const __m256 blend = _mm256_and_ps(open, _mm256_cmp_ps(a, minAlpha, _CMP_GT_OQ));
+                const __m256 w = _mm256_and_ps(blend, _mm256_mul_ps(t, a));
+                _mm256_store_ps(state.r + p, _mm256_fmadd_ps(w, r, _mm256_load_ps(state.r + p)));
+                _mm256_store_ps(state.g + p, _mm256_fmadd_ps(w, g, _mm256_load_ps(state.g + p)));
+                _mm256_store_ps(state.b + p, _mm256_fmadd_ps(w, b, _mm256_load_ps(state.b + p)));
+                _mm256_store_ps(state.depth + p, _mm256_fmadd_ps(w, depth, _mm256_load_ps(state.depth + p)));
+                const __m256 newT = _mm256_blendv_ps(t, _mm256_mul_ps(t, _mm256_sub_ps(one, a)), blend);
+                _mm256_store_ps(state.transmittance + p, newT);
+                anyOpen = _mm256_or_ps(anyOpen, _mm256_cmp_ps(newT, minT, _CMP_GE_OQ));
+            }
+        }
+
+        if (_mm256_movemask_ps(anyOpen) == 0)
+        {
+            break;
+        }
+    }
+}
+
+#endif  // CPURASTER_X86
+
+enum class CpuRasterISA
+{
+    Scalar,
+    AVX2
+};
+
+static CpuRasterISA DetectISA()
+{
+#ifdef CPURASTER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+        return CpuRasterISA::AVX2;
+    }
+#endif
+    return CpuRasterISA::Scalar;
+}
+
+static CpuRasterISA GetCpuRasterISA()
+{
+    static const CpuRasterISA isa = DetectISA();
+    return isa;
+}
+
+const char* CpuSplatRasterizer::GetISA()
+{
+    return GetCpuRasterISA() == CpuRasterISA::AVX2 ? "avx2" : "scalar";
+}
+
+static double SecondsSince(const std::chrono::high_resolution_clock::time_point& start)
+{
+    return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void CpuSplatRasterizer::Render(const GaussianCloud& cloud, size_t numPoints, const glm::mat4& cameraMat, const glm::mat4& projMat,
+                                const glm::mat4& modelMat, const glm::vec2& nearFar, uint32_t widthIn, uint32_t heightIn,
+                                const Options& options)
+{
+    ZoneScopedNC("CpuSplatRasterizer::Render()", tracy::Color::Blue);
+
+    width = widthIn;
+    height = heightIn;
+    numTilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    numTilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+    color.assign((size_t)width * height, glm::vec4(0.0f));
+    depth.assign((size_t)width * height, 0.0f);
+    timings = Timings();
+    stats = Stats();
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // the planar layout holds the positions as a tightly packed vec4 stream, the interleaved one needs a copy
+    const glm::vec4* positions;
+    if (cloud.IsPlanar())
+    {
+        positions = (const glm::vec4*)((const uint8_t*)cloud.GetRawDataPtr() + cloud.GetPosWithAlphaAttrib().offset);
+    }
+    else
+    {
+        posVec.resize(numPoints);
+        ThreadPool::Get().ParallelFor(numPoints, POS_GRAIN_SIZE, [this, &cloud](size_t begin, size_t end)
+        {
+            glm::vec4* dst = posVec.data() + begin;
+            cloud.ForEachPosWithAlphaInRange(begin, end, [&dst](const float* pos)
+            {
+                *dst++ = glm::vec4(pos[0], pos[1], pos[2], 1.0f);
+            });
+        });
+        positions = posVec.data();
+    }
+
+    const glm::mat4 modelViewProj = projMat * glm::inverse(cameraMat) * modelMat;
+    CpuSplatSorter::Options sortOptions;
+    sortOptions.forceScalar = options.forceScalar;
+    const size_t count = sorter.Sort(positions, numPoints, modelViewProj, nearFar, sortOptions);
+
+    timings.sortSeconds = SecondsSince(start);
+    start = std::chrono::high_resolution_clock::now();
+
+    Project(cloud, count, cameraMat, projMat, modelMat, nearFar, options);
+    BinTiles(count);
+
+    timings.projectSeconds = SecondsSince(start);
+    start = std::chrono::high_resolution_clock::now();
+
+    const bool useAVX2 = GetCpuRasterISA() == CpuRasterISA::AVX2 && !options.forceScalar;
+    const uint32_t numTiles = numTilesX * numTilesY;
+
+    // one tile per chunk, so threads that finish early keep taking tiles off the busy ones
+    ThreadPool::Get().ParallelFor(numTiles, 1, [&](size_t begin, size_t end)
+    {
+        ZoneScopedNC("raster-tiles", tracy::Color::Green);
+
+        TileState state;
+        for (size_t tile = begin; tile < end; tile++)
+        {
+            const uint32_t tileX = (uint32_t)(tile % numTilesX) * TILE_SIZE;
+            const uint32_t tileY = (uint32_t)(tile / numTilesX) * TILE_SIZE;
+            std::fill(std::begin(state.transmittance), std::end(state.transmittance), 1.0f);
+            std::fill(std::begin(state.r), std::end(state.r), 0.0f);
+            std::fill(std::begin(state.g), std::end(state.g), 0.0f);
+            std::fill(std::begin(state.b), std::end(state.b), 0.0f);
+            std::fill(std::begin(state.depth), std::end(state.depth), 0.0f);
+
+            const uint32_t* list = tileSplats.data() + tileOffsets[tile];
+            const size_t listSize = tileOffsets[tile + 1] - tileOffsets[tile];
+#ifdef CPURASTER_X86
+            if (useAVX2)
+            {
+                RasterTileAVX2(projected.data(), list, listSize, (float)tileX, (float)tileY, options.minTransmittance, state);
+            }
+            else
+#endif
+            {
+                RasterTileScalar(projected.data(), list, listSize, (float)tileX, (float)tileY, options.minTransmittance, state);
+            }
+
+            // the pixels of the last tile row and column can be past the edge of the image
+            const uint32_t tileWidth = std::min(TILE_SIZE, width - tileX);
+            const uint32_t tileHeight = std::min(TILE_SIZE, height - tileY);
+            for (uint32_t y = 0; y < tileHeight; y++)
+            {
+                for (uint32_t x = 0; x < tileWidth; x++)
+                {
+                    const uint32_t p = y * TILE_SIZE + x;
+                    const size_t dst = (size_t)(tileY + y) * width + tileX + x;
+                    const float alpha = 1.0f - state.transmittance[p];
+                    color[dst] = glm::vec4(state.r[p], state.g[p], state.b[p], alpha);
+                    depth[dst] = alpha > 0.0f ? state.depth[p] / alpha : 0.0f;
+                }
+            }
+        }
+    });
+
+    timings.rasterSeconds = SecondsSince(start);
+}
+
+// splat_vert.glsl and splat_geom.glsl for the sorted visible splats, front to back
+void CpuSplatRasterizer::Project(const GaussianCloud& cloud, size_t count, const glm::mat4& cameraMat, const glm::mat4& projMat,
+                                 const glm::mat4& modelMat, const glm::vec2& nearFar, const Options& options)
+{
+    ZoneScopedNC("project", tracy::Color::Yellow);
+
+    const glm::mat4 viewMat = glm::inverse(cameraMat);
+    const glm::mat4 modelViewMat = viewMat * modelMat;
+    const glm::mat3 W = glm::mat3(modelViewMat);
+    const glm::vec3 eye = glm::vec3(cameraMat[3]);
+    const float WIDTH = (float)width;
+    const float HEIGHT = (float)height;
+    const float Z_NEAR = nearFar.x;
+    const float Z_FAR = nearFar.y;
+    const float SX = projMat[0][0];
+    const float SY = projMat[1][1];
+    const float WZ = projMat[3][2];
+
+    const uint8_t* data = (const uint8_t*)cloud.GetRawDataPtr();
+    const bool fullSH = cloud.HasFullSH();
+    const int numCoeffs = fullSH ? 16 : 4;
+    const BinaryAttribute* sh0Attribs[3] = { &cloud.GetR_SH0Attrib(), &cloud.GetG_SH0Attrib(), &cloud.GetB_SH0Attrib() };
+    const BinaryAttribute* sh1Attribs[3] = { &cloud.GetR_SH1Attrib(), &cloud.GetG_SH1Attrib(), &cloud.GetB_SH1Attrib() };
+    const std::vector<uint32_t>& sortedIndices = sorter.GetSortedIndices();
+
+    projected.resize(count);
+    ThreadPool::Get().ParallelFor(count, PROJECT_GRAIN_SIZE, [&](size_t begin, size_t end)
+    {
+        for (size_t s = begin; s < end; s++)
+        {
+            // the sorter orders back to front
+            const size_t i = sortedIndices[count - 1 - s];
+            ProjectedSplat& out = projected[s];
+            out.tileMin[0] = out.tileMin[1] = out.tileMax[0] = out.tileMax[1] = 0;
+
+            const float* pos = cloud.GetPosWithAlphaAttrib().Get<float>(data + i * cloud.GetPosWithAlphaStride());
+            const glm::vec4 worldPos = modelMat * glm::vec4(pos[0], pos[1], pos[2], 1.0f);
+            const glm::vec4 t = viewMat * worldPos;
+
+            // discard splats that end up outside of the guard band of splat_geom.glsl
+            const glm::vec4 p4 = projMat * t;
+            const glm::vec3 ndcP = glm::vec3(p4) / p4.w;
+            if (ndcP.z < 0.25f || ndcP.x > 2.0f || ndcP.x < -2.0f || ndcP.y > 2.0f || ndcP.y < -2.0f)
+            {
+                continue;
+            }
+
+            // J is the jacobian of the projection and viewport transformations, see splat_vert.glsl
+            const float tzSq = t.z * t.z;
+            const float jsx = -(SX * WIDTH) / (2.0f * t.z);
+            const float jsy = -(SY * HEIGHT) / (2.0f * t.z);
+            const float jtx = (SX * t.x * WIDTH) / (2.0f * tzSq);
+            const float jty = (SY * t.y * HEIGHT) / (2.0f * tzSq);
+            const float jtz = ((Z_FAR - Z_NEAR) * WZ) / (2.0f * tzSq);
+            const glm::mat3 J = glm::mat3(glm::vec3(jsx, 0.0f, 0.0f), glm::vec3(0.0f, jsy, 0.0f), glm::vec3(jtx, jty, jtz));
+
+            const uint8_t* covPtr = data + i * cloud.GetCov3Stride();
+            const float* col0 = cloud.GetCov3_Col0Attrib().Get<float>(covPtr);
+            const float* col1 = cloud.GetCov3_Col1Attrib().Get<float>(covPtr);
+            const float* col2 = cloud.GetCov3_Col2Attrib().Get<float>(covPtr);
+            const glm::mat3 V = glm::mat3(glm::vec3(col0[0], col0[1], col0[2]), glm::vec3(col1[0], col1[1], col1[2]),
+                                          glm::vec3(col2[0], col2[1], col2[2]));
+            const glm::mat3 JW = J * W;
+            const glm::mat3 V_prime = JW * V * glm::transpose(JW);
+
+            // low-pass filter against aliasing
+            const float a = V_prime[0][0] + 0.3f;
+            const float b = V_prime[0][1];
+            const float c = V_prime[1][1] + 0.3f;
+            const float det = a * c - b * b;
+            if (!(det > 0.0f))
+            {
+                continue;
+            }
+
+            // the quad only reaches out to where the splat falls below MIN_ALPHA, see Options::opacityBounds
+            float extentSigmas = EXTENT_SIGMAS;
+            if (options.opacityBounds)
+            {
+                if (!(pos[3] > MIN_ALPHA))
+                {
+                    continue;
+                }
+                extentSigmas = std::min(sqrtf(2.0f * logf(pos[3] / MIN_ALPHA)), EXTENT_SIGMAS);
+            }
+
+            // 2d extents of the covariance ellipse, the quad of splat_geom.glsl
+            const float apco2 = (a + c) / 2.0f;
+            const float amco2 = (a - c) / 2.0f;
+            const float term = sqrtf(amco2 * amco2 + b * b);
+            const float majorEig = apco2 + term;
+            const float minorEig = std::max(apco2 - term, 0.0f);
+            const float theta = (b == 0.0f) ? ((a >= c) ? 0.0f : glm::radians(90.0f)) : atan2f(majorEig - a, b);
+            const float r1 = extentSigmas * sqrtf(majorEig);
+            const float r2 = extentSigmas * sqrtf(minorEig);
+            const float extentX = fabsf(r1 * cosf(theta)) + fabsf(r2 * sinf(theta));
+            const float extentY = fabsf(r1 * sinf(theta)) + fabsf(r2 * cosf(theta));
+
+            out.px = 0.5f * (WIDTH + ndcP.x * WIDTH);
+            out.py = 0.5f * (HEIGHT + ndcP.y * HEIGHT);
+            const float tileMinX = floorf((out.px - extentX) / TILE_SIZE);
+            const float tileMinY = floorf((out.py - extentY) / TILE_SIZE);
+            const float tileMaxX = floorf((out.px + extentX) / TILE_SIZE) + 1.0f;
+            const float tileMaxY = floorf((out.py + extentY) / TILE_SIZE) + 1.0f;
+            out.tileMin[0] = (uint32_t)std::clamp(tileMinX, 0.0f, (float)numTilesX);
+            out.tileMin[1] = (uint32_t)std::clamp(tileMinY, 0.0f, (float)numTilesY);
+            out.tileMax[0] = (uint32_t)std::clamp(tileMaxX, 0.0f, (float)numTilesX);
+            out.tileMax[1] = (uint32_t)std::clamp(tileMaxY, 0.0f, (float)numTilesY);
+
+            out.conicA = c / det;
+            out.conicB = -b / det;
+            out.conicC = a / det;
+            out.alpha = pos[3];
+            out.depth = -t.z;
+
+            // radiance from sh, using the world space view direction
+            float basis[16];
+            ComputeSHBasis(glm::normalize(glm::vec3(worldPos) - eye), basis);
+            const uint8_t* sh0Ptr = data + i * cloud.GetSH0Stride();
+            const uint8_t* sh1Ptr = data + i * cloud.GetSHRestStride();
+            float rgb[3];
+            for (int k = 0; k < 3; k++)
+            {
+                float radiance = 0.0f;
+                for (int j = 0; j < numCoeffs; j++)
+                {
+                    radiance += basis[j] * (j < 4 ? sh0Attribs[k]->Get<float>(sh0Ptr)[j] : sh1Attribs[k]->Get<float>(sh1Ptr)[j - 4]);
+                }
+                rgb[k] = 0.5f + radiance;
+                if (options.framebufferSRGB)
+                {
+                    rgb[k] = SRGBToLinear(rgb[k]);
+                }
+            }
+            out.r = rgb[0];
+            out.g = rgb[1];
+            out.b = rgb[2];
+        }
+    });
+}
+
+// Stable binning of the projected splats into tile lists, so the lists stay front to back.
+// Same scheme as CpuSplatSorter::RadixSort() with tiles as digits: per block counts, a (tile, block) exclusive scan, a scatter.
+void CpuSplatRasterizer::BinTiles(size_t count)
+{
+    ZoneScopedNC("bin-tiles", tracy::Color::Yellow);
+
+    const size_t numTiles = (size_t)numTilesX * numTilesY;
+    const size_t maxBlocks = (size_t)ThreadPool::Get().GetNumThreads() * 4;
+    const size_t numBlocks = std::clamp(count / BIN_MIN_BLOCK_SIZE, (size_t)1, maxBlocks);
+    const size_t blockSize = std::max((count + numBlocks - 1) / numBlocks, (size_t)1);
+
+    chunkTileCounts.assign(numBlocks * numTiles, 0);
+    // ranges can span several blocks when ParallelFor() runs serially
+    ThreadPool::Get().ParallelFor(count, blockSize, [&](size_t rangeBegin, size_t rangeEnd)
+    {
+        for (size_t begin = rangeBegin; begin < rangeEnd; begin += blockSize)
+        {
+            const size_t end = std::min(begin + blockSize, rangeEnd);
+            uint32_t* counts = chunkTileCounts.data() + (begin / blockSize) * numTiles;
+            for (size_t s = begin; s < end; s++)
+            {
+                const ProjectedSplat& splat = projected[s];
+                for (uint32_t y = splat.tileMin[1]; y < splat.tileMax[1]; y++)
+                {
+                    for (uint32_t x = splat.tileMin[0]; x < splat.tileMax[0]; x++)
+                    {
+                        counts[y * numTilesX + x]++;
+                    }
+                }
+            }
+        }
+    });
+
+    tileOffsets.resize(numTiles + 1);
+    uint32_t offset = 0;
+    for (size_t tile = 0; tile < numTiles; tile++)
+    {
+        tileOffsets[tile] = offset;
+        for (size_t block = 0; block < numBlocks; block++)
+        {
+            uint32_t blockCount = chunkTileCounts[block * numTiles + tile];
+            chunkTileCounts[block * numTiles + tile] = offset;
+            offset += blockCount;
+        }
+    }
+    tileOffsets[numTiles] = offset;
+
+    tileSplats.resize(offset);
+    ThreadPool::Get().ParallelFor(count, blockSize, [&](size_t rangeBegin, size_t rangeEnd)
+    {
+        for (size_t begin = rangeBegin; begin < rangeEnd; begin += blockSize)
+        {
+            const size_t end = std::min(begin + blockSize, rangeEnd);
+            uint32_t* offsets = chunkTileCounts.data() + (begin / blockSize) * numTiles;
+            for (size_t s = begin; s < end; s++)
+            {
+                const ProjectedSplat& splat = projected[s];
+                for (uint32_t y = splat.tileMin[1]; y < splat.tileMax[1]; y++)
+                {
+                    for (uint32_t x = splat.tileMin[0]; x < splat.tileMax[0]; x++)
+                    {
+                        tileSplats[offsets[y * numTilesX + x]++] = (uint32_t)s;
+                    }
+                }
+            }
+        }
+    });
+
+    stats.numVisible = 0;
+    for (size_t s = 0; s < count; s++)
+    {
+        stats.numVisible += projected[s].tileMax[0] > projected[s].tileMin[0] && projected[s].tileMax[1] > projected[s].tileMin[1];
+    }
+    stats.numTileSplats = offset;
+}
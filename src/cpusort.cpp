@@ -0,0 +1,421 @@
+#include <cpusort.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#ifdef TRACY_ENABLE
+#include <tracy/Tracy.hpp>
+#else
+#define ZoneScoped
+#define ZoneScopedNC(NAME, COLOR)
+#endif
+
+#include <threadpool.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CPUSORT_X86
+#include <immintrin.h>
+#endif
+
+// splats culled per ThreadPool chunk
+static const size_t CULL_CHUNK_SIZE = 16384;
+
+// smallest number of keys a radix sort block is worth spreading over a thread
+static const size_t SORT_MIN_BLOCK_SIZE = 16384;
+static const uint32_t RADIX_SORT_BINS = 256;
+
+// same as presort_compute.glsl
+static const float CLIP = 1.5f;
+
+// keyMax = 0xffffffff as a float in presort_compute.glsl, rounds up to 2^32
+static const float FULL_KEY_MAX = 4294967296.0f;
+
+// largest float below 2^32, clamps the depth / far keys of splats past the far plane
+static const float MAX_UINT_FLOAT = 4294967040.0f;
+
+struct CullParams
+{
+    float rowX[4];  // rows of modelViewProj that give clip x, y and w
+    float rowY[4];
+    float rowW[4];
+    float far;
+    bool rawDepth;  // write the depth bits for range quantization instead of depth / far keys
+};
+
+static inline uint32_t FloatBits(float f)
+{
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+static inline float BitsToFloat(uint32_t bits)
+{
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+// keyMax - uint((depth / nearFar.y) * keyMax) of presort_compute.glsl
+static inline uint32_t FullDepthKey(float depth, float far)
+{
+    float f = std::min((depth / far) * FULL_KEY_MAX, MAX_UINT_FLOAT);
+    return ~(uint32_t)f;
+}
+
+//
+// scalar fallback
+//
+
+static size_t CullScalar(const glm::vec4* positions, size_t begin, size_t end, const CullParams& params,
+                         uint32_t* keysOut, uint32_t* indicesOut, uint32_t* minDepthBits, uint32_t* maxDepthBits)
+{
+    size_t count = 0;
+    for (size_t i = begin; i < end; i++)
+    {
+        const glm::vec4& p = positions[i];
+        float px = params.rowX[0] * p.x + params.rowX[1] * p.y + params.rowX[2] * p.z + params.rowX[3];
+        float py = params.rowY[0] * p.x + params.rowY[1] * p.y + params.rowY[2] * p.z + params.rowY[3];
+        float depth = params.rowW[0] * p.x + params.rowW[1] * p.y + params.rowW[2] * p.z + params.rowW[3];
+        float xx = px / depth;
+        float yy = py / depth;
+
+        if (depth > 0.0f && xx < CLIP && xx > -CLIP && yy < CLIP && yy > -CLIP)
+        {
+            if (params.rawDepth)
+            {
+                // positive floats order like their bit patterns
+                uint32_t bits = FloatBits(depth);
+                *minDepthBits = std::min(*minDepthBits, bits);
+                *maxDepthBits = std::max(*maxDepthBits, bits);
+                keysOut[count] = bits;
+            }
+            else
+            {
+                keysOut[count] = FullDepthKey(depth, params.far);
+            }
+            indicesOut[count] = (uint32_t)i;
+            count++;
+        }
+    }
+    return count;
+}
+
+#ifdef CPUSORT_X86
+
+//
+// AVX2, 8 splats per iteration
+//
+
+__attribute__((target("avx2,fma")))
+static inline __m256 Row8(const float* row, __m256 x, __m256 y, __m256 z)
+{
+    // same order of operations as CullScalar, so both kernels agree
+    __m256 r = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(row[0]), x), _mm256_mul_ps(_mm256_set1_ps(row[1]), y));
+    r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_set1_ps(row[2]), z));
+    return _mm256_add_ps(r, _mm256_set1_ps(row[3]));
+}
+
+__attribute__((target("avx2,fma")))
+static size_t CullAVX2(const glm::vec4* positions, size_t begin, size_t end, const CullParams& params,
+                       uint32_t* keysOut, uint32_t* indicesOut, uint32_t* minDepthBits, uint32_t* maxDepthBits)
+{
+    const int floatsPerPosition = (int)(sizeof(glm::vec4) / sizeof(float));
+    const __m256i gatherIndex = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(floatsPerPosition));
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 clip = _mm256_set1_ps(CLIP);
+    const __m256 negClip = _mm256_set1_ps(-CLIP);
+    const __m256 far = _mm256_set1_ps(params.far);
+    const __m256 keyMax = _mm256_set1_ps(FULL_KEY_MAX);
+    const __m256 maxUint = _mm256_set1_ps(MAX_UINT_FLOAT);
+    const __m256 signBitFloat = _mm256_set1_ps(2147483648.0f);
+    const __m256i signBit = _mm256_set1_epi32((int)0x80000000);
+
+    alignas(32) uint32_t keys[8];
+    size_t count = 0;
+    size_t i = begin;
+    for (; i + 8 <= end; i += 8)
+    {
+        const float* base = &positions[i].x;
+        __m256 x = _mm256_i32gather_ps(base, gatherIndex, 4);
+        __m256 y = _mm256_i32gather_ps(base + 1, gatherIndex, 4);
+        __m256 z = _mm256_i32gather_ps(base + 2, gatherIndex, 4);
+
+        __m256 px = Row8(params.rowX, x, y, z);
+        __m256 py = Row8(params.rowY, x, y, z);
+        __m256 depth = Row8(params.rowW, x, y, z);
+        __m256 xx = _mm256_div_ps(px, depth);
+        __m256 yy = _mm256_div_ps(py, depth);
+
+        __m256 visible = _mm256_cmp_ps(depth, zero, _CMP_GT_OQ);
+        visible = _mm256_and_ps(visible, _mm256_cmp_ps(xx, clip, _CMP_LT_OQ));
+        visible = _mm256_and_ps(visible, _mm256_cmp_ps(xx, negClip, _CMP_GT_OQ));
+        visible = _mm256_and_ps(visible, _mm256_cmp_ps(yy, clip, _CMP_LT_OQ));
+        visible = _mm256_and_ps(visible, _mm256_cmp_ps(yy, negClip, _CMP_GT_OQ));
+        int mask = _mm256_movemask_ps(visible);
+        if (mask == 0)
+        {
+            continue;
+        }
+
+        if (params.rawDepth)
+        {
+            _mm256_store_si256((__m256i*)keys, _mm256_castps_si256(depth));
+        }
+        else
+        {
+            // float to uint32, values from 2^31 up are converted with the sign bit cleared and set again after
+            __m256 f = _mm256_min_ps(_mm256_mul_ps(_mm256_div_ps(depth, far), keyMax), maxUint);
+            __m256 high = _mm256_cmp_ps(f, signBitFloat, _CMP_GE_OQ);
+            __m256i u = _mm256_cvttps_epi32(_mm256_sub_ps(f, _mm256_and_ps(high, signBitFloat)));
+            u = _mm256_xor_si256(u, _mm256_and_si256(_mm256_castps_si256(high), signBit));
+            _mm256_store_si256((__m256i*)keys, _mm256_xor_si256(u, _mm256_set1_epi32(-1)));
+        }
+
+        while (mask)
+        {
+            int lane = __builtin_ctz(mask);
+            mask &= mask - 1;
+            if (params.rawDepth)
+            {
+                *minDepthBits = std::min(*minDepthBits, keys[lane]);
+                *maxDepthBits = std::max(*maxDepthBits, keys[lane]);
+            }
+            keysOut[count] = keys[lane];
+            indicesOut[count] = (uint32_t)(i + lane);
+            count++;
+        }
+    }
+
+    return count + CullScalar(positions, i, end, params, keysOut + count, indicesOut + count, minDepthBits, maxDepthBits);
+}
+
+#endif  // CPUSORT_X86
+
+enum class CpuSortISA
+{
+    Scalar,
+    AVX2
+};
+
+static CpuSortISA DetectISA()
+{
+#ifdef CPUSORT_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+        return CpuSortISA::AVX2;
+    }
+#endif
+    return CpuSortISA::Scalar;
+}
+
+static CpuSortISA GetCpuSortISA()
+{
+    static const CpuSortISA isa = DetectISA();
+    return isa;
+}
+
+const char* CpuSplatSorter::GetISA()
+{
+    return GetCpuSortISA() == CpuSortISA::AVX2 ? "avx2" : "scalar";
+}
+
+static double SecondsSince(const std::chrono::high_resolution_clock::time_point& start)
+{
+    return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+size_t CpuSplatSorter::Sort(const glm::vec4* positions, size_t numPoints, const glm::mat4& modelViewProj,
+                            const glm::vec2& nearFar, const Options& options)
+{
+    ZoneScopedNC("CpuSplatSorter::Sort()", tracy::Color::Red4);
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    CullParams params;
+    for (int col = 0; col < 4; col++)
+    {
+        params.rowX[col] = modelViewProj[col][0];
+        params.rowY[col] = modelViewProj[col][1];
+        params.rowW[col] = modelViewProj[col][3];
+    }
+    params.far = nearFar.y;
+    params.rawDepth = options.depthKeyBits < 32;
+
+    const bool useAVX2 = GetCpuSortISA() == CpuSortISA::AVX2 && !options.forceScalar;
+
+    // each chunk compacts its visible splats to the front of its own range
+    const size_t numChunks = (numPoints + CULL_CHUNK_SIZE - 1) / CULL_CHUNK_SIZE;
+    chunkResults.resize(numChunks);
+    chunkKeys.resize(std::max(chunkKeys.size(), numPoints));
+    chunkIndices.resize(std::max(chunkIndices.size(), numPoints));
+    // ParallelFor() may hand out several chunks at once when it runs serially, so every range is split again
+    ThreadPool::Get().ParallelFor(numPoints, CULL_CHUNK_SIZE, [&](size_t rangeBegin, size_t rangeEnd)
+    {
+        for (size_t begin = rangeBegin; begin < rangeEnd; begin += CULL_CHUNK_SIZE)
+        {
+            const size_t end = std::min(begin + CULL_CHUNK_SIZE, rangeEnd);
+            ChunkResult& result = chunkResults[begin / CULL_CHUNK_SIZE];
+            result.minDepthBits = std::numeric_limits<uint32_t>::max();
+            result.maxDepthBits = 0;
+#ifdef CPUSORT_X86
+            if (useAVX2)
+            {
+                result.count = CullAVX2(positions, begin, end, params, chunkKeys.data() + begin, chunkIndices.data() + begin,
+                                        &result.minDepthBits, &result.maxDepthBits);
+                continue;
+            }
+#endif
+            result.count = CullScalar(positions, begin, end, params, chunkKeys.data() + begin, chunkIndices.data() + begin,
+                                      &result.minDepthBits, &result.maxDepthBits);
+        }
+    });
+
+    size_t count = 0;
+    uint32_t minDepthBits = std::numeric_limits<uint32_t>::max();
+    uint32_t maxDepthBits = 0;
+    std::vector<size_t> chunkOffsets(numChunks);
+    for (size_t i = 0; i < numChunks; i++)
+    {
+        chunkOffsets[i] = count;
+        count += chunkResults[i].count;
+        minDepthBits = std::min(minDepthBits, chunkResults[i].minDepthBits);
+        maxDepthBits = std::max(maxDepthBits, chunkResults[i].maxDepthBits);
+    }
+
+    for (int i = 0; i < 2; i++)
+    {
+        keys[i].resize(std::max(keys[i].size(), count));
+        indices[i].resize(std::max(indices[i].size(), count));
+    }
+
+    // same mapping as presort_quantize_compute.glsl
+    const uint32_t keyMax = params.rawDepth ? (1u << options.depthKeyBits) - 1 : 0;
+    const float minDepth = BitsToFloat(minDepthBits);
+    const float maxDepth = BitsToFloat(maxDepthBits);
+    const float depthRange = options.logDepthKeys ? std::max(logf(maxDepth / minDepth), 1e-20f) : std::max(maxDepth - minDepth, 1e-20f);
+    ThreadPool::Get().ParallelFor(numPoints, CULL_CHUNK_SIZE, [&](size_t rangeBegin, size_t rangeEnd)
+    {
+        for (size_t begin = rangeBegin; begin < rangeEnd; begin += CULL_CHUNK_SIZE)
+        {
+            const size_t chunk = begin / CULL_CHUNK_SIZE;
+            const size_t chunkCount = chunkResults[chunk].count;
+            uint32_t* dstKeys = keys[0].data() + chunkOffsets[chunk];
+            memcpy(indices[0].data() + chunkOffsets[chunk], chunkIndices.data() + begin, chunkCount * sizeof(uint32_t));
+            if (!params.rawDepth)
+            {
+                memcpy(dstKeys, chunkKeys.data() + begin, chunkCount * sizeof(uint32_t));
+                continue;
+            }
+
+            for (size_t i = 0; i < chunkCount; i++)
+            {
+                float depth = BitsToFloat(chunkKeys[begin + i]);
+                float t = options.logDepthKeys ? logf(depth / minDepth) / depthRange : (depth - minDepth) / depthRange;
+                dstKeys[i] = keyMax - (uint32_t)(std::clamp(t, 0.0f, 1.0f) * (float)keyMax);
+            }
+        }
+    });
+
+    timings.cullSeconds = SecondsSince(start);
+    start = std::chrono::high_resolution_clock::now();
+
+    RadixSort(count, options.depthKeyBits / 8);
+
+    timings.sortSeconds = SecondsSince(start);
+
+    return count;
+}
+
+// LSD radix sort of keys[0] and indices[0], 8 bits per pass. The keys are split into blocks, each pass
+// histograms every block in parallel, turns the histograms into per block offsets and scatters the blocks in parallel.
+void CpuSplatSorter::RadixSort(size_t count, uint32_t numBytes)
+{
+    ZoneScopedNC("radix-sort", tracy::Color::Red4);
+
+    sortedKeys = &keys[0];
+    sortedIndices = &indices[0];
+    if (count < 2)
+    {
+        return;
+    }
+
+    const size_t maxBlocks = (size_t)ThreadPool::Get().GetNumThreads() * 4;
+    const size_t numBlocks = std::clamp(count / SORT_MIN_BLOCK_SIZE, (size_t)1, maxBlocks);
+    const size_t blockSize = (count + numBlocks - 1) / numBlocks;
+    blockHistograms.resize(numBlocks * RADIX_SORT_BINS);
+
+    int src = 0;
+    for (uint32_t pass = 0; pass < numBytes; pass++)
+    {
+        const uint32_t shift = 8 * pass;
+        const uint32_t* srcKeys = keys[src].data();
+
+        std::fill(blockHistograms.begin(), blockHistograms.end(), 0);
+        // ranges can span several blocks when ParallelFor() runs serially
+        ThreadPool::Get().ParallelFor(count, blockSize, [&](size_t rangeBegin, size_t rangeEnd)
+        {
+            for (size_t begin = rangeBegin; begin < rangeEnd; begin += blockSize)
+            {
+                const size_t end = std::min(begin + blockSize, rangeEnd);
+                uint32_t* histogram = blockHistograms.data() + (begin / blockSize) * RADIX_SORT_BINS;
+                for (size_t i = begin; i < end; i++)
+                {
+                    histogram[(srcKeys[i] >> shift) & (RADIX_SORT_BINS - 1)]++;
+                }
+            }
+        });
+
+        // exclusive scan in (digit, block) order gives every block its output offset per digit,
+        // a pass where every key has the same digit would not move anything.
+        bool skipPass = false;
+        uint32_t offset = 0;
+        for (uint32_t digit = 0; digit < RADIX_SORT_BINS; digit++)
+        {
+            uint32_t digitStart = offset;
+            for (size_t block = 0; block < numBlocks; block++)
+            {
+                uint32_t blockCount = blockHistograms[block * RADIX_SORT_BINS + digit];
+                blockHistograms[block * RADIX_SORT_BINS + digit] = offset;
+                offset += blockCount;
+            }
+            if (offset - digitStart == count)
+            {
+                skipPass = true;
+                break;
+            }
+        }
+        if (skipPass)
+        {
+            continue;
+        }
+
+        const uint32_t* srcIndices = indices[src].data();
+        uint32_t* dstKeys = keys[1 - src].data();
+        uint32_t* dstIndices = indices[1 - src].data();
+        ThreadPool::Get().ParallelFor(count, blockSize, [&](size_t rangeBegin, size_t rangeEnd)
+        {
+            for (size_t begin = rangeBegin; begin < rangeEnd; begin += blockSize)
+            {
+                const size_t end = std::min(begin + blockSize, rangeEnd);
+                uint32_t offsets[RADIX_SORT_BINS];
+                memcpy(offsets, blockHistograms.data() + (begin / blockSize) * RADIX_SORT_BINS, sizeof(offsets));
+                for (size_t i = begin; i < end; i++)
+                {
+                    uint32_t key = srcKeys[i];
+                    uint32_t dst = offsets[(key >> shift) & (RADIX_SORT_BINS - 1)]++;
+                    dstKeys[dst] = key;
+                    dstIndices[dst] = srcIndices[i];
+                }
+            }
+        });
+        src = 1 - src;
+    }
+
+    sortedKeys = &keys[src];
+    sortedIndices = &indices[src];
+}
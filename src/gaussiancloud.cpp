@@ -7,16 +7,25 @@
 
 #include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <filesystem>
 #include <fstream>
+#include <future>
 #include <iostream>
+#include <limits>
+#include <memory>
 #include <sstream>
 #include <string>
 #include <string.h>
 
 #include <spdlog/spdlog.h>
-#include <glm/gtc/quaternion.hpp>
 
-#include <eigen3/Eigen/Dense>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #ifdef TRACY_ENABLE
 #include <tracy/Tracy.hpp>
@@ -28,6 +37,32 @@
 #include <util.h>
 
 #include <ply.h>
+#include <splatcompress.h>
+#include <splatmath.h>
+#include <threadpool.h>
+
+// number of ply vertices converted per ThreadPool chunk
+static const size_t IMPORT_GRAIN_SIZE = 16384;
+
+// number of ply vertices published at once by ImportPlyProgressive
+static const size_t PROGRESSIVE_CHUNK_SIZE = IMPORT_GRAIN_SIZE * 16;
+
+// number of vertices encoded per ThreadPool chunk by ExportPly, and per ordered write
+static const size_t EXPORT_GRAIN_SIZE = 4096;
+static const size_t EXPORT_GROUP_SIZE = EXPORT_GRAIN_SIZE * 16;
+
+// rot (w x y z) and log scale per gaussian, see Options::keepRotScale
+static const size_t ROT_SCALE_FLOATS = 7;
+
+// bump whenever BaseGaussianData, FullGaussianData or GaussianCacheHeader change
+static const uint32_t GAUSSIAN_CACHE_VERSION = 1;
+static const char GAUSSIAN_CACHE_MAGIC[8] = { 'G', 'S', 'C', 'A', 'C', 'H', 'E', '\0' };
+static const uint32_t GAUSSIAN_CACHE_FLAG_IMPORT_FULL_SH = 0x1;
+static const uint32_t GAUSSIAN_CACHE_FLAG_PLANAR = 0x2;
+
+// bump whenever CompressedHeader or the chunk encoding in splatcompress change
+static const uint32_t COMPRESSED_VERSION = 1;
+static const char COMPRESSED_MAGIC[8] = { 'G', 'S', 'Z', 'S', 'P', 'L', 'A', 'T' };
 
 struct BaseGaussianData
 {
@@ -55,117 +90,501 @@ struct FullGaussianData : public BaseGaussianData
     float b_sh3[4];
 };
 
-// Function to convert glm::mat3 to Eigen::Matrix3f
-static Eigen::Matrix3f glmToEigen(const glm::mat3& glmMat)
+// Byte range of a BaseGaussianData / FullGaussianData record that is stored as one stream by the planar layout.
+// Streams are ordered by their offset in the record, so a record is the concatenation of its streams.
+struct GaussianStream
+{
+    size_t recordOffset;
+    size_t size;
+};
+
+static const int MAX_GAUSSIAN_STREAMS = 4;
+
+// position with alpha, sh0 (r, g and b), cov3 and, with full SH, sh1..sh3. returns the number of streams.
+static int GetGaussianStreams(bool fullSH, GaussianStream streamsOut[MAX_GAUSSIAN_STREAMS])
+{
+    streamsOut[0] = { offsetof(BaseGaussianData, posWithAlpha), sizeof(BaseGaussianData::posWithAlpha) };
+    streamsOut[1] = { offsetof(BaseGaussianData, r_sh0), offsetof(BaseGaussianData, cov3_col0) - offsetof(BaseGaussianData, r_sh0) };
+    streamsOut[2] = { offsetof(BaseGaussianData, cov3_col0), sizeof(BaseGaussianData) - offsetof(BaseGaussianData, cov3_col0) };
+    streamsOut[3] = { offsetof(FullGaussianData, r_sh1), sizeof(FullGaussianData) - offsetof(FullGaussianData, r_sh1) };
+    return fullSH ? 4 : 3;
+}
+
+// copies count interleaved records from src into gaussians [begin, begin + count) of planar data holding numGaussians.
+static void ScatterToPlanar(uint8_t* planarData, size_t numGaussians, bool fullSH, size_t begin, size_t count, const uint8_t* src)
 {
-    Eigen::Matrix3f eigenMat;
-    for (int r = 0; r < 3; ++r)
+    GaussianStream streams[MAX_GAUSSIAN_STREAMS];
+    const int numStreams = GetGaussianStreams(fullSH, streams);
+    const size_t recordSize = fullSH ? sizeof(FullGaussianData) : sizeof(BaseGaussianData);
+    uint8_t* streamPtr = planarData;
+    for (int k = 0; k < numStreams; k++)
     {
-        for (int c = 0; c < 3; ++c)
+        uint8_t* dst = streamPtr + begin * streams[k].size;
+        const uint8_t* recordPtr = src + streams[k].recordOffset;
+        for (size_t i = 0; i < count; i++)
         {
-            eigenMat(r, c) = glmMat[c][r];
+            memcpy(dst, recordPtr, streams[k].size);
+            dst += streams[k].size;
+            recordPtr += recordSize;
         }
+        streamPtr += numGaussians * streams[k].size;
     }
-    return eigenMat;
 }
 
-// Function to convert Eigen::Matrix3f to glm::mat3
-static glm::mat3 eigenToGlm(const Eigen::Matrix3f& eigenMat)
+// inverse of ScatterToPlanar
+static void GatherFromPlanar(const uint8_t* planarData, size_t numGaussians, bool fullSH, size_t begin, size_t count, uint8_t* dst)
 {
-    glm::mat3 glmMat;
-    for (int r = 0; r < 3; ++r)
+    GaussianStream streams[MAX_GAUSSIAN_STREAMS];
+    const int numStreams = GetGaussianStreams(fullSH, streams);
+    const size_t recordSize = fullSH ? sizeof(FullGaussianData) : sizeof(BaseGaussianData);
+    const uint8_t* streamPtr = planarData;
+    for (int k = 0; k < numStreams; k++)
     {
-        for (int c = 0; c < 3; ++c)
+        const uint8_t* src = streamPtr + begin * streams[k].size;
+        uint8_t* recordPtr = dst + streams[k].recordOffset;
+        for (size_t i = 0; i < count; i++)
         {
-            glmMat[c][r] = eigenMat(r, c);
+            memcpy(recordPtr, src, streams[k].size);
+            src += streams[k].size;
+            recordPtr += recordSize;
         }
+        streamPtr += numGaussians * streams[k].size;
     }
-    return glmMat;
 }
 
-static glm::mat3 ComputeCovMatFromRotScale(float rot[4], float scale[3])
+static float ComputeOpacityFromAlpha(float alpha)
 {
-    glm::quat q(rot[0], rot[1], rot[2], rot[3]);
-    glm::mat3 R(glm::normalize(q));
-    glm::mat3 S(glm::vec3(scale[0], 0.0f, 0.0f),
-                glm::vec3(0.0f, scale[1], 0.0f),
-                glm::vec3(0.0f, 0.0f, scale[2]));
-    return R * S * glm::transpose(S) * glm::transpose(R);
+    return -logf((1.0f / alpha) - 1.0f);
 }
 
-static void ComputeRotScaleFromCovMat(const glm::mat3& V, glm::quat& rotOut, glm::vec3& scaleOut)
+// Header of the native .gscache format, followed by numGaussians * stride bytes of
+// BaseGaussianData (shDegree 0) or FullGaussianData (shDegree 3), or their streams with GAUSSIAN_CACHE_FLAG_PLANAR.
+// The cache is only meant to be read back on the machine that wrote it, so it uses the native byte order.
+struct GaussianCacheHeader
 {
-    Eigen::Matrix3f eigenV = glmToEigen(V);
+    char magic[8];
+    uint32_t version;
+    uint32_t stride;
+    uint64_t numGaussians;
+    uint32_t shDegree;
+    uint32_t flags;  // GAUSSIAN_CACHE_FLAG_*
+    uint64_t sourceSize;  // size and modification time of the ply the cache was written from
+    int64_t sourceMTime;
+    float aabbMin[3];
+    float aabbMax[3];
+    uint8_t padding[56];  // keeps the data 16 byte aligned
+};
+static_assert(sizeof(GaussianCacheHeader) == 128, "GaussianCacheHeader layout changed, bump GAUSSIAN_CACHE_VERSION");
 
-    // Perform Eigen decomposition
-    Eigen::SelfAdjointEigenSolver<Eigen::Matrix3f> solver(eigenV);
+// Header of the compressed .gsz format, followed by ceil(numGaussians / chunkSize) chunks encoded by EncodeSplatChunk().
+// Every chunk except the last one holds chunkSize splats, so the chunk offsets follow from the header.
+struct CompressedHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t numSHCoeffs;  // per color channel, 1 or 16
+    uint64_t numGaussians;
+    uint32_t chunkSize;
+    uint8_t padding[36];
+};
+static_assert(sizeof(CompressedHeader) == 64, "CompressedHeader layout changed, bump COMPRESSED_VERSION");
+
+// structure-of-arrays storage for one chunk of the compressed format
+struct CompressedChunkScratch
+{
+    std::vector<float> storage;
+    SplatChunk chunk;
 
-    // Get eigenvectors and eigenvalues
-    Eigen::Matrix3f eigenVec = solver.eigenvectors();
-    Eigen::Array3f eigenVal = solver.eigenvalues();
-    glm::mat3 R = eigenToGlm(eigenVec);
-    // glm mat3 to quat only works when det is 1.
-    if (glm::determinant(R) < 0)
+    CompressedChunkScratch() : storage((3 + 1 + 3 + 4 + 3 * COMPRESSED_MAX_SH_COEFFS) * COMPRESSED_CHUNK_SIZE)
     {
-        R[0] *= -1.0f;
-        R[1] *= -1.0f;
-        R[2] *= -1.0f;
+        float* ptr = storage.data();
+        auto next = [&ptr]() { float* result = ptr; ptr += COMPRESSED_CHUNK_SIZE; return result; };
+        for (int k = 0; k < 3; k++)
+        {
+            chunk.pos[k] = next();
+        }
+        chunk.alpha = next();
+        for (int k = 0; k < 3; k++)
+        {
+            chunk.logScale[k] = next();
+        }
+        for (int k = 0; k < 4; k++)
+        {
+            chunk.rot[k] = next();
+        }
+        for (int k = 0; k < 3; k++)
+        {
+            for (int j = 0; j < COMPRESSED_MAX_SH_COEFFS; j++)
+            {
+                chunk.sh[k][j] = next();
+            }
+        }
     }
-    rotOut = glm::normalize(glm::quat(R));
-    // The eigenVal gives us the diagonal of (S*S^T), so take the sqrt to give is S.
-    scaleOut = glm::vec3(sqrtf(eigenVal(0)), sqrtf(eigenVal(1)), sqrtf(eigenVal(2)));
+};
+
+// SH coefficients of channel k (0 = red), the first 4 are in sh0, the remaining 12 in sh1..sh3 of FullGaussianData.
+static float* GetSH0(BaseGaussianData* basePtr, int k)
+{
+    float* sh0[3] = { basePtr->r_sh0, basePtr->g_sh0, basePtr->b_sh0 };
+    return sh0[k];
 }
 
-static float ComputeAlphaFromOpacity(float opacity)
+static float* GetSH1(FullGaussianData* fullPtr, int k)
 {
-    return 1.0f / (1.0f + expf(-opacity));
+    float* sh1[3] = { fullPtr->r_sh1, fullPtr->g_sh1, fullPtr->b_sh1 };
+    return sh1[k];
 }
 
-static float ComputeOpacityFromAlpha(float alpha)
+static const float* GetSH0(const BaseGaussianData* basePtr, int k)
 {
-    return -logf((1.0f / alpha) - 1.0f);
+    return GetSH0(const_cast<BaseGaussianData*>(basePtr), k);
+}
+
+static const float* GetSH1(const FullGaussianData* fullPtr, int k)
+{
+    return GetSH1(const_cast<FullGaussianData*>(fullPtr), k);
+}
+
+static bool GetSourceFileInfo(const std::string& filename, uint64_t& sizeOut, int64_t& mtimeOut)
+{
+    std::error_code ec;
+    sizeOut = (uint64_t)std::filesystem::file_size(filename, ec);
+    if (ec)
+    {
+        return false;
+    }
+    mtimeOut = (int64_t)std::filesystem::last_write_time(filename, ec).time_since_epoch().count();
+    return !ec;
+}
+
+// properties of a 3dgs ply file that are used by ImportPly
+struct PlyImportProps
+{
+    BinaryAttribute x, y, z;
+    BinaryAttribute f_dc[3];
+    BinaryAttribute f_rest[45];
+    BinaryAttribute opacity;
+    BinaryAttribute scale[3];
+    BinaryAttribute rot[4];
+};
+
+// Raw opacity, scale and rot of up to SPLAT_BATCH_SIZE vertices and their activated alpha and cov,
+// staged in structure-of-arrays form for the batched kernels in splatmath.
+// Shared by all ply decoders, so every decoder produces bit-identical output, and by ExportPly.
+struct SplatStaging
+{
+    float opacity[SPLAT_BATCH_SIZE];
+    float logScale[3][SPLAT_BATCH_SIZE];
+    float rot[4][SPLAT_BATCH_SIZE];
+    float alpha[SPLAT_BATCH_SIZE];
+    float cov[6][SPLAT_BATCH_SIZE];
+
+    void Stage(size_t i, float opacityIn, const float logScaleIn[3], const float rotIn[4])
+    {
+        opacity[i] = opacityIn;
+        logScale[0][i] = logScaleIn[0];
+        logScale[1][i] = logScaleIn[1];
+        logScale[2][i] = logScaleIn[2];
+        rot[0][i] = rotIn[0];
+        rot[1][i] = rotIn[1];
+        rot[2][i] = rotIn[2];
+        rot[3][i] = rotIn[3];
+    }
+
+    // activates the first count staged vertices and writes alpha and cov3 into dst.
+    // if rotScaleDst is not null, the raw rot and logScale are copied into it as well, ROT_SCALE_FLOATS per vertex.
+    void Flush(size_t count, uint8_t* dst, size_t dstStride, float* rotScaleDst)
+    {
+        SplatParamsBatch in = { opacity, { logScale[0], logScale[1], logScale[2] }, { rot[0], rot[1], rot[2], rot[3] } };
+        SplatActivatedBatch out = { alpha, { cov[0], cov[1], cov[2], cov[3], cov[4], cov[5] } };
+        ActivateSplats(in, out, count);
+
+        for (size_t i = 0; i < count; i++)
+        {
+            BaseGaussianData* basePtr = reinterpret_cast<BaseGaussianData*>(dst);
+            basePtr->posWithAlpha[3] = alpha[i];
+            basePtr->cov3_col0[0] = cov[0][i];
+            basePtr->cov3_col0[1] = cov[1][i];
+            basePtr->cov3_col0[2] = cov[2][i];
+            basePtr->cov3_col1[0] = cov[1][i];
+            basePtr->cov3_col1[1] = cov[3][i];
+            basePtr->cov3_col1[2] = cov[4][i];
+            basePtr->cov3_col2[0] = cov[2][i];
+            basePtr->cov3_col2[1] = cov[4][i];
+            basePtr->cov3_col2[2] = cov[5][i];
+            dst += dstStride;
+        }
+
+        if (rotScaleDst)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                rotScaleDst[0] = rot[0][i];
+                rotScaleDst[1] = rot[1][i];
+                rotScaleDst[2] = rot[2][i];
+                rotScaleDst[3] = rot[3][i];
+                rotScaleDst[4] = logScale[0][i];
+                rotScaleDst[5] = logScale[1][i];
+                rotScaleDst[6] = logScale[2][i];
+                rotScaleDst += ROT_SCALE_FLOATS;
+            }
+        }
+    }
+
+    // reads alpha and cov3 of count gaussians from src, and recovers opacity, logScale and rot.
+    void Deactivate(size_t count, const uint8_t* src, size_t srcStride)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            const BaseGaussianData* basePtr = reinterpret_cast<const BaseGaussianData*>(src);
+            alpha[i] = basePtr->posWithAlpha[3];
+            cov[0][i] = basePtr->cov3_col0[0];
+            cov[1][i] = basePtr->cov3_col0[1];
+            cov[2][i] = basePtr->cov3_col0[2];
+            cov[3][i] = basePtr->cov3_col1[1];
+            cov[4][i] = basePtr->cov3_col1[2];
+            cov[5][i] = basePtr->cov3_col2[2];
+            src += srcStride;
+        }
+
+        SplatActivatedBatch in = { alpha, { cov[0], cov[1], cov[2], cov[3], cov[4], cov[5] } };
+        SplatParamsBatch out = { opacity, { logScale[0], logScale[1], logScale[2] }, { rot[0], rot[1], rot[2], rot[3] } };
+        DeactivateSplats(in, out, count);
+    }
+};
+
+//
+// Layout-specialized ply decoders.
+// Each PlyLayout describes a well known all-float vertex layout, as float offsets from the start of the vertex.
+// The offsets are compile time constants, so DecodePlyVertices compiles to straight loads instead of
+// a BinaryAttribute::Read() per field.
+//
+
+// x y z nx ny nz f_dc_0..2 f_rest_0..44 opacity scale_0..2 rot_0..3, written by the reference 3dgs trainer
+struct PlyLayoutFullSH
+{
+    static constexpr size_t STRIDE = 62, X = 0, F_DC = 6, F_REST = 9, OPACITY = 54, SCALE = 55, ROT = 58;
+    static constexpr bool HAS_F_REST = true;
+};
+
+// same as above without normals
+struct PlyLayoutFullSHNoNormals
+{
+    static constexpr size_t STRIDE = 59, X = 0, F_DC = 3, F_REST = 6, OPACITY = 51, SCALE = 52, ROT = 55;
+    static constexpr bool HAS_F_REST = true;
+};
+
+// x y z nx ny nz f_dc_0..2 opacity scale_0..2 rot_0..3, written by ExportPly without exportFullSH
+struct PlyLayoutDC
+{
+    static constexpr size_t STRIDE = 17, X = 0, F_DC = 6, F_REST = 0, OPACITY = 9, SCALE = 10, ROT = 13;
+    static constexpr bool HAS_F_REST = false;
+};
+
+// same as above without normals
+struct PlyLayoutDCNoNormals
+{
+    static constexpr size_t STRIDE = 14, X = 0, F_DC = 3, F_REST = 0, OPACITY = 6, SCALE = 7, ROT = 10;
+    static constexpr bool HAS_F_REST = false;
+};
+
+template <typename Layout>
+static bool MatchesPlyLayout(const Ply& ply, const PlyImportProps& props, bool fullSH)
+{
+    auto isFloatAt = [](const BinaryAttribute& attrib, size_t floatOffset)
+    {
+        return attrib.type == BinaryAttribute::Type::Float && attrib.offset == floatOffset * sizeof(float);
+    };
+
+    if (ply.GetVertexSize() != Layout::STRIDE * sizeof(float) ||
+        !isFloatAt(props.x, Layout::X) || !isFloatAt(props.y, Layout::X + 1) || !isFloatAt(props.z, Layout::X + 2) ||
+        !isFloatAt(props.opacity, Layout::OPACITY))
+    {
+        return false;
+    }
+    for (int i = 0; i < 3; i++)
+    {
+        if (!isFloatAt(props.f_dc[i], Layout::F_DC + i) || !isFloatAt(props.scale[i], Layout::SCALE + i))
+        {
+            return false;
+        }
+    }
+    for (int i = 0; i < 4; i++)
+    {
+        if (!isFloatAt(props.rot[i], Layout::ROT + i))
+        {
+            return false;
+        }
+    }
+    if (fullSH)
+    {
+        if (!Layout::HAS_F_REST)
+        {
+            return false;
+        }
+        for (int i = 0; i < 45; i++)
+        {
+            if (!isFloatAt(props.f_rest[i], Layout::F_REST + i))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+template <typename Layout, bool FULL_SH>
+static void DecodePlyVertices(const uint8_t* src, size_t count, uint8_t* dst, size_t dstStride, SplatStaging& staging)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        // the vertex payload starts right after the text header, so it is not guaranteed to be float aligned.
+        float v[Layout::STRIDE];
+        memcpy(v, src + i * Layout::STRIDE * sizeof(float), sizeof(v));
+
+        BaseGaussianData* basePtr = reinterpret_cast<BaseGaussianData*>(dst + i * dstStride);
+        basePtr->posWithAlpha[0] = v[Layout::X + 0];
+        basePtr->posWithAlpha[1] = v[Layout::X + 1];
+        basePtr->posWithAlpha[2] = v[Layout::X + 2];
+
+        if constexpr (FULL_SH)
+        {
+            // f_rest holds 15 coefficients per channel, r_sh1..r_sh3 etc. are contiguous.
+            FullGaussianData* fullPtr = static_cast<FullGaussianData*>(basePtr);
+            const float* rest = v + Layout::F_REST;
+            fullPtr->r_sh0[0] = v[Layout::F_DC + 0];
+            memcpy(&fullPtr->r_sh0[1], rest + 0, 3 * sizeof(float));
+            memcpy(fullPtr->r_sh1, rest + 3, 12 * sizeof(float));
+            fullPtr->g_sh0[0] = v[Layout::F_DC + 1];
+            memcpy(&fullPtr->g_sh0[1], rest + 15, 3 * sizeof(float));
+            memcpy(fullPtr->g_sh1, rest + 18, 12 * sizeof(float));
+            fullPtr->b_sh0[0] = v[Layout::F_DC + 2];
+            memcpy(&fullPtr->b_sh0[1], rest + 30, 3 * sizeof(float));
+            memcpy(fullPtr->b_sh1, rest + 33, 12 * sizeof(float));
+        }
+        else
+        {
+            basePtr->r_sh0[0] = v[Layout::F_DC + 0];
+            basePtr->r_sh0[1] = 0.0f;
+            basePtr->r_sh0[2] = 0.0f;
+            basePtr->r_sh0[3] = 0.0f;
+            basePtr->g_sh0[0] = v[Layout::F_DC + 1];
+            basePtr->g_sh0[1] = 0.0f;
+            basePtr->g_sh0[2] = 0.0f;
+            basePtr->g_sh0[3] = 0.0f;
+            basePtr->b_sh0[0] = v[Layout::F_DC + 2];
+            basePtr->b_sh0[1] = 0.0f;
+            basePtr->b_sh0[2] = 0.0f;
+            basePtr->b_sh0[3] = 0.0f;
+        }
+
+        staging.Stage(i, v[Layout::OPACITY], v + Layout::SCALE, v + Layout::ROT);
+    }
+}
+
+// decodes positions and sh of up to SPLAT_BATCH_SIZE vertices into dst, and stages the rest for SplatStaging::Flush()
+using PlyDecoderFunc = void (*)(const uint8_t* src, size_t count, uint8_t* dst, size_t dstStride, SplatStaging& staging);
+
+template <typename Layout>
+static PlyDecoderFunc GetPlyDecoder(bool fullSH)
+{
+    if (fullSH)
+    {
+        return &DecodePlyVertices<Layout, true>;
+    }
+    else
+    {
+        return &DecodePlyVertices<Layout, false>;
+    }
+}
+
+// returns nullptr if the ply does not match any known layout
+static PlyDecoderFunc FindPlyDecoder(const Ply& ply, const PlyImportProps& props, bool fullSH)
+{
+    if (MatchesPlyLayout<PlyLayoutFullSH>(ply, props, fullSH))
+    {
+        return GetPlyDecoder<PlyLayoutFullSH>(fullSH);
+    }
+    if (MatchesPlyLayout<PlyLayoutFullSHNoNormals>(ply, props, fullSH))
+    {
+        return GetPlyDecoder<PlyLayoutFullSHNoNormals>(fullSH);
+    }
+    if (MatchesPlyLayout<PlyLayoutDC>(ply, props, fullSH))
+    {
+        return GetPlyDecoder<PlyLayoutDC>(fullSH);
+    }
+    if (MatchesPlyLayout<PlyLayoutDCNoNormals>(ply, props, fullSH))
+    {
+        return GetPlyDecoder<PlyLayoutDCNoNormals>(fullSH);
+    }
+    return nullptr;
 }
 
 GaussianCloud::GaussianCloud(const Options& options) :
+    posWithAlphaStride(0),
+    sh0Stride(0),
+    shRestStride(0),
+    cov3Stride(0),
     numGaussians(0),
     gaussianSize(0),
+    numResident(0),
+    cancelLoad(false),
     opt(options),
     hasFullSH(false)
 {
     ;
 }
 
-bool GaussianCloud::ImportPly(const std::string& plyFilename)
+GaussianCloud::~GaussianCloud()
 {
-    ZoneScopedNC("GC::ImportPly", tracy::Color::Red4);
+    cancelLoad = true;
+    WaitForLoad();
+}
 
-    std::ifstream plyFile(plyFilename, std::ios::binary);
-    if (!plyFile.is_open())
+void GaussianCloud::WaitForLoad()
+{
+    if (loadThread.joinable())
     {
-        spdlog::error("failed to open {}\n", plyFilename);
-        return false;
+        loadThread.join();
     }
+}
 
-    Ply ply;
+bool GaussianCloud::ImportPly(const std::string& plyFilename)
+{
+    return LoadPly(plyFilename, false);
+}
+
+bool GaussianCloud::ImportPlyProgressive(const std::string& plyFilename)
+{
+    return LoadPly(plyFilename, true);
+}
+
+bool GaussianCloud::LoadPly(const std::string& plyFilename, bool progressive)
+{
+    ZoneScopedNC("GC::ImportPly", tracy::Color::Red4);
+
+    // a previous progressive load may still be writing into data
+    cancelLoad = true;
+    WaitForLoad();
+    cancelLoad = false;
+    numResident = 0;
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    // shared with the background thread of a progressive load
+    std::shared_ptr<Ply> plyPtr = std::make_shared<Ply>();
+    Ply& ply = *plyPtr;
 
     {
         ZoneScopedNC("ply.Parse", tracy::Color::Blue);
-        if (!ply.Parse(plyFile))
+        if (!ply.ParseMapped(plyFilename))
         {
             spdlog::error("Error parsing ply file \"{}\"\n", plyFilename);
             return false;
         }
     }
 
-    struct
-    {
-        BinaryAttribute x, y, z;
-        BinaryAttribute f_dc[3];
-        BinaryAttribute f_rest[45];
-        BinaryAttribute opacity;
-        BinaryAttribute scale[3];
-        BinaryAttribute rot[4];
-    } props;
+    PlyImportProps props;
 
     {
         ZoneScopedNC("ply.GetProps", tracy::Color::Green);
@@ -227,138 +646,211 @@ bool GaussianCloud::ImportPly(const std::string& plyFilename)
 
     }
 
-    InitAttribs();
-
     {
         ZoneScopedNC("alloc data", tracy::Color::Red4);
 
         numGaussians = ply.GetVertexCount();
-        if (hasFullSH)
-        {
-            gaussianSize = sizeof(FullGaussianData);
-            FullGaussianData* fullPtr = new FullGaussianData[numGaussians];
-            data.reset(fullPtr);
-        }
-        else
+        gaussianSize = hasFullSH ? sizeof(FullGaussianData) : sizeof(BaseGaussianData);
+        AllocData();
+        InitAttribs();
+
+        rotScaleData.clear();
+        if (opt.keepRotScale)
         {
-            gaussianSize = sizeof(BaseGaussianData);
-            BaseGaussianData* basePtr = new BaseGaussianData[numGaussians];
-            data.reset(basePtr);
+            rotScaleData.resize(numGaussians * ROT_SCALE_FLOATS);
         }
     }
 
     {
         ZoneScopedNC("ply.ForEachVertex", tracy::Color::Blue);
-        int i = 0;
-        uint8_t* rawPtr = (uint8_t*)data.get();
-        ply.ForEachVertex([this, &rawPtr, &i, &props](const void* plyData, size_t size)
+
+        PlyDecoderFunc decoder = opt.genericImport ? nullptr : FindPlyDecoder(ply, props, hasFullSH);
+        if (!decoder)
         {
-            BaseGaussianData* basePtr = reinterpret_cast<BaseGaussianData*>(rawPtr);
-            basePtr->posWithAlpha[0] = props.x.Read<float>(plyData);
-            basePtr->posWithAlpha[1] = props.y.Read<float>(plyData);
-            basePtr->posWithAlpha[2] = props.z.Read<float>(plyData);
-            basePtr->posWithAlpha[3] = ComputeAlphaFromOpacity(props.opacity.Read<float>(plyData));
+            spdlog::debug("Unrecognized vertex layout in \"{}\", using generic decoder", plyFilename);
+        }
+        spdlog::debug("Activating splats with {} kernels", GetSplatMathISA());
 
-            if (hasFullSH)
+        // each chunk converts its own vertex range into the matching slice of the preallocated data,
+        // so the result does not depend on how the range is split across threads.
+        auto convertRange = [this, plyPtr, props, decoder](size_t begin, size_t end)
+        {
+            const Ply& ply = *plyPtr;
+            std::unique_ptr<SplatStaging> staging(new SplatStaging);
+            std::vector<uint8_t> recordScratch(opt.planarLayout ? SPLAT_BATCH_SIZE * gaussianSize : 0);
+            for (size_t batchBegin = begin; batchBegin < end; batchBegin += SPLAT_BATCH_SIZE)
             {
-                FullGaussianData* fullPtr = reinterpret_cast<FullGaussianData*>(rawPtr);
-                fullPtr->r_sh0[0] = props.f_dc[0].Read<float>(plyData);
-                fullPtr->r_sh0[1] = props.f_rest[0].Read<float>(plyData);
-                fullPtr->r_sh0[2] = props.f_rest[1].Read<float>(plyData);
-                fullPtr->r_sh0[3] = props.f_rest[2].Read<float>(plyData);
-                fullPtr->r_sh1[0] = props.f_rest[3].Read<float>(plyData);
-                fullPtr->r_sh1[1] = props.f_rest[4].Read<float>(plyData);
-                fullPtr->r_sh1[2] = props.f_rest[5].Read<float>(plyData);
-                fullPtr->r_sh1[3] = props.f_rest[6].Read<float>(plyData);
-                fullPtr->r_sh2[0] = props.f_rest[7].Read<float>(plyData);
-                fullPtr->r_sh2[1] = props.f_rest[8].Read<float>(plyData);
-                fullPtr->r_sh2[2] = props.f_rest[9].Read<float>(plyData);
-                fullPtr->r_sh2[3] = props.f_rest[10].Read<float>(plyData);
-                fullPtr->r_sh3[0] = props.f_rest[11].Read<float>(plyData);
-                fullPtr->r_sh3[1] = props.f_rest[12].Read<float>(plyData);
-                fullPtr->r_sh3[2] = props.f_rest[13].Read<float>(plyData);
-                fullPtr->r_sh3[3] = props.f_rest[14].Read<float>(plyData);
-
-                fullPtr->g_sh0[0] = props.f_dc[1].Read<float>(plyData);
-                fullPtr->g_sh0[1] = props.f_rest[15].Read<float>(plyData);
-                fullPtr->g_sh0[2] = props.f_rest[16].Read<float>(plyData);
-                fullPtr->g_sh0[3] = props.f_rest[17].Read<float>(plyData);
-                fullPtr->g_sh1[0] = props.f_rest[18].Read<float>(plyData);
-                fullPtr->g_sh1[1] = props.f_rest[19].Read<float>(plyData);
-                fullPtr->g_sh1[2] = props.f_rest[20].Read<float>(plyData);
-                fullPtr->g_sh1[3] = props.f_rest[21].Read<float>(plyData);
-                fullPtr->g_sh2[0] = props.f_rest[22].Read<float>(plyData);
-                fullPtr->g_sh2[1] = props.f_rest[23].Read<float>(plyData);
-                fullPtr->g_sh2[2] = props.f_rest[24].Read<float>(plyData);
-                fullPtr->g_sh2[3] = props.f_rest[25].Read<float>(plyData);
-                fullPtr->g_sh3[0] = props.f_rest[26].Read<float>(plyData);
-                fullPtr->g_sh3[1] = props.f_rest[27].Read<float>(plyData);
-                fullPtr->g_sh3[2] = props.f_rest[28].Read<float>(plyData);
-                fullPtr->g_sh3[3] = props.f_rest[29].Read<float>(plyData);
-
-                fullPtr->b_sh0[0] = props.f_dc[2].Read<float>(plyData);
-                fullPtr->b_sh0[1] = props.f_rest[30].Read<float>(plyData);
-                fullPtr->b_sh0[2] = props.f_rest[31].Read<float>(plyData);
-                fullPtr->b_sh0[3] = props.f_rest[32].Read<float>(plyData);
-                fullPtr->b_sh1[0] = props.f_rest[33].Read<float>(plyData);
-                fullPtr->b_sh1[1] = props.f_rest[34].Read<float>(plyData);
-                fullPtr->b_sh1[2] = props.f_rest[35].Read<float>(plyData);
-                fullPtr->b_sh1[3] = props.f_rest[36].Read<float>(plyData);
-                fullPtr->b_sh2[0] = props.f_rest[37].Read<float>(plyData);
-                fullPtr->b_sh2[1] = props.f_rest[38].Read<float>(plyData);
-                fullPtr->b_sh2[2] = props.f_rest[39].Read<float>(plyData);
-                fullPtr->b_sh2[3] = props.f_rest[40].Read<float>(plyData);
-                fullPtr->b_sh3[0] = props.f_rest[41].Read<float>(plyData);
-                fullPtr->b_sh3[1] = props.f_rest[42].Read<float>(plyData);
-                fullPtr->b_sh3[2] = props.f_rest[43].Read<float>(plyData);
-                fullPtr->b_sh3[3] = props.f_rest[44].Read<float>(plyData);
+                size_t batchEnd = std::min(batchBegin + SPLAT_BATCH_SIZE, end);
+                uint8_t* batchPtr = GetRecordsForWrite(batchBegin, recordScratch.data());
+                float* rotScalePtr = opt.keepRotScale ? rotScaleData.data() + batchBegin * ROT_SCALE_FLOATS : nullptr;
+                if (decoder)
+                {
+                    decoder(ply.GetVertexData(batchBegin), batchEnd - batchBegin, batchPtr, gaussianSize, *staging);
+                    staging->Flush(batchEnd - batchBegin, batchPtr, gaussianSize, rotScalePtr);
+                    StoreRecords(batchBegin, batchEnd - batchBegin, batchPtr);
+                    continue;
+                }
+
+                uint8_t* rawPtr = batchPtr;
+                size_t i = 0;
+                ply.ForEachVertexInRange(batchBegin, batchEnd, [this, &rawPtr, &props, &staging, &i](const void* plyData, size_t size)
+                {
+                    BaseGaussianData* basePtr = reinterpret_cast<BaseGaussianData*>(rawPtr);
+                    basePtr->posWithAlpha[0] = props.x.Read<float>(plyData);
+                    basePtr->posWithAlpha[1] = props.y.Read<float>(plyData);
+                    basePtr->posWithAlpha[2] = props.z.Read<float>(plyData);
+
+                    if (hasFullSH)
+                    {
+                        FullGaussianData* fullPtr = reinterpret_cast<FullGaussianData*>(rawPtr);
+                        fullPtr->r_sh0[0] = props.f_dc[0].Read<float>(plyData);
+                        fullPtr->r_sh0[1] = props.f_rest[0].Read<float>(plyData);
+                        fullPtr->r_sh0[2] = props.f_rest[1].Read<float>(plyData);
+                        fullPtr->r_sh0[3] = props.f_rest[2].Read<float>(plyData);
+                        fullPtr->r_sh1[0] = props.f_rest[3].Read<float>(plyData);
+                        fullPtr->r_sh1[1] = props.f_rest[4].Read<float>(plyData);
+                        fullPtr->r_sh1[2] = props.f_rest[5].Read<float>(plyData);
+                        fullPtr->r_sh1[3] = props.f_rest[6].Read<float>(plyData);
+                        fullPtr->r_sh2[0] = props.f_rest[7].Read<float>(plyData);
+                        fullPtr->r_sh2[1] = props.f_rest[8].Read<float>(plyData);
+                        fullPtr->r_sh2[2] = props.f_rest[9].Read<float>(plyData);
+                        fullPtr->r_sh2[3] = props.f_rest[10].Read<float>(plyData);
+                        fullPtr->r_sh3[0] = props.f_rest[11].Read<float>(plyData);
+                        fullPtr->r_sh3[1] = props.f_rest[12].Read<float>(plyData);
+                        fullPtr->r_sh3[2] = props.f_rest[13].Read<float>(plyData);
+                        fullPtr->r_sh3[3] = props.f_rest[14].Read<float>(plyData);
+
+                        fullPtr->g_sh0[0] = props.f_dc[1].Read<float>(plyData);
+                        fullPtr->g_sh0[1] = props.f_rest[15].Read<float>(plyData);
+                        fullPtr->g_sh0[2] = props.f_rest[16].Read<float>(plyData);
+                        fullPtr->g_sh0[3] = props.f_rest[17].Read<float>(plyData);
+                        fullPtr->g_sh1[0] = props.f_rest[18].Read<float>(plyData);
+                        fullPtr->g_sh1[1] = props.f_rest[19].Read<float>(plyData);
+                        fullPtr->g_sh1[2] = props.f_rest[20].Read<float>(plyData);
+                        fullPtr->g_sh1[3] = props.f_rest[21].Read<float>(plyData);
+                        fullPtr->g_sh2[0] = props.f_rest[22].Read<float>(plyData);
+                        fullPtr->g_sh2[1] = props.f_rest[23].Read<float>(plyData);
+                        fullPtr->g_sh2[2] = props.f_rest[24].Read<float>(plyData);
+                        fullPtr->g_sh2[3] = props.f_rest[25].Read<float>(plyData);
+                        fullPtr->g_sh3[0] = props.f_rest[26].Read<float>(plyData);
+                        fullPtr->g_sh3[1] = props.f_rest[27].Read<float>(plyData);
+                        fullPtr->g_sh3[2] = props.f_rest[28].Read<float>(plyData);
+                        fullPtr->g_sh3[3] = props.f_rest[29].Read<float>(plyData);
+
+                        fullPtr->b_sh0[0] = props.f_dc[2].Read<float>(plyData);
+                        fullPtr->b_sh0[1] = props.f_rest[30].Read<float>(plyData);
+                        fullPtr->b_sh0[2] = props.f_rest[31].Read<float>(plyData);
+                        fullPtr->b_sh0[3] = props.f_rest[32].Read<float>(plyData);
+                        fullPtr->b_sh1[0] = props.f_rest[33].Read<float>(plyData);
+                        fullPtr->b_sh1[1] = props.f_rest[34].Read<float>(plyData);
+                        fullPtr->b_sh1[2] = props.f_rest[35].Read<float>(plyData);
+                        fullPtr->b_sh1[3] = props.f_rest[36].Read<float>(plyData);
+                        fullPtr->b_sh2[0] = props.f_rest[37].Read<float>(plyData);
+                        fullPtr->b_sh2[1] = props.f_rest[38].Read<float>(plyData);
+                        fullPtr->b_sh2[2] = props.f_rest[39].Read<float>(plyData);
+                        fullPtr->b_sh2[3] = props.f_rest[40].Read<float>(plyData);
+                        fullPtr->b_sh3[0] = props.f_rest[41].Read<float>(plyData);
+                        fullPtr->b_sh3[1] = props.f_rest[42].Read<float>(plyData);
+                        fullPtr->b_sh3[2] = props.f_rest[43].Read<float>(plyData);
+                        fullPtr->b_sh3[3] = props.f_rest[44].Read<float>(plyData);
+                    }
+                    else
+                    {
+                        basePtr->r_sh0[0] = props.f_dc[0].Read<float>(plyData);
+                        basePtr->r_sh0[1] = 0.0f;
+                        basePtr->r_sh0[2] = 0.0f;
+                        basePtr->r_sh0[3] = 0.0f;
+
+                        basePtr->g_sh0[0] = props.f_dc[1].Read<float>(plyData);
+                        basePtr->g_sh0[1] = 0.0f;
+                        basePtr->g_sh0[2] = 0.0f;
+                        basePtr->g_sh0[3] = 0.0f;
+
+                        basePtr->b_sh0[0] = props.f_dc[2].Read<float>(plyData);
+                        basePtr->b_sh0[1] = 0.0f;
+                        basePtr->b_sh0[2] = 0.0f;
+                        basePtr->b_sh0[3] = 0.0f;
+                    }
+
+                    float logScale[3] =
+                    {
+                        props.scale[0].Read<float>(plyData),
+                        props.scale[1].Read<float>(plyData),
+                        props.scale[2].Read<float>(plyData)
+                    };
+                    float rot[4] =
+                    {
+                        props.rot[0].Read<float>(plyData),
+                        props.rot[1].Read<float>(plyData),
+                        props.rot[2].Read<float>(plyData),
+                        props.rot[3].Read<float>(plyData)
+                    };
+
+                    staging->Stage(i++, props.opacity.Read<float>(plyData), logScale, rot);
+                    rawPtr += gaussianSize;
+                });
+                staging->Flush(batchEnd - batchBegin, batchPtr, gaussianSize, rotScalePtr);
+                StoreRecords(batchBegin, batchEnd - batchBegin, batchPtr);
             }
-            else
+        };
+
+        // the progressive import runs in the background, so it converts one grain per thread at a time and lets
+        // the ParallelFor() calls of the render thread go first instead of holding the pool for a whole chunk
+        auto convertChunk = [this, convertRange](size_t begin, size_t end, bool background)
+        {
+            if (opt.serialImport)
             {
-                basePtr->r_sh0[0] = props.f_dc[0].Read<float>(plyData);
-                basePtr->r_sh0[1] = 0.0f;
-                basePtr->r_sh0[2] = 0.0f;
-                basePtr->r_sh0[3] = 0.0f;
-
-                basePtr->g_sh0[0] = props.f_dc[1].Read<float>(plyData);
-                basePtr->g_sh0[1] = 0.0f;
-                basePtr->g_sh0[2] = 0.0f;
-                basePtr->g_sh0[3] = 0.0f;
-
-                basePtr->b_sh0[0] = props.f_dc[2].Read<float>(plyData);
-                basePtr->b_sh0[1] = 0.0f;
-                basePtr->b_sh0[2] = 0.0f;
-                basePtr->b_sh0[3] = 0.0f;
+                convertRange(begin, end);
+                return;
             }
 
-            // NOTE: scale is stored in logarithmic scale in plyFile
-            float scale[3] =
+            ThreadPool& pool = ThreadPool::Get();
+            const size_t jobSize = background ? IMPORT_GRAIN_SIZE * pool.GetNumThreads() : end - begin;
+            for (size_t jobBegin = begin; jobBegin < end; jobBegin += jobSize)
             {
-                expf(props.scale[0].Read<float>(plyData)),
-                expf(props.scale[1].Read<float>(plyData)),
-                expf(props.scale[2].Read<float>(plyData))
-            };
-            float rot[4] =
+                size_t jobEnd = std::min(jobBegin + jobSize, end);
+                if (background)
+                {
+                    pool.WaitForOtherCallers();
+                }
+                pool.ParallelFor(jobEnd - jobBegin, IMPORT_GRAIN_SIZE, [jobBegin, &convertRange](size_t b, size_t e)
+                {
+                    convertRange(jobBegin + b, jobBegin + e);
+                });
+            }
+        };
+
+        auto logImport = [this, plyPtr, startTime]()
+        {
+            auto endTime = std::chrono::high_resolution_clock::now();
+            double seconds = std::chrono::duration<double>(endTime - startTime).count();
+            double gigabytes = (double)(plyPtr->GetVertexSize() * plyPtr->GetVertexCount()) / 1.0e9;
+            spdlog::info("Imported {} gaussians ({:.2f} GB{}) in {:.3f} s, {:.2f} GB/s",
+                         numGaussians, gigabytes, plyPtr->IsMapped() ? ", mapped" : "", seconds, gigabytes / seconds);
+        };
+
+        if (progressive)
+        {
+            // chunks are converted in order, so the resident gaussians are always a prefix of data.
+            loadThread = std::thread([this, convertChunk, logImport]()
             {
-                props.rot[0].Read<float>(plyData),
-                props.rot[1].Read<float>(plyData),
-                props.rot[2].Read<float>(plyData),
-                props.rot[3].Read<float>(plyData)
-            };
-
-            glm::mat3 V = ComputeCovMatFromRotScale(rot, scale);
-            basePtr->cov3_col0[0] = V[0][0];
-            basePtr->cov3_col0[1] = V[0][1];
-            basePtr->cov3_col0[2] = V[0][2];
-            basePtr->cov3_col1[0] = V[1][0];
-            basePtr->cov3_col1[1] = V[1][1];
-            basePtr->cov3_col1[2] = V[1][2];
-            basePtr->cov3_col2[0] = V[2][0];
-            basePtr->cov3_col2[1] = V[2][1];
-            basePtr->cov3_col2[2] = V[2][2];
-            i++;
-            rawPtr += gaussianSize;
-        });
+                for (size_t begin = 0; begin < numGaussians && !cancelLoad; begin += PROGRESSIVE_CHUNK_SIZE)
+                {
+                    size_t end = std::min(begin + PROGRESSIVE_CHUNK_SIZE, numGaussians);
+                    convertChunk(begin, end, true);
+                    numResident.store(end, std::memory_order_release);
+                }
+                if (!cancelLoad)
+                {
+                    logImport();
+                }
+            });
+            return true;
+        }
+
+        convertChunk(0, numGaussians, false);
+        numResident.store(numGaussians, std::memory_order_release);
+        logImport();
     }
 
     return true;
@@ -435,70 +927,567 @@ bool GaussianCloud::ExportPly(const std::string& plyFilename) const
     ply.GetProperty("rot_2", props.rot[2]);
     ply.GetProperty("rot_3", props.rot[3]);
 
-    ply.AllocData(numGaussians);
+    // rot and scale kept from import can be written back as is, which skips the eigen decomposition.
+    const bool useImportedRotScale = rotScaleData.size() == numGaussians * ROT_SCALE_FLOATS;
 
-    uint8_t* gData = (uint8_t*)data.get();
-    size_t runningSize = 0;
-    ply.ForEachVertexMut([this, &props, &gData, &runningSize](void* plyData, size_t size)
+    // encodes vertices [begin, end) into dst, which holds (end - begin) ply vertices
+    auto encodeRange = [this, &props, &ply, useImportedRotScale](size_t begin, size_t end, uint8_t* dst)
     {
-        const float* posWithAlpha = posWithAlphaAttrib.Get<float>(gData);
-        const float* r_sh0 = r_sh0Attrib.Get<float>(gData);
-        const float* g_sh0 = g_sh0Attrib.Get<float>(gData);
-        const float* b_sh0 = b_sh0Attrib.Get<float>(gData);
-        const float* cov3_col0 = cov3_col0Attrib.Get<float>(gData);
-
-        props.x.Write<float>(plyData, posWithAlpha[0]);
-        props.y.Write<float>(plyData, posWithAlpha[1]);
-        props.z.Write<float>(plyData, posWithAlpha[2]);
-        props.nx.Write<float>(plyData, 0.0f);
-        props.ny.Write<float>(plyData, 0.0f);
-        props.nz.Write<float>(plyData, 0.0f);
-        props.f_dc[0].Write<float>(plyData, r_sh0[0]);
-        props.f_dc[1].Write<float>(plyData, g_sh0[0]);
-        props.f_dc[2].Write<float>(plyData, b_sh0[0]);
-
-        if (opt.exportFullSH)
+        std::unique_ptr<SplatStaging> staging(new SplatStaging);
+        std::vector<uint8_t> recordScratch(opt.planarLayout ? SPLAT_BATCH_SIZE * gaussianSize : 0);
+        for (size_t batchBegin = begin; batchBegin < end; batchBegin += SPLAT_BATCH_SIZE)
         {
-            // TODO: maybe just a raw memcopy would be faster
-            for (int i = 0; i < 15; i++)
+            size_t batchEnd = std::min(batchBegin + SPLAT_BATCH_SIZE, end);
+            const uint8_t* gData = GetRecordsForRead(batchBegin, batchEnd - batchBegin, recordScratch.data());
+            if (!useImportedRotScale)
             {
-                props.f_rest[i].Write<float>(plyData, r_sh0[i + 1]);
+                staging->Deactivate(batchEnd - batchBegin, gData, gaussianSize);
             }
-            for (int i = 0; i < 15; i++)
+
+            for (size_t i = 0; i < batchEnd - batchBegin; i++)
             {
-                props.f_rest[i + 15].Write<float>(plyData, g_sh0[i + 1]);
+                void* plyData = dst;
+                const BaseGaussianData* basePtr = reinterpret_cast<const BaseGaussianData*>(gData);
+                const float* posWithAlpha = basePtr->posWithAlpha;
+                const float* r_sh0 = basePtr->r_sh0;
+                const float* g_sh0 = basePtr->g_sh0;
+                const float* b_sh0 = basePtr->b_sh0;
+
+                props.x.Write<float>(plyData, posWithAlpha[0]);
+                props.y.Write<float>(plyData, posWithAlpha[1]);
+                props.z.Write<float>(plyData, posWithAlpha[2]);
+                props.nx.Write<float>(plyData, 0.0f);
+                props.ny.Write<float>(plyData, 0.0f);
+                props.nz.Write<float>(plyData, 0.0f);
+                props.f_dc[0].Write<float>(plyData, r_sh0[0]);
+                props.f_dc[1].Write<float>(plyData, g_sh0[0]);
+                props.f_dc[2].Write<float>(plyData, b_sh0[0]);
+
+                if (opt.exportFullSH)
+                {
+                    // TODO: maybe just a raw memcopy would be faster
+                    for (int j = 0; j < 15; j++)
+                    {
+                        props.f_rest[j].Write<float>(plyData, r_sh0[j + 1]);
+                    }
+                    for (int j = 0; j < 15; j++)
+                    {
+                        props.f_rest[j + 15].Write<float>(plyData, g_sh0[j + 1]);
+                    }
+                    for (int j = 0; j < 15; j++)
+                    {
+                        props.f_rest[j + 30].Write<float>(plyData, b_sh0[j + 1]);
+                    }
+                }
+
+                if (useImportedRotScale)
+                {
+                    const float* rotScale = rotScaleData.data() + (batchBegin + i) * ROT_SCALE_FLOATS;
+                    props.opacity.Write<float>(plyData, ComputeOpacityFromAlpha(posWithAlpha[3]));
+                    props.scale[0].Write<float>(plyData, rotScale[4]);
+                    props.scale[1].Write<float>(plyData, rotScale[5]);
+                    props.scale[2].Write<float>(plyData, rotScale[6]);
+                    props.rot[0].Write<float>(plyData, rotScale[0]);
+                    props.rot[1].Write<float>(plyData, rotScale[1]);
+                    props.rot[2].Write<float>(plyData, rotScale[2]);
+                    props.rot[3].Write<float>(plyData, rotScale[3]);
+                }
+                else
+                {
+                    props.opacity.Write<float>(plyData, staging->opacity[i]);
+                    props.scale[0].Write<float>(plyData, staging->logScale[0][i]);
+                    props.scale[1].Write<float>(plyData, staging->logScale[1][i]);
+                    props.scale[2].Write<float>(plyData, staging->logScale[2][i]);
+                    props.rot[0].Write<float>(plyData, staging->rot[0][i]);
+                    props.rot[1].Write<float>(plyData, staging->rot[1][i]);
+                    props.rot[2].Write<float>(plyData, staging->rot[2][i]);
+                    props.rot[3].Write<float>(plyData, staging->rot[3][i]);
+                }
+
+                gData += gaussianSize;
+                dst += ply.GetVertexSize();
             }
-            for (int i = 0; i < 15; i++)
+        }
+    };
+
+    ply.SetVertexCount(numGaussians);
+    ply.DumpHeader(plyFile);
+
+    // Encode EXPORT_GROUP_SIZE vertices at a time in parallel, then write them out in order.
+    // Two group buffers are used, so the next group is encoded while the previous one is being written,
+    // which bounds the extra memory to 2 * EXPORT_GROUP_SIZE vertices regardless of the scene size.
+    const size_t vertexSize = ply.GetVertexSize();
+    const size_t groupSize = std::min(EXPORT_GROUP_SIZE, std::max(numGaussians, (size_t)1));
+    std::vector<uint8_t> groupBuffers[2];
+    groupBuffers[0].resize(groupSize * vertexSize);
+    groupBuffers[1].resize(groupSize * vertexSize);
+
+    std::future<bool> pendingWrite;
+    int current = 0;
+    for (size_t groupBegin = 0; groupBegin < numGaussians; groupBegin += groupSize)
+    {
+        size_t groupEnd = std::min(groupBegin + groupSize, numGaussians);
+        uint8_t* groupPtr = groupBuffers[current].data();
+        ThreadPool::Get().ParallelFor(groupEnd - groupBegin, EXPORT_GRAIN_SIZE, [groupBegin, groupPtr, vertexSize, &encodeRange](size_t begin, size_t end)
+        {
+            encodeRange(groupBegin + begin, groupBegin + end, groupPtr + begin * vertexSize);
+        });
+
+        if (pendingWrite.valid() && !pendingWrite.get())
+        {
+            break;
+        }
+        size_t groupBytes = (groupEnd - groupBegin) * vertexSize;
+        pendingWrite = std::async(std::launch::async, [&plyFile, groupPtr, groupBytes]()
+        {
+            plyFile.write((const char*)groupPtr, groupBytes);
+            return plyFile.good();
+        });
+        current = 1 - current;
+    }
+    if (pendingWrite.valid())
+    {
+        pendingWrite.get();
+    }
+
+    if (!plyFile.good())
+    {
+        spdlog::error("failed to write {}\n", plyFilename);
+        return false;
+    }
+
+    return true;
+}
+
+bool GaussianCloud::ImportCache(const std::string& cacheFilename, const std::string& sourcePlyFilename)
+{
+    ZoneScopedNC("GC::ImportCache", tracy::Color::Red4);
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    std::ifstream cacheFile(cacheFilename, std::ios::binary);
+    if (!cacheFile.is_open())
+    {
+        spdlog::debug("No cache at \"{}\"", cacheFilename);
+        return false;
+    }
+
+    GaussianCacheHeader header;
+    if (!cacheFile.read((char*)&header, sizeof(header)) ||
+        memcmp(header.magic, GAUSSIAN_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != GAUSSIAN_CACHE_VERSION)
+    {
+        spdlog::info("Ignoring cache \"{}\", unknown format or version", cacheFilename);
+        return false;
+    }
+
+    const bool fullSH = header.shDegree == 3;
+    const uint32_t expectedStride = fullSH ? sizeof(FullGaussianData) : sizeof(BaseGaussianData);
+    const bool importFullSH = (header.flags & GAUSSIAN_CACHE_FLAG_IMPORT_FULL_SH) != 0;
+    const bool planar = (header.flags & GAUSSIAN_CACHE_FLAG_PLANAR) != 0;
+    if ((header.shDegree != 0 && !fullSH) || header.stride != expectedStride || importFullSH != opt.importFullSH ||
+        planar != opt.planarLayout)
+    {
+        spdlog::info("Ignoring cache \"{}\", it was written with different options", cacheFilename);
+        return false;
+    }
+
+    uint64_t sourceSize;
+    int64_t sourceMTime;
+    if (!GetSourceFileInfo(sourcePlyFilename, sourceSize, sourceMTime) ||
+        sourceSize != header.sourceSize || sourceMTime != header.sourceMTime)
+    {
+        spdlog::info("Ignoring cache \"{}\", \"{}\" changed since it was written", cacheFilename, sourcePlyFilename);
+        return false;
+    }
+
+    const size_t dataSize = header.numGaussians * header.stride;
+    const size_t fileSize = sizeof(GaussianCacheHeader) + dataSize;
+    std::error_code ec;
+    if (std::filesystem::file_size(cacheFilename, ec) != fileSize || ec)
+    {
+        spdlog::error("Invalid cache \"{}\", expected {} bytes", cacheFilename, fileSize);
+        return false;
+    }
+
+    // a previous progressive load may still be writing into data
+    cancelLoad = true;
+    WaitForLoad();
+    cancelLoad = false;
+
+    std::shared_ptr<void> cacheData;
+#ifndef _WIN32
+    int fd = open(cacheFilename.c_str(), O_RDONLY);
+    if (fd >= 0)
+    {
+        // private mapping, so writes to the data stay in memory and never reach the file.
+        void* ptr = mmap(nullptr, fileSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        close(fd);  // the mapping holds its own reference to the file
+        if (ptr != MAP_FAILED)
+        {
+            madvise(ptr, fileSize, MADV_SEQUENTIAL);
+            cacheData = std::shared_ptr<void>((uint8_t*)ptr + sizeof(GaussianCacheHeader), [ptr, fileSize](void*)
             {
-                props.f_rest[i + 30].Write<float>(plyData, b_sh0[i + 1]);
-            }
+                munmap(ptr, fileSize);
+            });
         }
+    }
+#endif
+    if (!cacheData)
+    {
+        // mmap is not available, read the data instead
+        uint8_t* buffer = new uint8_t[dataSize];
+        cacheData = std::shared_ptr<void>(buffer, [](void* ptr) { delete [] (uint8_t*)ptr; });
+        if (!cacheFile.read((char*)buffer, dataSize))
+        {
+            spdlog::error("Error reading cache \"{}\"", cacheFilename);
+            return false;
+        }
+    }
 
-        props.opacity.Write<float>(plyData, ComputeOpacityFromAlpha(posWithAlpha[3]));
+    data = cacheData;
+    numGaussians = header.numGaussians;
+    gaussianSize = header.stride;
+    hasFullSH = fullSH;
+    rotScaleData.clear();
+    InitAttribs();
+    numResident.store(numGaussians, std::memory_order_release);
 
-        glm::mat3 V(cov3_col0[0], cov3_col0[1], cov3_col0[2],
-                    cov3_col0[3], cov3_col0[4], cov3_col0[5],
-                    cov3_col0[6], cov3_col0[7], cov3_col0[8]);
+    auto endTime = std::chrono::high_resolution_clock::now();
+    spdlog::info("Imported {} gaussians from cache \"{}\" in {:.3f} s", numGaussians, cacheFilename,
+                 std::chrono::duration<double>(endTime - startTime).count());
+    spdlog::debug("Cache bounds ({}, {}, {}) - ({}, {}, {})",
+                  header.aabbMin[0], header.aabbMin[1], header.aabbMin[2], header.aabbMax[0], header.aabbMax[1], header.aabbMax[2]);
 
-        glm::quat rot;
-        glm::vec3 scale;
-        ComputeRotScaleFromCovMat(V, rot, scale);
+    return true;
+}
 
-        props.scale[0].Write<float>(plyData, logf(scale.x));
-        props.scale[1].Write<float>(plyData, logf(scale.y));
-        props.scale[2].Write<float>(plyData, logf(scale.z));
-        props.rot[0].Write<float>(plyData, rot.w);
-        props.rot[1].Write<float>(plyData, rot.x);
-        props.rot[2].Write<float>(plyData, rot.y);
-        props.rot[3].Write<float>(plyData, rot.z);
+bool GaussianCloud::ExportCache(const std::string& cacheFilename, const std::string& sourcePlyFilename) const
+{
+    ZoneScopedNC("GC::ExportCache", tracy::Color::Red4);
+
+    GaussianCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, GAUSSIAN_CACHE_MAGIC, sizeof(header.magic));
+    header.version = GAUSSIAN_CACHE_VERSION;
+    header.stride = (uint32_t)gaussianSize;
+    header.numGaussians = numGaussians;
+    header.shDegree = hasFullSH ? 3 : 0;
+    header.flags = (opt.importFullSH ? GAUSSIAN_CACHE_FLAG_IMPORT_FULL_SH : 0) | (opt.planarLayout ? GAUSSIAN_CACHE_FLAG_PLANAR : 0);
+    if (!GetSourceFileInfo(sourcePlyFilename, header.sourceSize, header.sourceMTime))
+    {
+        spdlog::error("failed to stat {}\n", sourcePlyFilename);
+        return false;
+    }
 
-        gData += gaussianSize;
-        runningSize += gaussianSize;
-        assert(runningSize <= GetTotalSize());  // bad, we went off the end of the data ptr
+    for (int i = 0; i < 3; i++)
+    {
+        header.aabbMin[i] = numGaussians ? std::numeric_limits<float>::max() : 0.0f;
+        header.aabbMax[i] = numGaussians ? -std::numeric_limits<float>::max() : 0.0f;
+    }
+    ForEachPosWithAlpha([&header](const float* pos)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            header.aabbMin[i] = std::min(header.aabbMin[i], pos[i]);
+            header.aabbMax[i] = std::max(header.aabbMax[i], pos[i]);
+        }
     });
 
-    ply.Dump(plyFile);
+    // write to a temporary file and rename it, so a crash never leaves a truncated cache behind
+    const std::string tempFilename = cacheFilename + ".tmp";
+    {
+        std::ofstream cacheFile(tempFilename, std::ios::binary);
+        if (!cacheFile.is_open())
+        {
+            spdlog::error("failed to open {}\n", tempFilename);
+            return false;
+        }
+        cacheFile.write((const char*)&header, sizeof(header));
+        cacheFile.write((const char*)GetRawDataPtr(), GetTotalSize());
+        if (!cacheFile.good())
+        {
+            spdlog::error("failed to write {}\n", tempFilename);
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempFilename, cacheFilename, ec);
+    if (ec)
+    {
+        spdlog::error("failed to rename {} to {}: {}\n", tempFilename, cacheFilename, ec.message());
+        return false;
+    }
 
+    spdlog::info("Wrote cache \"{}\"", cacheFilename);
+    return true;
+}
+
+std::string GaussianCloud::GetCacheFilename(const std::string& plyFilename)
+{
+    return std::filesystem::path(plyFilename).replace_extension(".gscache").string();
+}
+
+bool GaussianCloud::ImportCompressed(const std::string& filename)
+{
+    ZoneScopedNC("GC::ImportCompressed", tracy::Color::Red4);
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    if (!file.is_open())
+    {
+        spdlog::error("failed to open {}\n", filename);
+        return false;
+    }
+    std::vector<uint8_t> fileData((size_t)file.tellg());
+    file.seekg(0);
+    if (!file.read((char*)fileData.data(), fileData.size()))
+    {
+        spdlog::error("failed to read {}\n", filename);
+        return false;
+    }
+
+    CompressedHeader header;
+    if (fileData.size() < sizeof(header))
+    {
+        spdlog::error("Invalid compressed file \"{}\"", filename);
+        return false;
+    }
+    memcpy(&header, fileData.data(), sizeof(header));
+    if (memcmp(header.magic, COMPRESSED_MAGIC, sizeof(header.magic)) != 0 || header.version != COMPRESSED_VERSION ||
+        (header.numSHCoeffs != 1 && header.numSHCoeffs != COMPRESSED_MAX_SH_COEFFS) ||
+        header.chunkSize == 0 || header.chunkSize > COMPRESSED_CHUNK_SIZE)
+    {
+        spdlog::error("Invalid compressed file \"{}\", unknown format or version", filename);
+        return false;
+    }
+
+    const int numSHCoeffs = (int)header.numSHCoeffs;
+    const size_t chunkSize = header.chunkSize;
+    const size_t numChunks = (header.numGaussians + chunkSize - 1) / chunkSize;
+    const size_t chunkBytes = GetCompressedChunkSize(chunkSize, numSHCoeffs);
+    const size_t lastChunkCount = header.numGaussians - (numChunks ? (numChunks - 1) * chunkSize : 0);
+    const size_t expectedSize = sizeof(header) + (numChunks ? (numChunks - 1) * chunkBytes + GetCompressedChunkSize(lastChunkCount, numSHCoeffs) : 0);
+    if (fileData.size() != expectedSize)
+    {
+        spdlog::error("Invalid compressed file \"{}\", expected {} bytes", filename, expectedSize);
+        return false;
+    }
+
+    // a previous progressive load may still be writing into data
+    cancelLoad = true;
+    WaitForLoad();
+    cancelLoad = false;
+
+    numGaussians = header.numGaussians;
+    hasFullSH = opt.importFullSH && numSHCoeffs == COMPRESSED_MAX_SH_COEFFS;
+    gaussianSize = hasFullSH ? sizeof(FullGaussianData) : sizeof(BaseGaussianData);
+    AllocData();
+    rotScaleData.clear();
+    if (opt.keepRotScale)
+    {
+        rotScaleData.resize(numGaussians * ROT_SCALE_FLOATS);
+    }
+    InitAttribs();
+
+    const int numSHCoeffsOut = hasFullSH ? COMPRESSED_MAX_SH_COEFFS : 1;
+    auto decodeChunks = [this, &fileData, numSHCoeffs, numSHCoeffsOut, chunkSize, chunkBytes](size_t chunkBegin, size_t chunkEnd)
+    {
+        std::unique_ptr<CompressedChunkScratch> scratch(new CompressedChunkScratch);
+        std::unique_ptr<SplatStaging> staging(new SplatStaging);
+        std::vector<uint8_t> recordScratch(opt.planarLayout ? SPLAT_BATCH_SIZE * gaussianSize : 0);
+        const SplatChunk& chunk = scratch->chunk;
+        for (size_t c = chunkBegin; c < chunkEnd; c++)
+        {
+            const size_t begin = c * chunkSize;
+            const size_t count = std::min(chunkSize, numGaussians - begin);
+            DecodeSplatChunk(fileData.data() + sizeof(CompressedHeader) + c * chunkBytes, count, numSHCoeffs, numSHCoeffsOut, chunk);
+
+            for (size_t batchBegin = 0; batchBegin < count; batchBegin += SPLAT_BATCH_SIZE)
+            {
+                size_t batchCount = std::min(SPLAT_BATCH_SIZE, count - batchBegin);
+                uint8_t* batchPtr = GetRecordsForWrite(begin + batchBegin, recordScratch.data());
+                uint8_t* gData = batchPtr;
+                for (size_t i = 0; i < batchCount; i++)
+                {
+                    const size_t s = batchBegin + i;
+                    BaseGaussianData* basePtr = reinterpret_cast<BaseGaussianData*>(gData);
+                    basePtr->posWithAlpha[0] = chunk.pos[0][s];
+                    basePtr->posWithAlpha[1] = chunk.pos[1][s];
+                    basePtr->posWithAlpha[2] = chunk.pos[2][s];
+                    for (int k = 0; k < 3; k++)
+                    {
+                        float* sh0 = GetSH0(basePtr, k);
+                        for (int j = 0; j < 4; j++)
+                        {
+                            sh0[j] = j < numSHCoeffsOut ? chunk.sh[k][j][s] : 0.0f;
+                        }
+                        if (hasFullSH)
+                        {
+                            float* sh1 = GetSH1(reinterpret_cast<FullGaussianData*>(gData), k);
+                            for (int j = 4; j < COMPRESSED_MAX_SH_COEFFS; j++)
+                            {
+                                sh1[j - 4] = chunk.sh[k][j][s];
+                            }
+                        }
+                    }
+
+                    // alpha is stored directly, it is written over the activated opacity below
+                    const float logScale[3] = { chunk.logScale[0][s], chunk.logScale[1][s], chunk.logScale[2][s] };
+                    const float rot[4] = { chunk.rot[0][s], chunk.rot[1][s], chunk.rot[2][s], chunk.rot[3][s] };
+                    staging->Stage(i, 0.0f, logScale, rot);
+                    gData += gaussianSize;
+                }
+
+                float* rotScalePtr = opt.keepRotScale ? rotScaleData.data() + (begin + batchBegin) * ROT_SCALE_FLOATS : nullptr;
+                staging->Flush(batchCount, batchPtr, gaussianSize, rotScalePtr);
+
+                gData = batchPtr;
+                for (size_t i = 0; i < batchCount; i++)
+                {
+                    reinterpret_cast<BaseGaussianData*>(gData)->posWithAlpha[3] = chunk.alpha[batchBegin + i];
+                    gData += gaussianSize;
+                }
+                StoreRecords(begin + batchBegin, batchCount, batchPtr);
+            }
+        }
+    };
+
+    if (opt.serialImport)
+    {
+        decodeChunks(0, numChunks);
+    }
+    else
+    {
+        ThreadPool::Get().ParallelFor(numChunks, 1, decodeChunks);
+    }
+    numResident.store(numGaussians, std::memory_order_release);
+
+    auto endTime = std::chrono::high_resolution_clock::now();
+    spdlog::info("Imported {} gaussians from \"{}\" in {:.3f} s", numGaussians, filename,
+                 std::chrono::duration<double>(endTime - startTime).count());
+
+    return true;
+}
+
+bool GaussianCloud::ExportCompressed(const std::string& filename) const
+{
+    ZoneScopedNC("GC::ExportCompressed", tracy::Color::Red4);
+
+    const int numSHCoeffs = (hasFullSH && opt.exportFullSH) ? COMPRESSED_MAX_SH_COEFFS : 1;
+    const size_t chunkSize = COMPRESSED_CHUNK_SIZE;
+    const size_t numChunks = (numGaussians + chunkSize - 1) / chunkSize;
+    const size_t chunkBytes = GetCompressedChunkSize(chunkSize, numSHCoeffs);
+    const size_t lastChunkCount = numGaussians - (numChunks ? (numChunks - 1) * chunkSize : 0);
+    const size_t fileSize = sizeof(CompressedHeader) + (numChunks ? (numChunks - 1) * chunkBytes + GetCompressedChunkSize(lastChunkCount, numSHCoeffs) : 0);
+
+    std::vector<uint8_t> fileData(fileSize);
+    CompressedHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, COMPRESSED_MAGIC, sizeof(header.magic));
+    header.version = COMPRESSED_VERSION;
+    header.numSHCoeffs = (uint32_t)numSHCoeffs;
+    header.numGaussians = numGaussians;
+    header.chunkSize = (uint32_t)chunkSize;
+    memcpy(fileData.data(), &header, sizeof(header));
+
+    // rot and scale kept from import are used as is, which skips the eigen decomposition.
+    const bool useImportedRotScale = rotScaleData.size() == numGaussians * ROT_SCALE_FLOATS;
+
+    auto encodeChunks = [this, &fileData, numSHCoeffs, chunkSize, chunkBytes, useImportedRotScale](size_t chunkBegin, size_t chunkEnd)
+    {
+        std::unique_ptr<CompressedChunkScratch> scratch(new CompressedChunkScratch);
+        std::unique_ptr<SplatStaging> staging(new SplatStaging);
+        std::vector<uint8_t> recordScratch(opt.planarLayout ? SPLAT_BATCH_SIZE * gaussianSize : 0);
+        const SplatChunk& chunk = scratch->chunk;
+        for (size_t c = chunkBegin; c < chunkEnd; c++)
+        {
+            const size_t begin = c * chunkSize;
+            const size_t count = std::min(chunkSize, numGaussians - begin);
+            for (size_t batchBegin = 0; batchBegin < count; batchBegin += SPLAT_BATCH_SIZE)
+            {
+                size_t batchCount = std::min(SPLAT_BATCH_SIZE, count - batchBegin);
+                const uint8_t* gData = GetRecordsForRead(begin + batchBegin, batchCount, recordScratch.data());
+                if (!useImportedRotScale)
+                {
+                    staging->Deactivate(batchCount, gData, gaussianSize);
+                }
+
+                for (size_t i = 0; i < batchCount; i++)
+                {
+                    const size_t s = batchBegin + i;
+                    const BaseGaussianData* basePtr = reinterpret_cast<const BaseGaussianData*>(gData);
+                    chunk.pos[0][s] = basePtr->posWithAlpha[0];
+                    chunk.pos[1][s] = basePtr->posWithAlpha[1];
+                    chunk.pos[2][s] = basePtr->posWithAlpha[2];
+                    chunk.alpha[s] = basePtr->posWithAlpha[3];
+                    for (int k = 0; k < 3; k++)
+                    {
+                        chunk.sh[k][0][s] = GetSH0(basePtr, k)[0];
+                        if (numSHCoeffs > 1)
+                        {
+                            const float* sh0 = GetSH0(basePtr, k);
+                            const float* sh1 = GetSH1(reinterpret_cast<const FullGaussianData*>(gData), k);
+                            for (int j = 1; j < 4; j++)
+                            {
+                                chunk.sh[k][j][s] = sh0[j];
+                            }
+                            for (int j = 4; j < COMPRESSED_MAX_SH_COEFFS; j++)
+                            {
+                                chunk.sh[k][j][s] = sh1[j - 4];
+                            }
+                        }
+                    }
+
+                    if (useImportedRotScale)
+                    {
+                        const float* rotScale = rotScaleData.data() + (begin + s) * ROT_SCALE_FLOATS;
+                        for (int k = 0; k < 4; k++)
+                        {
+                            chunk.rot[k][s] = rotScale[k];
+                        }
+                        for (int k = 0; k < 3; k++)
+                        {
+                            chunk.logScale[k][s] = rotScale[4 + k];
+                        }
+                    }
+                    else
+                    {
+                        for (int k = 0; k < 4; k++)
+                        {
+                            chunk.rot[k][s] = staging->rot[k][i];
+                        }
+                        for (int k = 0; k < 3; k++)
+                        {
+                            chunk.logScale[k][s] = staging->logScale[k][i];
+                        }
+                    }
+                    gData += gaussianSize;
+                }
+            }
+
+            EncodeSplatChunk(chunk, count, numSHCoeffs, fileData.data() + sizeof(CompressedHeader) + c * chunkBytes);
+        }
+    };
+    ThreadPool::Get().ParallelFor(numChunks, 1, encodeChunks);
+
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open())
+    {
+        spdlog::error("failed to open {}\n", filename);
+        return false;
+    }
+    file.write((const char*)fileData.data(), fileData.size());
+    if (!file.good())
+    {
+        spdlog::error("failed to write {}\n", filename);
+        return false;
+    }
+
+    spdlog::info("Wrote {} gaussians to \"{}\", {:.1f} bytes per gaussian", numGaussians, filename,
+                 numGaussians ? (double)fileSize / numGaussians : 0.0);
     return true;
 }
 
@@ -506,11 +1495,18 @@ void GaussianCloud::InitDebugCloud()
 {
     const int NUM_SPLATS = 5;
 
+    cancelLoad = true;
+    WaitForLoad();
+
     numGaussians = NUM_SPLATS * 3 + 1;
+    numResident = numGaussians;
+    rotScaleData.clear();
+    hasFullSH = true;
     gaussianSize = sizeof(FullGaussianData);
+    AllocData();
     InitAttribs();
-    FullGaussianData* gd = new FullGaussianData[numGaussians];
-    data.reset(gd);
+    std::vector<FullGaussianData> recordScratch(opt.planarLayout ? numGaussians : 0);
+    FullGaussianData* gd = reinterpret_cast<FullGaussianData*>(GetRecordsForWrite(0, (uint8_t*)recordScratch.data()));
 
     //
     // make an debug GaussianClound, that contain red, green and blue axes.
@@ -575,11 +1571,15 @@ void GaussianCloud::InitDebugCloud()
     g.r_sh0[0] = SH_ONE; g.g_sh0[0] = SH_ONE; g.b_sh0[0] = SH_ONE;
     g.cov3_col0[0] = COV_DIAG; g.cov3_col1[1] = COV_DIAG; g.cov3_col2[2] = COV_DIAG;
     gd[(NUM_SPLATS * 3)] = g;
+
+    StoreRecords(0, numGaussians, (const uint8_t*)gd);
 }
 
 // only keep the nearest splats
 void GaussianCloud::PruneSplats(const glm::vec3& origin, uint32_t numSplats)
 {
+    WaitForLoad();
+
     if (!data || static_cast<size_t>(numSplats) >= numGaussians)
     {
         return;
@@ -588,46 +1588,82 @@ void GaussianCloud::PruneSplats(const glm::vec3& origin, uint32_t numSplats)
     using IndexDistPair = std::pair<uint32_t, float>;
     std::vector<IndexDistPair> indexDistVec;
     indexDistVec.reserve(numGaussians);
-    uint8_t* rawPtr = (uint8_t*)data.get();
-    for (uint32_t i = 0; i < numGaussians; i++)
+    ForEachPosWithAlpha([&indexDistVec, &origin](const float* posWithAlpha)
     {
-        BaseGaussianData* basePtr = reinterpret_cast<BaseGaussianData*>(rawPtr);
-        glm::vec3 pos(basePtr->posWithAlpha[0], basePtr->posWithAlpha[1], basePtr->posWithAlpha[2]);
-        indexDistVec.push_back(IndexDistPair(i, glm::distance(origin, pos)));
-        rawPtr += gaussianSize;
-    }
+        glm::vec3 pos(posWithAlpha[0], posWithAlpha[1], posWithAlpha[2]);
+        indexDistVec.push_back(IndexDistPair((uint32_t)indexDistVec.size(), glm::distance(origin, pos)));
+    });
 
     std::sort(indexDistVec.begin(), indexDistVec.end(), [](const IndexDistPair& a, const IndexDistPair& b)
     {
         return a.second < b.second;
     });
 
-    uint8_t* newData;
-    if (hasFullSH)
-    {
-        FullGaussianData* fullPtr = new FullGaussianData[numSplats];
-        newData = (uint8_t*)fullPtr;
-    }
-    else
+    // the planar streams are laid out by numGaussians, so the kept splats are copied record by record into new storage
+    std::shared_ptr<void> oldData = data;
+    const size_t oldNumGaussians = numGaussians;
+    numGaussians = numSplats;
+    AllocData();
+    InitAttribs();
+
+    std::vector<uint8_t> recordScratch(opt.planarLayout ? gaussianSize : 0);
+    for (uint32_t i = 0; i < numSplats; i++)
     {
-        BaseGaussianData* basePtr = new BaseGaussianData[numSplats];
-        newData = (uint8_t*)basePtr;
+        const size_t index = indexDistVec[i].first;
+        uint8_t* record = GetRecordsForWrite(i, recordScratch.data());
+        if (opt.planarLayout)
+        {
+            GatherFromPlanar((const uint8_t*)oldData.get(), oldNumGaussians, hasFullSH, index, 1, record);
+        }
+        else
+        {
+            memcpy(record, (const uint8_t*)oldData.get() + index * gaussianSize, gaussianSize);
+        }
+        StoreRecords(i, 1, record);
     }
-    rawPtr = (uint8_t*)data.get();
-    uint8_t* rawPtr2 = newData;
 
-    for (uint32_t i = 0; i < numSplats; i++)
+    if (!rotScaleData.empty())
     {
-        memcpy(rawPtr2, rawPtr + indexDistVec[i].first * gaussianSize, gaussianSize);
-        rawPtr2 += gaussianSize;
+        std::vector<float> newRotScaleData(numSplats * ROT_SCALE_FLOATS);
+        for (uint32_t i = 0; i < numSplats; i++)
+        {
+            memcpy(&newRotScaleData[i * ROT_SCALE_FLOATS], &rotScaleData[indexDistVec[i].first * ROT_SCALE_FLOATS], ROT_SCALE_FLOATS * sizeof(float));
+        }
+        rotScaleData.swap(newRotScaleData);
     }
-    numGaussians = numSplats;
-    data.reset(newData);
+
+    numResident = numGaussians;
 }
 
 void GaussianCloud::ForEachPosWithAlpha(const ForEachPosWithAlphaCallback& cb) const
 {
-    posWithAlphaAttrib.ForEach<float>(GetRawDataPtr(), GetStride(), GetNumGaussians(), cb);
+    posWithAlphaAttrib.ForEach<float>(GetRawDataPtr(), posWithAlphaStride, GetNumGaussians(), cb);
+}
+
+void GaussianCloud::ForEachPosWithAlphaInRange(size_t begin, size_t end, const ForEachPosWithAlphaCallback& cb) const
+{
+    assert(begin <= end && end <= GetNumGaussians());
+    const uint8_t* rawPtr = (const uint8_t*)GetRawDataPtr() + begin * posWithAlphaStride;
+    posWithAlphaAttrib.ForEach<float>(rawPtr, posWithAlphaStride, end - begin, cb);
+}
+
+void GaussianCloud::ForEachDataRange(size_t begin, size_t end, const DataRangeCallback& cb) const
+{
+    assert(begin <= end && end <= GetNumGaussians());
+    if (!opt.planarLayout)
+    {
+        cb(begin * gaussianSize, (end - begin) * gaussianSize);
+        return;
+    }
+
+    GaussianStream streams[MAX_GAUSSIAN_STREAMS];
+    const int numStreams = GetGaussianStreams(hasFullSH, streams);
+    size_t streamOffset = 0;
+    for (int k = 0; k < numStreams; k++)
+    {
+        cb(streamOffset + begin * streams[k].size, (end - begin) * streams[k].size);
+        streamOffset += numGaussians * streams[k].size;
+    }
 }
 
 void GaussianCloud::InitAttribs()
@@ -654,4 +1690,89 @@ void GaussianCloud::InitAttribs()
         b_sh2Attrib = {BinaryAttribute::Type::Float, offsetof(FullGaussianData, b_sh2)};
         b_sh3Attrib = {BinaryAttribute::Type::Float, offsetof(FullGaussianData, b_sh3)};
     }
+
+    posWithAlphaStride = gaussianSize;
+    sh0Stride = gaussianSize;
+    shRestStride = gaussianSize;
+    cov3Stride = gaussianSize;
+    if (!opt.planarLayout)
+    {
+        return;
+    }
+
+    // rebase each attrib from its offset within the record to the start of its stream in data
+    GaussianStream streams[MAX_GAUSSIAN_STREAMS];
+    const int numStreams = GetGaussianStreams(hasFullSH, streams);
+    size_t streamOffsets[MAX_GAUSSIAN_STREAMS];
+    size_t streamOffset = 0;
+    for (int k = 0; k < numStreams; k++)
+    {
+        streamOffsets[k] = streamOffset;
+        streamOffset += numGaussians * streams[k].size;
+    }
+    auto rebase = [&streams, &streamOffsets](BinaryAttribute& attrib, int k)
+    {
+        attrib.offset = streamOffsets[k] + attrib.offset - streams[k].recordOffset;
+    };
+
+    rebase(posWithAlphaAttrib, 0);
+    rebase(r_sh0Attrib, 1);
+    rebase(g_sh0Attrib, 1);
+    rebase(b_sh0Attrib, 1);
+    rebase(cov3_col0Attrib, 2);
+    rebase(cov3_col1Attrib, 2);
+    rebase(cov3_col2Attrib, 2);
+    posWithAlphaStride = streams[0].size;
+    sh0Stride = streams[1].size;
+    cov3Stride = streams[2].size;
+
+    if (hasFullSH)
+    {
+        rebase(r_sh1Attrib, 3);
+        rebase(r_sh2Attrib, 3);
+        rebase(r_sh3Attrib, 3);
+        rebase(g_sh1Attrib, 3);
+        rebase(g_sh2Attrib, 3);
+        rebase(g_sh3Attrib, 3);
+        rebase(b_sh1Attrib, 3);
+        rebase(b_sh2Attrib, 3);
+        rebase(b_sh3Attrib, 3);
+        shRestStride = streams[3].size;
+    }
+}
+
+void GaussianCloud::AllocData()
+{
+    // the planar streams add up to the same size as the records
+    if (hasFullSH)
+    {
+        data.reset(new FullGaussianData[numGaussians]);
+    }
+    else
+    {
+        data.reset(new BaseGaussianData[numGaussians]);
+    }
+}
+
+uint8_t* GaussianCloud::GetRecordsForWrite(size_t begin, uint8_t* scratch)
+{
+    return opt.planarLayout ? scratch : (uint8_t*)data.get() + begin * gaussianSize;
+}
+
+void GaussianCloud::StoreRecords(size_t begin, size_t count, const uint8_t* records)
+{
+    if (opt.planarLayout)
+    {
+        ScatterToPlanar((uint8_t*)data.get(), numGaussians, hasFullSH, begin, count, records);
+    }
+}
+
+const uint8_t* GaussianCloud::GetRecordsForRead(size_t begin, size_t count, uint8_t* scratch) const
+{
+    if (opt.planarLayout)
+    {
+        GatherFromPlanar((const uint8_t*)data.get(), numGaussians, hasFullSH, begin, count, scratch);
+        return scratch;
+    }
+    return (const uint8_t*)data.get() + begin * gaussianSize;
 }
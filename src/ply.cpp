@@ -10,6 +10,13 @@
 
 #include <spdlog/spdlog.h>
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include <ply.h>
 
 #ifdef TRACY_ENABLE
@@ -64,11 +71,16 @@ static const char* BinaryAttributeTypeToString(BinaryAttribute::Type type)
     };
 }
 
-Ply::Ply() : vertexCount(0), vertexSize(0)
+Ply::Ply() : mappedBase(nullptr), mappedSize(0), mappedData(nullptr), vertexCount(0), vertexSize(0)
 {
     ;
 }
 
+Ply::~Ply()
+{
+    UnmapData();
+}
+
 bool Ply::Parse(std::ifstream& plyFile)
 {
     if (!ParseHeader(plyFile))
@@ -77,19 +89,60 @@ bool Ply::Parse(std::ifstream& plyFile)
     }
 
     // read rest of file into data ptr
+    ZoneScopedNC("Ply::Parse() read data", tracy::Color::Yellow);
+    return ReadData(plyFile);
+}
+
+bool Ply::ParseMapped(const std::string& plyFilename)
+{
+    std::ifstream plyFile(plyFilename, std::ios::binary);
+    if (!plyFile.is_open())
     {
-        ZoneScopedNC("Ply::Parse() read data", tracy::Color::Yellow);
-        AllocData(vertexCount);
-        plyFile.read((char*)data.get(), vertexSize * vertexCount);
+        spdlog::error("failed to open {}\n", plyFilename);
+        return false;
     }
 
+    if (!ParseHeader(plyFile))
+    {
+        return false;
+    }
+
+    {
+        ZoneScopedNC("Ply::ParseMapped() map data", tracy::Color::Yellow);
+        MapResult result = MapData(plyFilename, (size_t)plyFile.tellg());
+        if (result == MapResult::Mapped)
+        {
+            return true;
+        }
+        else if (result == MapResult::Truncated)
+        {
+            return false;
+        }
+    }
+
+    // mmap is not available, read rest of file into data ptr
+    ZoneScopedNC("Ply::ParseMapped() read data", tracy::Color::Yellow);
+    spdlog::debug("Could not map \"{}\", reading it instead", plyFilename);
+    return ReadData(plyFile);
+}
+
+bool Ply::ReadData(std::ifstream& plyFile)
+{
+    AllocData(vertexCount);
+    const size_t dataSize = vertexSize * vertexCount;
+    plyFile.read((char*)data.get(), dataSize);
+    if ((size_t)plyFile.gcount() != dataSize)
+    {
+        spdlog::error("Invalid ply file, expected {} bytes of vertex data, got {}", dataSize, (size_t)plyFile.gcount());
+        return false;
+    }
     return true;
 }
 
 void Ply::Dump(std::ofstream& plyFile) const
 {
     DumpHeader(plyFile);
-    plyFile.write((char*)data.get(), vertexSize * vertexCount);
+    plyFile.write((const char*)GetData(), vertexSize * vertexCount);
 }
 
 bool Ply::GetProperty(const std::string& key, BinaryAttribute& binaryAttributeOut) const
@@ -113,14 +166,21 @@ void Ply::AddProperty(const std::string& key, BinaryAttribute::Type type)
 
 void Ply::AllocData(size_t numVertices)
 {
+    UnmapData();
     vertexCount = numVertices;
     data.reset(new uint8_t[vertexSize * numVertices]);
 }
 
 void Ply::ForEachVertex(const VertexCallback& cb) const
 {
-    const uint8_t* ptr = data.get();
-    for (size_t i = 0; i < vertexCount; i++)
+    ForEachVertexInRange(0, vertexCount, cb);
+}
+
+void Ply::ForEachVertexInRange(size_t begin, size_t end, const VertexCallback& cb) const
+{
+    assert(begin <= end && end <= vertexCount);
+    const uint8_t* ptr = GetData() + begin * vertexSize;
+    for (size_t i = begin; i < end; i++)
     {
         cb(ptr, vertexSize);
         ptr += vertexSize;
@@ -129,6 +189,7 @@ void Ply::ForEachVertex(const VertexCallback& cb) const
 
 void Ply::ForEachVertexMut(const VertexCallbackMut& cb)
 {
+    assert(!mappedData);  // mapped data is read-only
     uint8_t* ptr = data.get();
     for (size_t i = 0; i < vertexCount; i++)
     {
@@ -279,3 +340,62 @@ void Ply::DumpHeader(std::ofstream& plyFile) const
     }
     plyFile << "end_header\n";
 }
+
+Ply::MapResult Ply::MapData(const std::string& plyFilename, size_t dataOffset)
+{
+#ifdef _WIN32
+    return MapResult::Unavailable;
+#else
+    int fd = open(plyFilename.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return MapResult::Unavailable;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return MapResult::Unavailable;
+    }
+
+    const size_t fileSize = (size_t)st.st_size;
+    if (fileSize < dataOffset + vertexSize * vertexCount)
+    {
+        spdlog::error("Invalid ply file, expected {} bytes of vertex data, got {}", vertexSize * vertexCount, fileSize - dataOffset);
+        close(fd);
+        return MapResult::Truncated;
+    }
+
+    void* ptr = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  // the mapping holds its own reference to the file
+    if (ptr == MAP_FAILED)
+    {
+        return MapResult::Unavailable;
+    }
+
+    // vertices are visited front to back, so let the kernel read ahead aggressively
+    // and reclaim pages behind us.
+    madvise(ptr, fileSize, MADV_SEQUENTIAL);
+
+    mappedBase = ptr;
+    mappedSize = fileSize;
+    mappedData = static_cast<const uint8_t*>(ptr) + dataOffset;
+    data.reset();
+
+    return MapResult::Mapped;
+#endif
+}
+
+void Ply::UnmapData()
+{
+#ifndef _WIN32
+    if (mappedBase)
+    {
+        munmap(mappedBase, mappedSize);
+    }
+#endif
+    mappedBase = nullptr;
+    mappedSize = 0;
+    mappedData = nullptr;
+}
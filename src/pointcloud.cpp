@@ -33,15 +33,8 @@ PointCloud::PointCloud(bool useLinearColorsIn) :
 
 bool PointCloud::ImportPly(const std::string& plyFilename)
 {
-    std::ifstream plyFile(plyFilename, std::ios::binary);
-    if (!plyFile.is_open())
-    {
-        spdlog::error("failed to open \"{}\"\n", plyFilename.c_str());
-        return false;
-    }
-
     Ply ply;
-    if (!ply.Parse(plyFile))
+    if (!ply.ParseMapped(plyFilename))
     {
         spdlog::error("Error parsing ply file \"{}\"\n", plyFilename.c_str());
         return false;
@@ -343,6 +343,23 @@ int Program::GetAttribLoc(const std::string& name) const
     }
 }
 
+bool Program::HasSameAttribs(const Program& other) const
+{
+    if (attribs.size() != other.attribs.size())
+    {
+        return false;
+    }
+    for (auto&& iter : attribs)
+    {
+        auto otherIter = other.attribs.find(iter.first);
+        if (otherIter == other.attribs.end() || otherIter->second.loc != iter.second.loc)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
 void Program::SetUniformRaw(int loc, uint32_t value) const
 {
     glUniform1ui(loc, value);
@@ -363,6 +380,11 @@ void Program::SetUniformRaw(int loc, const glm::vec2& value) const
     glUniform2fv(loc, 1, (float*)&value);
 }
 
+void Program::SetUniformRaw(int loc, const glm::uvec2& value) const
+{
+    glUniform2uiv(loc, 1, (uint32_t*)&value);
+}
+
 void Program::SetUniformRaw(int loc, const glm::vec3& value) const
 {
     glUniform3fv(loc, 1, (float*)&value);
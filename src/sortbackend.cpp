@@ -0,0 +1,531 @@
+#include <sortbackend.h>
+
+#include <Utils/Platform.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#ifdef TRACY_ENABLE
+#include <tracy/Tracy.hpp>
+#else
+#define ZoneScoped
+#define ZoneScopedNC(NAME, COLOR)
+#endif
+
+#include <cpusort.h>
+#include <program.h>
+#include <util.h>
+
+#include <radix_sort.hpp>
+
+#ifndef GL_SUBGROUP_SIZE_KHR
+#define GL_SUBGROUP_SIZE_KHR 0x9532
+#endif
+
+static const uint32_t RADIX_SORT_BINS = 256;
+static const uint32_t MAX_RADIX_PASSES = 4;
+
+// the number of warmup and timed sorts per Autotune() candidate
+static const int AUTOTUNE_WARMUP_RUNS = 1;
+static const int AUTOTUNE_TIMED_RUNS = 5;
+
+// offset of the DispatchIndirectCommand in the sort args, after the DrawElementsIndirectCommand
+static const intptr_t AUTOTUNE_DISPATCH_OFFSET = 5 * sizeof(uint32_t);
+
+static uint32_t GetSubgroupSize()
+{
+    GLint numExtensions = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+    for (GLint i = 0; i < numExtensions; i++)
+    {
+        const char* ext = (const char*)glGetStringi(GL_EXTENSIONS, i);
+        if (ext && strcmp(ext, "GL_KHR_shader_subgroup") == 0)
+        {
+            GLint subgroupSize = 0;
+            glGetIntegerv(GL_SUBGROUP_SIZE_KHR, &subgroupSize);
+            if (subgroupSize > 0)
+            {
+                return (uint32_t)subgroupSize;
+            }
+        }
+    }
+
+    // without the query fall back to the NVIDIA size multi_radixsort.glsl was written for
+    return 32;
+}
+
+static void BindPingPongBuffers(uint32_t pass, std::shared_ptr<BufferObject> keyBuffer, std::shared_ptr<BufferObject> keyBuffer2,
+                                std::shared_ptr<BufferObject> valBuffer, std::shared_ptr<BufferObject> valBuffer2)
+{
+    if ((pass % 2) == 0)  // even
+    {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, keyBuffer->GetObj());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, keyBuffer2->GetObj());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, valBuffer->GetObj());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, valBuffer2->GetObj());
+    }
+    else  // odd
+    {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, keyBuffer2->GetObj());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, keyBuffer->GetObj());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, valBuffer2->GetObj());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, valBuffer->GetObj());
+    }
+}
+
+class MultiRadixSortBackend : public SortBackend
+{
+public:
+    explicit MultiRadixSortBackend(const Params& paramsIn) : SortBackend(paramsIn) {}
+
+    bool Init(size_t maxElements) override
+    {
+        // the subgroup reductions of multi_radixsort.glsl depend on the hardware subgroup size, 32 on NVIDIA and 64 on AMD
+        const uint32_t subgroupSize = GetSubgroupSize();
+        sortProg = std::make_shared<Program>();
+        sortProg->AddMacro("DEFINES", "#define SUBGROUP_SIZE " + std::to_string(subgroupSize) + "\n");
+        if (!sortProg->LoadCompute("shaders_gs/multi_radixsort.glsl"))
+        {
+            spdlog::error("Error loading sort compute shader!");
+            return false;
+        }
+
+        histogramProg = std::make_shared<Program>();
+        if (!histogramProg->LoadCompute("shaders_gs/multi_radixsort_histograms.glsl"))
+        {
+            spdlog::error("Error loading histogram compute shader!");
+            return false;
+        }
+
+        CreateBuffers(maxElements, true);
+
+        // one histogram per sort workgroup, the sort args dispatch the same count
+        const uint32_t keysPerWorkgroup = GetKeysPerWorkgroup();
+        const uint32_t numWorkgroups = std::max((uint32_t)((maxElements + keysPerWorkgroup - 1) / keysPerWorkgroup), 1u);
+        std::vector<uint32_t> histogramVec(numWorkgroups * RADIX_SORT_BINS, 0);
+        histogramBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, histogramVec, GL_DYNAMIC_STORAGE_BIT);
+
+        return true;
+    }
+
+    void Sort(std::shared_ptr<BufferObject> sortArgsBuffer, intptr_t dispatchOffset,
+              uint32_t numBytes, uint32_t numPoints) override
+    {
+        sortProg->Bind();
+        sortProg->SetUniform("g_num_blocks_per_workgroup", params.blocksPerWorkgroup);
+
+        histogramProg->Bind();
+        histogramProg->SetUniform("g_num_blocks_per_workgroup", params.blocksPerWorkgroup);
+
+        // both passes read the element and workgroup counts from the sort args
+        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, sortArgsBuffer->GetObj());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, sortArgsBuffer->GetObj());
+
+        for (uint32_t i = 0; i < numBytes; i++)
+        {
+            histogramProg->Bind();
+            histogramProg->SetUniform("g_shift", 8 * i);
+
+            if (i == 0 || i == 2)
+            {
+                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, keyBuffer->GetObj());
+            }
+            else
+            {
+                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, keyBuffer2->GetObj());
+            }
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, histogramBuffer->GetObj());
+
+            glDispatchComputeIndirect(dispatchOffset);
+
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+            sortProg->Bind();
+            sortProg->SetUniform("g_shift", 8 * i);
+
+            BindPingPongBuffers(i, keyBuffer, keyBuffer2, valBuffer, valBuffer2);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, histogramBuffer->GetObj());
+
+            glDispatchComputeIndirect(dispatchOffset);
+
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        }
+
+        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+
+        // an odd number of passes leaves the result in the second buffers
+        sortedKeyBuffer = (numBytes % 2) ? keyBuffer2 : keyBuffer;
+        sortedValBuffer = (numBytes % 2) ? valBuffer2 : valBuffer;
+
+        GL_ERROR_CHECK("MultiRadixSortBackend::Sort()");
+    }
+
+protected:
+    std::shared_ptr<Program> sortProg;
+    std::shared_ptr<Program> histogramProg;
+    std::shared_ptr<BufferObject> histogramBuffer;
+};
+
+class OnesweepSortBackend : public SortBackend
+{
+public:
+    explicit OnesweepSortBackend(const Params& paramsIn) : SortBackend(paramsIn) {}
+
+    bool Init(size_t maxElements) override
+    {
+        // a tile is one workgroup of blocksPerWorkgroup blocks, its keys are kept in registers
+        const std::string defines = "#define BLOCKS_PER_TILE " + std::to_string(params.blocksPerWorkgroup) + "u\n";
+
+        histogramProg = std::make_shared<Program>();
+        histogramProg->AddMacro("DEFINES", defines);
+        if (!histogramProg->LoadCompute("shaders_gs/onesweep_histograms.glsl"))
+        {
+            spdlog::error("Error loading onesweep histogram compute shader!");
+            return false;
+        }
+
+        scatterProg = std::make_shared<Program>();
+        scatterProg->AddMacro("DEFINES", defines);
+        if (!scatterProg->LoadCompute("shaders_gs/onesweep_scatter.glsl"))
+        {
+            spdlog::error("Error loading onesweep scatter compute shader!");
+            return false;
+        }
+
+        CreateBuffers(maxElements, true);
+
+        // the digit counts and tile counters are reset before every sort, the tile status is
+        // cleared on the gpu by onesweep_histograms.glsl.
+        const uint32_t tileSize = GetKeysPerWorkgroup();
+        maxTiles = std::max((uint32_t)((maxElements + tileSize - 1) / tileSize), 1u);
+        digitCountVec.resize(MAX_RADIX_PASSES * RADIX_SORT_BINS + MAX_RADIX_PASSES, 0);
+        digitCountBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, digitCountVec, GL_DYNAMIC_STORAGE_BIT);
+        const size_t tileStatusSize = (size_t)MAX_RADIX_PASSES * maxTiles * RADIX_SORT_BINS * sizeof(uint32_t);
+        tileStatusBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, nullptr, tileStatusSize, GL_DYNAMIC_STORAGE_BIT);
+
+        return true;
+    }
+
+    void Sort(std::shared_ptr<BufferObject> sortArgsBuffer, intptr_t dispatchOffset,
+              uint32_t numBytes, uint32_t numPoints) override
+    {
+        digitCountBuffer->Update(digitCountVec);
+
+        // both passes run one workgroup per tile, the count comes from the sort args
+        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, sortArgsBuffer->GetObj());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, sortArgsBuffer->GetObj());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, tileStatusBuffer->GetObj());
+
+        // the digit counts of all passes in one read of the keys
+        histogramProg->Bind();
+        histogramProg->SetUniform("g_num_passes", numBytes);
+        histogramProg->SetUniform("g_max_tiles", maxTiles);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, keyBuffer->GetObj());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, digitCountBuffer->GetObj());
+        glDispatchComputeIndirect(dispatchOffset);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        scatterProg->Bind();
+        scatterProg->SetUniform("g_max_tiles", maxTiles);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, digitCountBuffer->GetObj());
+        for (uint32_t i = 0; i < numBytes; i++)
+        {
+            scatterProg->SetUniform("g_pass", i);
+            BindPingPongBuffers(i, keyBuffer, keyBuffer2, valBuffer, valBuffer2);
+
+            glDispatchComputeIndirect(dispatchOffset);
+
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        }
+
+        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+
+        // an odd number of passes leaves the result in the second buffers
+        sortedKeyBuffer = (numBytes % 2) ? keyBuffer2 : keyBuffer;
+        sortedValBuffer = (numBytes % 2) ? valBuffer2 : valBuffer;
+
+        GL_ERROR_CHECK("OnesweepSortBackend::Sort()");
+    }
+
+protected:
+    std::shared_ptr<Program> histogramProg;
+    std::shared_ptr<Program> scatterProg;
+    std::vector<uint32_t> digitCountVec;  // always zero
+    std::shared_ptr<BufferObject> digitCountBuffer;  // digit counts of every pass and the tile counters
+    std::shared_ptr<BufferObject> tileStatusBuffer;  // look-back status of every pass, tile and bin
+    uint32_t maxTiles = 0;
+};
+
+class RgcSortBackend : public SortBackend
+{
+public:
+    explicit RgcSortBackend(const Params& paramsIn) : SortBackend(paramsIn) {}
+
+    bool Init(size_t maxElements) override
+    {
+        CreateBuffers(maxElements, false);
+        sorter = std::make_shared<rgc::radix_sort::sorter>(maxElements);
+        return true;
+    }
+
+    void Sort(std::shared_ptr<BufferObject> sortArgsBuffer, intptr_t dispatchOffset,
+              uint32_t numBytes, uint32_t numPoints) override
+    {
+        // always sorts all 32 bits in place
+        sorter->sort(keyBuffer->GetObj(), valBuffer->GetObj(), numPoints);
+        GL_ERROR_CHECK("RgcSortBackend::Sort()");
+    }
+
+    bool NeedsPaddedKeys() const override { return true; }
+
+protected:
+    std::shared_ptr<rgc::radix_sort::sorter> sorter;
+};
+
+class CpuSortBackend : public SortBackend
+{
+public:
+    explicit CpuSortBackend(const Params& paramsIn) : SortBackend(paramsIn) {}
+
+    bool Init(size_t maxElements) override
+    {
+        // only the sorted indices are uploaded, there are no keys on the gpu
+        assert(maxElements <= std::numeric_limits<uint32_t>::max());
+        const size_t sortBufferSize = std::max(maxElements, (size_t)1) * sizeof(uint32_t);
+        valBuffer = std::make_shared<BufferObject>(GL_ELEMENT_ARRAY_BUFFER, nullptr, sortBufferSize, GL_DYNAMIC_STORAGE_BIT);
+        sortedValBuffer = valBuffer;
+        return true;
+    }
+
+    void Sort(std::shared_ptr<BufferObject> sortArgsBuffer, intptr_t dispatchOffset,
+              uint32_t numBytes, uint32_t numPoints) override
+    {
+        // there are no gpu keys to sort, callers sort with GetCpuSorter() and upload the indices to the val buffer.
+        // the val buffer keeps the previous order.
+        if (!loggedSort)
+        {
+            spdlog::error("The {} sort backend has no gpu keys, sort with GetCpuSorter() instead", GetTypeName(params.type));
+            loggedSort = true;
+        }
+    }
+
+    CpuSplatSorter* GetCpuSorter() override { return &sorter; }
+
+protected:
+    CpuSplatSorter sorter;
+    bool loggedSort = false;
+};
+
+std::shared_ptr<SortBackend> SortBackend::Create(const Params& paramsIn)
+{
+    Params params = paramsIn;
+    switch (params.type)
+    {
+    case Type::MultiRadix:
+        params.blocksPerWorkgroup = params.blocksPerWorkgroup ? params.blocksPerWorkgroup : 1024;
+        return std::make_shared<MultiRadixSortBackend>(params);
+    case Type::Onesweep:
+        params.blocksPerWorkgroup = params.blocksPerWorkgroup ? params.blocksPerWorkgroup : 8;
+        return std::make_shared<OnesweepSortBackend>(params);
+    case Type::Rgc:
+        params.blocksPerWorkgroup = 1;  // unused, rgc::radix_sort sizes its own dispatches
+        return std::make_shared<RgcSortBackend>(params);
+    case Type::Cpu:
+        params.blocksPerWorkgroup = 1;  // unused
+        return std::make_shared<CpuSortBackend>(params);
+    default:
+        spdlog::error("Unknown sort backend {}", (int)params.type);
+        return nullptr;
+    }
+}
+
+const char* SortBackend::GetTypeName(Type type)
+{
+    switch (type)
+    {
+    case Type::MultiRadix:
+        return "multi";
+    case Type::Onesweep:
+        return "onesweep";
+    case Type::Rgc:
+        return "rgc";
+    case Type::Cpu:
+        return "cpu";
+    default:
+        return "unknown";
+    }
+}
+
+bool SortBackend::ParseType(const std::string& name, Type* typeOut)
+{
+    for (int i = 0; i < (int)Type::NumTypes; i++)
+    {
+        if (name == GetTypeName((Type)i))
+        {
+            *typeOut = (Type)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string SortBackend::GetDescription() const
+{
+    if (params.type == Type::Rgc)
+    {
+        return GetTypeName(params.type);
+    }
+    if (params.type == Type::Cpu)
+    {
+        return std::string("cpu, ") + CpuSplatSorter::GetISA();
+    }
+    return std::string(GetTypeName(params.type)) + ", " + std::to_string(params.blocksPerWorkgroup) + " blocks per workgroup";
+}
+
+void SortBackend::CreateBuffers(size_t maxElements, bool pingPong)
+{
+    // the key and val buffers are always written on the gpu before they are read, so
+    // they are allocated without uploading any cpu side data.
+    assert(maxElements <= std::numeric_limits<uint32_t>::max());
+    const size_t sortBufferSize = std::max(maxElements, (size_t)1) * sizeof(uint32_t);
+
+    keyBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, nullptr, sortBufferSize, GL_DYNAMIC_STORAGE_BIT);
+    valBuffer = std::make_shared<BufferObject>(GL_ELEMENT_ARRAY_BUFFER, nullptr, sortBufferSize, GL_DYNAMIC_STORAGE_BIT);
+    if (pingPong)
+    {
+        keyBuffer2 = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, nullptr, sortBufferSize, GL_DYNAMIC_STORAGE_BIT);
+        valBuffer2 = std::make_shared<BufferObject>(GL_ELEMENT_ARRAY_BUFFER, nullptr, sortBufferSize, GL_DYNAMIC_STORAGE_BIT);
+    }
+    sortedKeyBuffer = keyBuffer;
+    sortedValBuffer = valBuffer;
+}
+
+SortBackend::Params SortBackend::Autotune(size_t numElements, uint32_t numBytes, const std::string& cacheFilename)
+{
+    ZoneScopedNC("SortBackend::Autotune()", tracy::Color::Blue);
+
+    // the fastest backend depends on the gpu and driver, and on the number of keys rounded up to a power of two
+    const char* rendererStr = (const char*)glGetString(GL_RENDERER);
+    const char* versionStr = (const char*)glGetString(GL_VERSION);
+    const std::string device = std::string(rendererStr ? rendererStr : "unknown") + " / " + (versionStr ? versionStr : "unknown");
+    uint32_t sizeBucket = 0;
+    while (((size_t)1 << sizeBucket) < numElements)
+    {
+        sizeBucket++;
+    }
+
+    // cache lines are "sizeBucket numBytes type blocksPerWorkgroup device"
+    std::string cacheData;
+    std::string keptLines;
+    if (!cacheFilename.empty() && LoadFile(cacheFilename, cacheData))
+    {
+        std::istringstream lines(cacheData);
+        std::string line;
+        while (std::getline(lines, line))
+        {
+            std::istringstream ss(line);
+            uint32_t lineBucket, lineBytes, lineBlocks;
+            std::string typeName, lineDevice;
+            if (!(ss >> lineBucket >> lineBytes >> typeName >> lineBlocks))
+            {
+                continue;
+            }
+            std::getline(ss >> std::ws, lineDevice);
+
+            Params params;
+            if (lineBucket == sizeBucket && lineBytes == numBytes && lineDevice == device && ParseType(typeName, &params.type))
+            {
+                params.blocksPerWorkgroup = lineBlocks;
+                spdlog::info("Sort autotune: using {} from {}", Create(params)->GetDescription(), cacheFilename);
+                return params;
+            }
+            keptLines += line + "\n";
+        }
+    }
+
+    spdlog::info("Sort autotune: timing sort backends on {} keys", numElements);
+
+    // uniformly distributed keys, re-uploaded before every run so each one sorts the same input
+    const uint32_t keyMask = numBytes < 4 ? (1u << (8 * numBytes)) - 1 : std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> keyVec(std::max(numElements, (size_t)1));
+    std::mt19937 rng(1234);
+    for (auto&& key : keyVec)
+    {
+        key = rng() & keyMask;
+    }
+
+    // same layout as the front of the sort args SplatRenderer fills with presort_args_compute.glsl
+    std::vector<uint32_t> argsVec = { (uint32_t)numElements, 1, 0, 0, 0, 1, 1, 1 };
+    auto argsBuffer = std::make_shared<BufferObject>(GL_DISPATCH_INDIRECT_BUFFER, argsVec, GL_DYNAMIC_STORAGE_BIT);
+
+    std::vector<Params> candidates;
+    for (uint32_t blocks : { 64u, 256u, 1024u })
+    {
+        candidates.push_back({ Type::MultiRadix, blocks });
+    }
+    for (uint32_t blocks : { 4u, 8u, 16u })
+    {
+        candidates.push_back({ Type::Onesweep, blocks });
+    }
+    candidates.push_back({ Type::Rgc, 0 });
+
+    Params bestParams;
+    double bestTime = std::numeric_limits<double>::max();
+    for (auto&& candidate : candidates)
+    {
+        std::shared_ptr<SortBackend> backend = Create(candidate);
+        if (!backend || !backend->Init(numElements))
+        {
+            spdlog::warn("Sort autotune: skipping {}, it failed to initialize", GetTypeName(candidate.type));
+            continue;
+        }
+
+        // the workgroup count presort_args_compute.glsl writes for numElements visible keys
+        const uint32_t keysPerWorkgroup = backend->GetKeysPerWorkgroup();
+        argsVec[5] = std::max((uint32_t)((numElements + keysPerWorkgroup - 1) / keysPerWorkgroup), 1u);
+        argsBuffer->Update(argsVec);
+
+        double time = std::numeric_limits<double>::max();
+        for (int run = 0; run < AUTOTUNE_WARMUP_RUNS + AUTOTUNE_TIMED_RUNS; run++)
+        {
+            backend->GetKeyBuffer()->Update(0, keyVec.data(), keyVec.size() * sizeof(uint32_t));
+            glFinish();
+
+            auto start = std::chrono::high_resolution_clock::now();
+            backend->Sort(argsBuffer, AUTOTUNE_DISPATCH_OFFSET, numBytes, (uint32_t)numElements);
+            glFinish();
+            auto end = std::chrono::high_resolution_clock::now();
+
+            if (run >= AUTOTUNE_WARMUP_RUNS)
+            {
+                time = std::min(time, std::chrono::duration<double, std::milli>(end - start).count());
+            }
+        }
+
+        spdlog::info("Sort autotune: {} took {:.3f} ms", backend->GetDescription(), time);
+        if (time < bestTime)
+        {
+            bestTime = time;
+            bestParams = backend->GetParams();
+        }
+    }
+
+    spdlog::info("Sort autotune: using {}", Create(bestParams)->GetDescription());
+
+    if (!cacheFilename.empty())
+    {
+        keptLines += std::to_string(sizeBucket) + " " + std::to_string(numBytes) + " " + GetTypeName(bestParams.type) + " " +
+            std::to_string(bestParams.blocksPerWorkgroup) + " " + device + "\n";
+        if (!SaveFile(cacheFilename, keptLines))
+        {
+            spdlog::warn("Sort autotune: failed to write {}", cacheFilename);
+        }
+    }
+
+    return bestParams;
+}
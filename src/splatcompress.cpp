@@ -0,0 +1,257 @@
+#include <splatcompress.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string.h>
+
+static const uint32_t POS_MAX_Q = 0xffff;
+static const uint32_t BYTE_MAX_Q = 0xff;
+static const uint32_t QUAT_MAX_Q = 0x3ff;  // 10 bits per component, 2 bits for the index of the dropped one
+static const float QUAT_RANGE = 0.70710678f;  // the three smallest components of a unit quaternion are within +-1/sqrt(2)
+
+// Quantization ranges of a chunk, stored in front of its streams.
+// Followed by rot[count] (uint32), pos[3][count] (uint16), alpha[count], logScale[3][count] and sh[3][numSHCoeffs][count] (uint8).
+struct ChunkHeader
+{
+    float posMin[3];
+    float posStep[3];
+    float logScaleMin;
+    float logScaleStep;
+    float dcMin[3];
+    float dcStep[3];
+    float restStep;  // higher order SH coefficients share one range, symmetric around zero
+    float padding[3];
+};
+static_assert(sizeof(ChunkHeader) % 8 == 0, "ChunkHeader must keep the streams aligned");
+
+size_t GetCompressedChunkSize(size_t count, int numSHCoeffs)
+{
+    return sizeof(ChunkHeader) + count * (sizeof(uint32_t) + 3 * sizeof(uint16_t) + 1 + 3 + 3 * numSHCoeffs);
+}
+
+static float ComputeStep(float minValue, float maxValue, uint32_t maxQ)
+{
+    return maxValue > minValue ? (maxValue - minValue) / (float)maxQ : 0.0f;
+}
+
+static inline uint32_t Quantize(float value, float minValue, float invStep, uint32_t maxQ)
+{
+    float q = (value - minValue) * invStep + 0.5f;
+    return (uint32_t)std::min(std::max(q, 0.0f), (float)maxQ);
+}
+
+static inline uint32_t EncodeQuat(float w, float x, float y, float z)
+{
+    float q[4] = { w, x, y, z };
+    float len = sqrtf(w * w + x * x + y * y + z * z);
+    if (!(len > 0.0f))
+    {
+        q[0] = 1.0f;
+        q[1] = q[2] = q[3] = 0.0f;
+        len = 1.0f;
+    }
+
+    int largest = 0;
+    for (int i = 1; i < 4; i++)
+    {
+        if (fabsf(q[i]) > fabsf(q[largest]))
+        {
+            largest = i;
+        }
+    }
+
+    // q and -q are the same rotation, so flip it until the dropped component is positive
+    const float scale = (q[largest] < 0.0f ? -1.0f : 1.0f) / len;
+    const float invStep = (float)QUAT_MAX_Q / (2.0f * QUAT_RANGE);
+    uint32_t packed = (uint32_t)largest;
+    for (int i = 0; i < 4; i++)
+    {
+        if (i != largest)
+        {
+            packed = (packed << 10) | Quantize(q[i] * scale, -QUAT_RANGE, invStep, QUAT_MAX_Q);
+        }
+    }
+    return packed;
+}
+
+static inline void DecodeQuat(uint32_t packed, float* w, float* x, float* y, float* z)
+{
+    float q[4];
+    const int largest = (int)(packed >> 30);
+    const float step = 2.0f * QUAT_RANGE / (float)QUAT_MAX_Q;
+    float sumSq = 0.0f;
+    int shift = 20;
+    for (int i = 0; i < 4; i++)
+    {
+        if (i != largest)
+        {
+            q[i] = (float)((packed >> shift) & QUAT_MAX_Q) * step - QUAT_RANGE;
+            sumSq += q[i] * q[i];
+            shift -= 10;
+        }
+    }
+    q[largest] = sqrtf(std::max(1.0f - sumSq, 0.0f));
+    *w = q[0];
+    *x = q[1];
+    *y = q[2];
+    *z = q[3];
+}
+
+void EncodeSplatChunk(const SplatChunk& in, size_t count, int numSHCoeffs, uint8_t* dst)
+{
+    const float maxFloat = std::numeric_limits<float>::max();
+
+    // quantization ranges
+    float posMin[3] = { maxFloat, maxFloat, maxFloat };
+    float posMax[3] = { -maxFloat, -maxFloat, -maxFloat };
+    float logScaleMin = maxFloat, logScaleMax = -maxFloat;
+    float dcMin[3] = { maxFloat, maxFloat, maxFloat };
+    float dcMax[3] = { -maxFloat, -maxFloat, -maxFloat };
+    float restMax = 0.0f;
+    for (size_t i = 0; i < count; i++)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            posMin[k] = std::min(posMin[k], in.pos[k][i]);
+            posMax[k] = std::max(posMax[k], in.pos[k][i]);
+            logScaleMin = std::min(logScaleMin, in.logScale[k][i]);
+            logScaleMax = std::max(logScaleMax, in.logScale[k][i]);
+            dcMin[k] = std::min(dcMin[k], in.sh[k][0][i]);
+            dcMax[k] = std::max(dcMax[k], in.sh[k][0][i]);
+            for (int j = 1; j < numSHCoeffs; j++)
+            {
+                restMax = std::max(restMax, fabsf(in.sh[k][j][i]));
+            }
+        }
+    }
+
+    ChunkHeader header;
+    memset(&header, 0, sizeof(header));
+    for (int k = 0; k < 3; k++)
+    {
+        header.posMin[k] = count ? posMin[k] : 0.0f;
+        header.posStep[k] = ComputeStep(posMin[k], posMax[k], POS_MAX_Q);
+        header.dcMin[k] = count ? dcMin[k] : 0.0f;
+        header.dcStep[k] = ComputeStep(dcMin[k], dcMax[k], BYTE_MAX_Q);
+    }
+    header.logScaleMin = count ? logScaleMin : 0.0f;
+    header.logScaleStep = ComputeStep(logScaleMin, logScaleMax, BYTE_MAX_Q);
+    header.restStep = ComputeStep(-restMax, restMax, BYTE_MAX_Q);
+    memcpy(dst, &header, sizeof(header));
+
+    auto invStep = [](float step) { return step > 0.0f ? 1.0f / step : 0.0f; };
+
+    uint32_t* rotDst = reinterpret_cast<uint32_t*>(dst + sizeof(ChunkHeader));
+    for (size_t i = 0; i < count; i++)
+    {
+        rotDst[i] = EncodeQuat(in.rot[0][i], in.rot[1][i], in.rot[2][i], in.rot[3][i]);
+    }
+
+    uint16_t* posDst = reinterpret_cast<uint16_t*>(rotDst + count);
+    for (int k = 0; k < 3; k++)
+    {
+        const float posInvStep = invStep(header.posStep[k]);
+        for (size_t i = 0; i < count; i++)
+        {
+            posDst[i] = (uint16_t)Quantize(in.pos[k][i], header.posMin[k], posInvStep, POS_MAX_Q);
+        }
+        posDst += count;
+    }
+
+    uint8_t* byteDst = reinterpret_cast<uint8_t*>(posDst);
+    for (size_t i = 0; i < count; i++)
+    {
+        byteDst[i] = (uint8_t)Quantize(in.alpha[i], 0.0f, (float)BYTE_MAX_Q, BYTE_MAX_Q);
+    }
+    byteDst += count;
+
+    const float logScaleInvStep = invStep(header.logScaleStep);
+    for (int k = 0; k < 3; k++)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            byteDst[i] = (uint8_t)Quantize(in.logScale[k][i], header.logScaleMin, logScaleInvStep, BYTE_MAX_Q);
+        }
+        byteDst += count;
+    }
+
+    const float restInvStep = invStep(header.restStep);
+    for (int k = 0; k < 3; k++)
+    {
+        const float dcInvStep = invStep(header.dcStep[k]);
+        for (int j = 0; j < numSHCoeffs; j++)
+        {
+            const float minValue = j == 0 ? header.dcMin[k] : -restMax;
+            const float shInvStep = j == 0 ? dcInvStep : restInvStep;
+            for (size_t i = 0; i < count; i++)
+            {
+                byteDst[i] = (uint8_t)Quantize(in.sh[k][j][i], minValue, shInvStep, BYTE_MAX_Q);
+            }
+            byteDst += count;
+        }
+    }
+}
+
+void DecodeSplatChunk(const uint8_t* src, size_t count, int numSHCoeffs, int numSHCoeffsOut, const SplatChunk& out)
+{
+    ChunkHeader header;
+    memcpy(&header, src, sizeof(header));
+
+    const uint32_t* rotSrc = reinterpret_cast<const uint32_t*>(src + sizeof(ChunkHeader));
+    for (size_t i = 0; i < count; i++)
+    {
+        DecodeQuat(rotSrc[i], &out.rot[0][i], &out.rot[1][i], &out.rot[2][i], &out.rot[3][i]);
+    }
+
+    const uint16_t* posSrc = reinterpret_cast<const uint16_t*>(rotSrc + count);
+    for (int k = 0; k < 3; k++)
+    {
+        const float posMin = header.posMin[k];
+        const float posStep = header.posStep[k];
+        for (size_t i = 0; i < count; i++)
+        {
+            out.pos[k][i] = posMin + (float)posSrc[i] * posStep;
+        }
+        posSrc += count;
+    }
+
+    const uint8_t* byteSrc = reinterpret_cast<const uint8_t*>(posSrc);
+    for (size_t i = 0; i < count; i++)
+    {
+        out.alpha[i] = (float)byteSrc[i] * (1.0f / (float)BYTE_MAX_Q);
+    }
+    byteSrc += count;
+
+    for (int k = 0; k < 3; k++)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            out.logScale[k][i] = header.logScaleMin + (float)byteSrc[i] * header.logScaleStep;
+        }
+        byteSrc += count;
+    }
+
+    const float restMin = -0.5f * (float)BYTE_MAX_Q * header.restStep;
+    for (int k = 0; k < 3; k++)
+    {
+        for (int j = 0; j < numSHCoeffs; j++)
+        {
+            if (j < numSHCoeffsOut)
+            {
+                const float minValue = j == 0 ? header.dcMin[k] : restMin;
+                const float step = j == 0 ? header.dcStep[k] : header.restStep;
+                float* shDst = out.sh[k][j];
+                for (size_t i = 0; i < count; i++)
+                {
+                    shDst[i] = minValue + (float)byteSrc[i] * step;
+                }
+            }
+            byteSrc += count;
+        }
+        for (int j = numSHCoeffs; j < numSHCoeffsOut; j++)
+        {
+            std::fill(out.sh[k][j], out.sh[k][j] + count, 0.0f);
+        }
+    }
+}
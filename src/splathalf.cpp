@@ -0,0 +1,144 @@
+#include <splathalf.h>
+
+#include <algorithm>
+#include <cmath>
+#include <string.h>
+
+#include <gaussiancloud.h>
+
+static const uint16_t HALF_MAX = 0x7bff;  // 65504
+
+uint16_t FloatToHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+    const uint32_t absBits = bits & 0x7fffffff;
+
+    if (absBits > 0x7f800000)
+    {
+        return sign | 0x7e00;  // NaN
+    }
+    if (absBits >= 0x477ff000)
+    {
+        return sign | HALF_MAX;  // would round to infinity
+    }
+    if (absBits < 0x38800000)
+    {
+        // below the smallest normal half, the subnormal step is 2^-24
+        float absValue;
+        memcpy(&absValue, &absBits, sizeof(absValue));
+        return sign | (uint16_t)lrintf(absValue * 16777216.0f);
+    }
+
+    // rebias the exponent from 127 to 15 and round the mantissa to nearest even, a carry correctly bumps the exponent
+    const uint32_t rounded = absBits + 0xfff + ((absBits >> 13) & 1);
+    return sign | (uint16_t)((rounded - 0x38000000) >> 13);
+}
+
+float HalfToFloat(uint16_t value)
+{
+    const uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+    const uint32_t exponent = (value >> 10) & 0x1f;
+    const uint32_t mantissa = value & 0x3ff;
+
+    uint32_t bits;
+    if (exponent == 0)
+    {
+        float result = (float)mantissa * (1.0f / 16777216.0f);
+        memcpy(&bits, &result, sizeof(bits));
+        bits |= sign;
+    }
+    else if (exponent == 31)
+    {
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    }
+    else
+    {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+
+    float result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+void ComputeCovCholesky(const float cov[6], float cholOut[6])
+{
+    const double xx = cov[0], xy = cov[1], xz = cov[2], yy = cov[3], yz = cov[4], zz = cov[5];
+
+    double l00 = sqrt(std::max(xx, 0.0));
+    double l10 = l00 > 0.0 ? xy / l00 : 0.0;
+    double l20 = l00 > 0.0 ? xz / l00 : 0.0;
+    double l11 = sqrt(std::max(yy - l10 * l10, 0.0));
+    double l21 = l11 > 0.0 ? (yz - l20 * l10) / l11 : 0.0;
+    double l22 = sqrt(std::max(zz - l20 * l20 - l21 * l21, 0.0));
+
+    cholOut[0] = (float)l00;
+    cholOut[1] = (float)l10;
+    cholOut[2] = (float)l20;
+    cholOut[3] = (float)l11;
+    cholOut[4] = (float)l21;
+    cholOut[5] = (float)l22;
+}
+
+size_t GetHalfGaussianStride(const GaussianCloud& cloud)
+{
+    return cloud.HasFullSH() ? sizeof(FullHalfGaussianData) : sizeof(HalfGaussianData);
+}
+
+static void PackHalf4(const float* src, uint16_t* dst)
+{
+    dst[0] = FloatToHalf(src[0]);
+    dst[1] = FloatToHalf(src[1]);
+    dst[2] = FloatToHalf(src[2]);
+    dst[3] = FloatToHalf(src[3]);
+}
+
+void PackHalfGaussians(const GaussianCloud& cloud, size_t begin, size_t end, void* dst)
+{
+    // each attrib is read with the stride of its stream, so this works for both the interleaved and the planar layout
+    const size_t dstStride = GetHalfGaussianStride(cloud);
+    const uint8_t* rawPtr = (const uint8_t*)cloud.GetRawDataPtr();
+    uint8_t* dstPtr = (uint8_t*)dst;
+    for (size_t i = begin; i < end; i++)
+    {
+        const uint8_t* posPtr = rawPtr + i * cloud.GetPosWithAlphaStride();
+        const uint8_t* sh0Ptr = rawPtr + i * cloud.GetSH0Stride();
+        const uint8_t* cov3Ptr = rawPtr + i * cloud.GetCov3Stride();
+
+        HalfGaussianData* halfPtr = reinterpret_cast<HalfGaussianData*>(dstPtr);
+        memcpy(halfPtr->posWithAlpha, cloud.GetPosWithAlphaAttrib().Get<float>(posPtr), 4 * sizeof(float));
+        PackHalf4(cloud.GetR_SH0Attrib().Get<float>(sh0Ptr), halfPtr->r_sh0);
+        PackHalf4(cloud.GetG_SH0Attrib().Get<float>(sh0Ptr), halfPtr->g_sh0);
+        PackHalf4(cloud.GetB_SH0Attrib().Get<float>(sh0Ptr), halfPtr->b_sh0);
+
+        const float* col0 = cloud.GetCov3_Col0Attrib().Get<float>(cov3Ptr);
+        const float* col1 = cloud.GetCov3_Col1Attrib().Get<float>(cov3Ptr);
+        const float* col2 = cloud.GetCov3_Col2Attrib().Get<float>(cov3Ptr);
+        const float cov[6] = { col0[0], col0[1], col0[2], col1[1], col1[2], col2[2] };
+        float chol[6];
+        ComputeCovCholesky(cov, chol);
+        const float chol0[4] = { chol[0], chol[1], chol[2], chol[3] };
+        const float chol1[4] = { chol[4], chol[5], 0.0f, 0.0f };
+        PackHalf4(chol0, halfPtr->cov3_chol0);
+        PackHalf4(chol1, halfPtr->cov3_chol1);
+
+        if (cloud.HasFullSH())
+        {
+            const uint8_t* shRestPtr = rawPtr + i * cloud.GetSHRestStride();
+            FullHalfGaussianData* fullPtr = reinterpret_cast<FullHalfGaussianData*>(dstPtr);
+            PackHalf4(cloud.GetR_SH1Attrib().Get<float>(shRestPtr), fullPtr->r_sh1);
+            PackHalf4(cloud.GetR_SH2Attrib().Get<float>(shRestPtr), fullPtr->r_sh2);
+            PackHalf4(cloud.GetR_SH3Attrib().Get<float>(shRestPtr), fullPtr->r_sh3);
+            PackHalf4(cloud.GetG_SH1Attrib().Get<float>(shRestPtr), fullPtr->g_sh1);
+            PackHalf4(cloud.GetG_SH2Attrib().Get<float>(shRestPtr), fullPtr->g_sh2);
+            PackHalf4(cloud.GetG_SH3Attrib().Get<float>(shRestPtr), fullPtr->g_sh3);
+            PackHalf4(cloud.GetB_SH1Attrib().Get<float>(shRestPtr), fullPtr->b_sh1);
+            PackHalf4(cloud.GetB_SH2Attrib().Get<float>(shRestPtr), fullPtr->b_sh2);
+            PackHalf4(cloud.GetB_SH3Attrib().Get<float>(shRestPtr), fullPtr->b_sh3);
+        }
+
+        dstPtr += dstStride;
+    }
+}
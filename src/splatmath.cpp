@@ -0,0 +1,521 @@
+#include <splatmath.h>
+
+#include <cmath>
+
+// 4 sweeps converge to float precision, even for (nearly) repeated eigenvalues.
+static const int JACOBI_SWEEPS = 4;
+
+// lower bound for eigenvalues of degenerate (flat) splats, keeps log(scale) finite.
+static const float MIN_EIGENVALUE = 1.0e-30f;
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SPLATMATH_X86
+#include <immintrin.h>
+#endif
+
+//
+// scalar fallback
+//
+
+static void ActivateSplatsScalar(const SplatParamsBatch& in, const SplatActivatedBatch& out, size_t begin, size_t end)
+{
+    for (size_t i = begin; i < end; i++)
+    {
+        out.alpha[i] = 1.0f / (1.0f + expf(-in.opacity[i]));
+
+        float s0 = expf(in.logScale[0][i]);
+        float s1 = expf(in.logScale[1][i]);
+        float s2 = expf(in.logScale[2][i]);
+        s0 *= s0;
+        s1 *= s1;
+        s2 *= s2;
+
+        float w = in.rot[0][i];
+        float x = in.rot[1][i];
+        float y = in.rot[2][i];
+        float z = in.rot[3][i];
+        float invLen = 1.0f / sqrtf(w * w + x * x + y * y + z * z);
+        w *= invLen;
+        x *= invLen;
+        y *= invLen;
+        z *= invLen;
+
+        // rotation matrix rows
+        float r00 = 1.0f - 2.0f * (y * y + z * z), r01 = 2.0f * (x * y - w * z), r02 = 2.0f * (x * z + w * y);
+        float r10 = 2.0f * (x * y + w * z), r11 = 1.0f - 2.0f * (x * x + z * z), r12 = 2.0f * (y * z - w * x);
+        float r20 = 2.0f * (x * z - w * y), r21 = 2.0f * (y * z + w * x), r22 = 1.0f - 2.0f * (x * x + y * y);
+
+        out.cov[0][i] = r00 * r00 * s0 + r01 * r01 * s1 + r02 * r02 * s2;
+        out.cov[1][i] = r00 * r10 * s0 + r01 * r11 * s1 + r02 * r12 * s2;
+        out.cov[2][i] = r00 * r20 * s0 + r01 * r21 * s1 + r02 * r22 * s2;
+        out.cov[3][i] = r10 * r10 * s0 + r11 * r11 * s1 + r12 * r12 * s2;
+        out.cov[4][i] = r10 * r20 * s0 + r11 * r21 * s1 + r12 * r22 * s2;
+        out.cov[5][i] = r20 * r20 * s0 + r21 * r21 * s1 + r22 * r22 * s2;
+    }
+}
+
+// One Jacobi rotation in the (p, q) plane, around axis k, where (p, q, k) is a cyclic permutation of (x, y, z).
+// Zeroes apq, and right-multiplies the accumulated rotation (w, vp, vq, vk) by the same rotation.
+static inline void JacobiRotate(float& app, float& aqq, float& apq, float& akp, float& akq,
+                                float& w, float& vp, float& vq, float& vk)
+{
+    // t = tan of the rotation angle, computed without dividing by apq
+    float theta = aqq - app;
+    float num = theta < 0.0f ? -2.0f * apq : 2.0f * apq;
+    float den = fabsf(theta) + sqrtf(theta * theta + 4.0f * apq * apq);
+    float t = den > 0.0f ? num / den : 0.0f;
+    float c = 1.0f / sqrtf(1.0f + t * t);
+    float s = t * c;
+
+    app -= t * apq;
+    aqq += t * apq;
+    apq = 0.0f;
+    float kp = c * akp - s * akq;
+    float kq = s * akp + c * akq;
+    akp = kp;
+    akq = kq;
+
+    // half angle quaternion, cos >= 1/sqrt(2) so ch never gets small
+    float ch = sqrtf(0.5f * (1.0f + c));
+    float sh = -s / (2.0f * ch);
+    float w2 = w * ch - vk * sh;
+    float vp2 = ch * vp + sh * vq;
+    float vq2 = ch * vq - sh * vp;
+    float vk2 = ch * vk + w * sh;
+    w = w2;
+    vp = vp2;
+    vq = vq2;
+    vk = vk2;
+}
+
+static void DeactivateSplatsScalar(const SplatActivatedBatch& in, const SplatParamsBatch& out, size_t begin, size_t end)
+{
+    for (size_t i = begin; i < end; i++)
+    {
+        out.opacity[i] = -logf((1.0f / in.alpha[i]) - 1.0f);
+
+        float a00 = in.cov[0][i], a01 = in.cov[1][i], a02 = in.cov[2][i];
+        float a11 = in.cov[3][i], a12 = in.cov[4][i], a22 = in.cov[5][i];
+        float w = 1.0f, x = 0.0f, y = 0.0f, z = 0.0f;
+        for (int sweep = 0; sweep < JACOBI_SWEEPS; sweep++)
+        {
+            JacobiRotate(a00, a11, a01, a02, a12, w, x, y, z);
+            JacobiRotate(a11, a22, a12, a01, a02, w, y, z, x);
+            JacobiRotate(a22, a00, a02, a12, a01, w, z, x, y);
+        }
+
+        float invLen = 1.0f / sqrtf(w * w + x * x + y * y + z * z);
+        out.rot[0][i] = w * invLen;
+        out.rot[1][i] = x * invLen;
+        out.rot[2][i] = y * invLen;
+        out.rot[3][i] = z * invLen;
+
+        // the eigenvalues are the squared scales, log(sqrt(l)) = 0.5 * log(l)
+        out.logScale[0][i] = 0.5f * logf(fmaxf(a00, MIN_EIGENVALUE));
+        out.logScale[1][i] = 0.5f * logf(fmaxf(a11, MIN_EIGENVALUE));
+        out.logScale[2][i] = 0.5f * logf(fmaxf(a22, MIN_EIGENVALUE));
+    }
+}
+
+#ifdef SPLATMATH_X86
+
+// Cephes style expf, clamped to the range of normal floats. ~1 ulp.
+static const float EXP_HI = 88.3762626647949f;
+static const float EXP_LO = -87.3365478515625f;
+static const float LOG2EF = 1.44269504088896341f;
+static const float EXP_C1 = 0.693359375f;
+static const float EXP_C2 = -2.12194440e-4f;
+static const float EXP_P0 = 1.9875691500e-4f;
+static const float EXP_P1 = 1.3981999507e-3f;
+static const float EXP_P2 = 8.3334519073e-3f;
+static const float EXP_P3 = 4.1665795894e-2f;
+static const float EXP_P4 = 1.6666665459e-1f;
+static const float EXP_P5 = 5.0000001201e-1f;
+
+//
+// AVX2, 8 splats per iteration
+//
+
+__attribute__((target("avx2,fma")))
+static inline __m256 Exp8(__m256 x)
+{
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(EXP_LO)), _mm256_set1_ps(EXP_HI));
+    __m256 n = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(LOG2EF)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    x = _mm256_fnmadd_ps(n, _mm256_set1_ps(EXP_C1), x);
+    x = _mm256_fnmadd_ps(n, _mm256_set1_ps(EXP_C2), x);
+    __m256 y = _mm256_set1_ps(EXP_P0);
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P1));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P2));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P3));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P4));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P5));
+    y = _mm256_fmadd_ps(y, _mm256_mul_ps(x, x), _mm256_add_ps(x, _mm256_set1_ps(1.0f)));
+    __m256i pow2n = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+    return _mm256_mul_ps(y, _mm256_castsi256_ps(pow2n));
+}
+
+// a0*b0*s0 + a1*b1*s1 + a2*b2*s2
+__attribute__((target("avx2,fma")))
+static inline __m256 ScaledDot8(__m256 a0, __m256 a1, __m256 a2, __m256 b0, __m256 b1, __m256 b2, __m256 s0, __m256 s1, __m256 s2)
+{
+    return _mm256_fmadd_ps(_mm256_mul_ps(a0, b0), s0, _mm256_fmadd_ps(_mm256_mul_ps(a1, b1), s1, _mm256_mul_ps(_mm256_mul_ps(a2, b2), s2)));
+}
+
+__attribute__((target("avx2,fma")))
+static void ActivateSplatsAVX2(const SplatParamsBatch& in, const SplatActivatedBatch& out, size_t count)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 two = _mm256_set1_ps(2.0f);
+    const __m256i laneIndex = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    for (size_t i = 0; i < count; i += 8)
+    {
+        // masked loads/stores for the tail, so every splat goes through identical math
+        __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32((int)(count - i)), laneIndex);
+
+        __m256 opacity = _mm256_maskload_ps(in.opacity + i, mask);
+        _mm256_maskstore_ps(out.alpha + i, mask, _mm256_div_ps(one, _mm256_add_ps(one, Exp8(_mm256_sub_ps(_mm256_setzero_ps(), opacity)))));
+
+        __m256 s0 = Exp8(_mm256_maskload_ps(in.logScale[0] + i, mask));
+        __m256 s1 = Exp8(_mm256_maskload_ps(in.logScale[1] + i, mask));
+        __m256 s2 = Exp8(_mm256_maskload_ps(in.logScale[2] + i, mask));
+        s0 = _mm256_mul_ps(s0, s0);
+        s1 = _mm256_mul_ps(s1, s1);
+        s2 = _mm256_mul_ps(s2, s2);
+
+        // masked off lanes load zero, keep them away from a division by zero.
+        __m256 w = _mm256_blendv_ps(one, _mm256_maskload_ps(in.rot[0] + i, mask), _mm256_castsi256_ps(mask));
+        __m256 x = _mm256_maskload_ps(in.rot[1] + i, mask);
+        __m256 y = _mm256_maskload_ps(in.rot[2] + i, mask);
+        __m256 z = _mm256_maskload_ps(in.rot[3] + i, mask);
+        __m256 lenSq = _mm256_fmadd_ps(w, w, _mm256_fmadd_ps(x, x, _mm256_fmadd_ps(y, y, _mm256_mul_ps(z, z))));
+        __m256 invLen = _mm256_div_ps(one, _mm256_sqrt_ps(lenSq));
+        w = _mm256_mul_ps(w, invLen);
+        x = _mm256_mul_ps(x, invLen);
+        y = _mm256_mul_ps(y, invLen);
+        z = _mm256_mul_ps(z, invLen);
+
+        __m256 xx = _mm256_mul_ps(x, x), yy = _mm256_mul_ps(y, y), zz = _mm256_mul_ps(z, z);
+        __m256 xy = _mm256_mul_ps(x, y), xz = _mm256_mul_ps(x, z), yz = _mm256_mul_ps(y, z);
+        __m256 wx = _mm256_mul_ps(w, x), wy = _mm256_mul_ps(w, y), wz = _mm256_mul_ps(w, z);
+
+        // rotation matrix rows
+        __m256 r00 = _mm256_fnmadd_ps(two, _mm256_add_ps(yy, zz), one);
+        __m256 r01 = _mm256_mul_ps(two, _mm256_sub_ps(xy, wz));
+        __m256 r02 = _mm256_mul_ps(two, _mm256_add_ps(xz, wy));
+        __m256 r10 = _mm256_mul_ps(two, _mm256_add_ps(xy, wz));
+        __m256 r11 = _mm256_fnmadd_ps(two, _mm256_add_ps(xx, zz), one);
+        __m256 r12 = _mm256_mul_ps(two, _mm256_sub_ps(yz, wx));
+        __m256 r20 = _mm256_mul_ps(two, _mm256_sub_ps(xz, wy));
+        __m256 r21 = _mm256_mul_ps(two, _mm256_add_ps(yz, wx));
+        __m256 r22 = _mm256_fnmadd_ps(two, _mm256_add_ps(xx, yy), one);
+
+        _mm256_maskstore_ps(out.cov[0] + i, mask, ScaledDot8(r00, r01, r02, r00, r01, r02, s0, s1, s2));
+        _mm256_maskstore_ps(out.cov[1] + i, mask, ScaledDot8(r00, r01, r02, r10, r11, r12, s0, s1, s2));
+        _mm256_maskstore_ps(out.cov[2] + i, mask, ScaledDot8(r00, r01, r02, r20, r21, r22, s0, s1, s2));
+        _mm256_maskstore_ps(out.cov[3] + i, mask, ScaledDot8(r10, r11, r12, r10, r11, r12, s0, s1, s2));
+        _mm256_maskstore_ps(out.cov[4] + i, mask, ScaledDot8(r10, r11, r12, r20, r21, r22, s0, s1, s2));
+        _mm256_maskstore_ps(out.cov[5] + i, mask, ScaledDot8(r20, r21, r22, r20, r21, r22, s0, s1, s2));
+    }
+}
+
+// Cephes style logf for positive, normal inputs. ~1 ulp.
+static const float LOG_SQRTHF = 0.707106781186547524f;
+static const float LOG_P0 = 7.0376836292e-2f;
+static const float LOG_P1 = -1.1514610310e-1f;
+static const float LOG_P2 = 1.1676998740e-1f;
+static const float LOG_P3 = -1.2420140846e-1f;
+static const float LOG_P4 = 1.4249322787e-1f;
+static const float LOG_P5 = -1.6668057665e-1f;
+static const float LOG_P6 = 2.0000714765e-1f;
+static const float LOG_P7 = -2.4999993993e-1f;
+static const float LOG_P8 = 3.3333331174e-1f;
+
+__attribute__((target("avx2,fma")))
+static inline __m256 Log8(__m256 x)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    x = _mm256_max_ps(x, _mm256_set1_ps(1.17549435e-38f));  // smallest normal float
+
+    // split into exponent and a mantissa in [0.5, 1)
+    __m256i bits = _mm256_castps_si256(x);
+    __m256 e = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(126)));
+    x = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)), _mm256_set1_epi32(0x3f000000)));
+
+    // shift the mantissa into [sqrt(0.5), sqrt(2))
+    __m256 mask = _mm256_cmp_ps(x, _mm256_set1_ps(LOG_SQRTHF), _CMP_LT_OQ);
+    e = _mm256_sub_ps(e, _mm256_and_ps(one, mask));
+    x = _mm256_add_ps(_mm256_sub_ps(x, one), _mm256_and_ps(x, mask));
+
+    __m256 z = _mm256_mul_ps(x, x);
+    __m256 y = _mm256_set1_ps(LOG_P0);
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(LOG_P1));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(LOG_P2));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(LOG_P3));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(LOG_P4));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(LOG_P5));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(LOG_P6));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(LOG_P7));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(LOG_P8));
+    y = _mm256_mul_ps(_mm256_mul_ps(y, x), z);
+    y = _mm256_fmadd_ps(e, _mm256_set1_ps(EXP_C2), y);
+    y = _mm256_fnmadd_ps(_mm256_set1_ps(0.5f), z, y);
+    x = _mm256_add_ps(x, y);
+    return _mm256_fmadd_ps(e, _mm256_set1_ps(EXP_C1), x);
+}
+
+// 8 wide version of JacobiRotate()
+__attribute__((target("avx2,fma")))
+static inline void JacobiRotate8(__m256& app, __m256& aqq, __m256& apq, __m256& akp, __m256& akq,
+                                 __m256& w, __m256& vp, __m256& vq, __m256& vk)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 signMask = _mm256_set1_ps(-0.0f);
+
+    __m256 theta = _mm256_sub_ps(aqq, app);
+    __m256 apq2 = _mm256_add_ps(apq, apq);
+    __m256 num = _mm256_xor_ps(apq2, _mm256_and_ps(theta, signMask));
+    __m256 den = _mm256_add_ps(_mm256_andnot_ps(signMask, theta), _mm256_sqrt_ps(_mm256_fmadd_ps(theta, theta, _mm256_mul_ps(apq2, apq2))));
+    __m256 t = _mm256_and_ps(_mm256_div_ps(num, den), _mm256_cmp_ps(den, _mm256_setzero_ps(), _CMP_GT_OQ));
+    __m256 c = _mm256_div_ps(one, _mm256_sqrt_ps(_mm256_fmadd_ps(t, t, one)));
+    __m256 s = _mm256_mul_ps(t, c);
+
+    app = _mm256_fnmadd_ps(t, apq, app);
+    aqq = _mm256_fmadd_ps(t, apq, aqq);
+    apq = _mm256_setzero_ps();
+    __m256 kp = _mm256_fnmadd_ps(s, akq, _mm256_mul_ps(c, akp));
+    __m256 kq = _mm256_fmadd_ps(s, akp, _mm256_mul_ps(c, akq));
+    akp = kp;
+    akq = kq;
+
+    __m256 ch = _mm256_sqrt_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), _mm256_add_ps(one, c)));
+    __m256 sh = _mm256_div_ps(_mm256_sub_ps(_mm256_setzero_ps(), s), _mm256_add_ps(ch, ch));
+    __m256 w2 = _mm256_fnmadd_ps(vk, sh, _mm256_mul_ps(w, ch));
+    __m256 vp2 = _mm256_fmadd_ps(sh, vq, _mm256_mul_ps(ch, vp));
+    __m256 vq2 = _mm256_fnmadd_ps(sh, vp, _mm256_mul_ps(ch, vq));
+    __m256 vk2 = _mm256_fmadd_ps(w, sh, _mm256_mul_ps(ch, vk));
+    w = w2;
+    vp = vp2;
+    vq = vq2;
+    vk = vk2;
+}
+
+__attribute__((target("avx2,fma")))
+static void DeactivateSplatsAVX2(const SplatActivatedBatch& in, const SplatParamsBatch& out, size_t count)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 minEigenvalue = _mm256_set1_ps(MIN_EIGENVALUE);
+    const __m256i laneIndex = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    for (size_t i = 0; i < count; i += 8)
+    {
+        __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32((int)(count - i)), laneIndex);
+
+        // masked off lanes load alpha = 0.5 and an identity cov, which keeps them finite
+        __m256 alpha = _mm256_blendv_ps(half, _mm256_maskload_ps(in.alpha + i, mask), _mm256_castsi256_ps(mask));
+        __m256 opacity = _mm256_sub_ps(_mm256_setzero_ps(), Log8(_mm256_sub_ps(_mm256_div_ps(one, alpha), one)));
+        _mm256_maskstore_ps(out.opacity + i, mask, opacity);
+
+        __m256 a00 = _mm256_blendv_ps(one, _mm256_maskload_ps(in.cov[0] + i, mask), _mm256_castsi256_ps(mask));
+        __m256 a01 = _mm256_maskload_ps(in.cov[1] + i, mask);
+        __m256 a02 = _mm256_maskload_ps(in.cov[2] + i, mask);
+        __m256 a11 = _mm256_blendv_ps(one, _mm256_maskload_ps(in.cov[3] + i, mask), _mm256_castsi256_ps(mask));
+        __m256 a12 = _mm256_maskload_ps(in.cov[4] + i, mask);
+        __m256 a22 = _mm256_blendv_ps(one, _mm256_maskload_ps(in.cov[5] + i, mask), _mm256_castsi256_ps(mask));
+        __m256 w = one;
+        __m256 x = _mm256_setzero_ps();
+        __m256 y = _mm256_setzero_ps();
+        __m256 z = _mm256_setzero_ps();
+        for (int sweep = 0; sweep < JACOBI_SWEEPS; sweep++)
+        {
+            JacobiRotate8(a00, a11, a01, a02, a12, w, x, y, z);
+            JacobiRotate8(a11, a22, a12, a01, a02, w, y, z, x);
+            JacobiRotate8(a22, a00, a02, a12, a01, w, z, x, y);
+        }
+
+        __m256 lenSq = _mm256_fmadd_ps(w, w, _mm256_fmadd_ps(x, x, _mm256_fmadd_ps(y, y, _mm256_mul_ps(z, z))));
+        __m256 invLen = _mm256_div_ps(one, _mm256_sqrt_ps(lenSq));
+        _mm256_maskstore_ps(out.rot[0] + i, mask, _mm256_mul_ps(w, invLen));
+        _mm256_maskstore_ps(out.rot[1] + i, mask, _mm256_mul_ps(x, invLen));
+        _mm256_maskstore_ps(out.rot[2] + i, mask, _mm256_mul_ps(y, invLen));
+        _mm256_maskstore_ps(out.rot[3] + i, mask, _mm256_mul_ps(z, invLen));
+
+        _mm256_maskstore_ps(out.logScale[0] + i, mask, _mm256_mul_ps(half, Log8(_mm256_max_ps(a00, minEigenvalue))));
+        _mm256_maskstore_ps(out.logScale[1] + i, mask, _mm256_mul_ps(half, Log8(_mm256_max_ps(a11, minEigenvalue))));
+        _mm256_maskstore_ps(out.logScale[2] + i, mask, _mm256_mul_ps(half, Log8(_mm256_max_ps(a22, minEigenvalue))));
+    }
+}
+
+//
+// AVX-512, 16 splats per iteration
+//
+
+__attribute__((target("avx512f")))
+static inline __m512 Exp16(__m512 x)
+{
+    x = _mm512_min_ps(_mm512_max_ps(x, _mm512_set1_ps(EXP_LO)), _mm512_set1_ps(EXP_HI));
+    __m512 n = _mm512_roundscale_ps(_mm512_mul_ps(x, _mm512_set1_ps(LOG2EF)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    x = _mm512_fnmadd_ps(n, _mm512_set1_ps(EXP_C1), x);
+    x = _mm512_fnmadd_ps(n, _mm512_set1_ps(EXP_C2), x);
+    __m512 y = _mm512_set1_ps(EXP_P0);
+    y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXP_P1));
+    y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXP_P2));
+    y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXP_P3));
+    y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXP_P4));
+    y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXP_P5));
+    y = _mm512_fmadd_ps(y, _mm512_mul_ps(x, x), _mm512_add_ps(x, _mm512_set1_ps(1.0f)));
+    __m512i pow2n = _mm512_slli_epi32(_mm512_add_epi32(_mm512_cvtps_epi32(n), _mm512_set1_epi32(127)), 23);
+    return _mm512_mul_ps(y, _mm512_castsi512_ps(pow2n));
+}
+
+__attribute__((target("avx512f")))
+static inline __m512 ScaledDot16(__m512 a0, __m512 a1, __m512 a2, __m512 b0, __m512 b1, __m512 b2, __m512 s0, __m512 s1, __m512 s2)
+{
+    return _mm512_fmadd_ps(_mm512_mul_ps(a0, b0), s0, _mm512_fmadd_ps(_mm512_mul_ps(a1, b1), s1, _mm512_mul_ps(_mm512_mul_ps(a2, b2), s2)));
+}
+
+__attribute__((target("avx512f")))
+static void ActivateSplatsAVX512(const SplatParamsBatch& in, const SplatActivatedBatch& out, size_t count)
+{
+    const __m512 one = _mm512_set1_ps(1.0f);
+    const __m512 two = _mm512_set1_ps(2.0f);
+
+    for (size_t i = 0; i < count; i += 16)
+    {
+        size_t remaining = count - i;
+        __mmask16 mask = remaining >= 16 ? (__mmask16)0xffff : (__mmask16)((1u << remaining) - 1);
+
+        __m512 opacity = _mm512_maskz_loadu_ps(mask, in.opacity + i);
+        _mm512_mask_storeu_ps(out.alpha + i, mask, _mm512_div_ps(one, _mm512_add_ps(one, Exp16(_mm512_sub_ps(_mm512_setzero_ps(), opacity)))));
+
+        __m512 s0 = Exp16(_mm512_maskz_loadu_ps(mask, in.logScale[0] + i));
+        __m512 s1 = Exp16(_mm512_maskz_loadu_ps(mask, in.logScale[1] + i));
+        __m512 s2 = Exp16(_mm512_maskz_loadu_ps(mask, in.logScale[2] + i));
+        s0 = _mm512_mul_ps(s0, s0);
+        s1 = _mm512_mul_ps(s1, s1);
+        s2 = _mm512_mul_ps(s2, s2);
+
+        // masked off lanes load zero, keep them away from a division by zero.
+        __m512 w = _mm512_mask_loadu_ps(one, mask, in.rot[0] + i);
+        __m512 x = _mm512_maskz_loadu_ps(mask, in.rot[1] + i);
+        __m512 y = _mm512_maskz_loadu_ps(mask, in.rot[2] + i);
+        __m512 z = _mm512_maskz_loadu_ps(mask, in.rot[3] + i);
+        __m512 lenSq = _mm512_fmadd_ps(w, w, _mm512_fmadd_ps(x, x, _mm512_fmadd_ps(y, y, _mm512_mul_ps(z, z))));
+        __m512 invLen = _mm512_div_ps(one, _mm512_sqrt_ps(lenSq));
+        w = _mm512_mul_ps(w, invLen);
+        x = _mm512_mul_ps(x, invLen);
+        y = _mm512_mul_ps(y, invLen);
+        z = _mm512_mul_ps(z, invLen);
+
+        __m512 xx = _mm512_mul_ps(x, x), yy = _mm512_mul_ps(y, y), zz = _mm512_mul_ps(z, z);
+        __m512 xy = _mm512_mul_ps(x, y), xz = _mm512_mul_ps(x, z), yz = _mm512_mul_ps(y, z);
+        __m512 wx = _mm512_mul_ps(w, x), wy = _mm512_mul_ps(w, y), wz = _mm512_mul_ps(w, z);
+
+        // rotation matrix rows
+        __m512 r00 = _mm512_fnmadd_ps(two, _mm512_add_ps(yy, zz), one);
+        __m512 r01 = _mm512_mul_ps(two, _mm512_sub_ps(xy, wz));
+        __m512 r02 = _mm512_mul_ps(two, _mm512_add_ps(xz, wy));
+        __m512 r10 = _mm512_mul_ps(two, _mm512_add_ps(xy, wz));
+        __m512 r11 = _mm512_fnmadd_ps(two, _mm512_add_ps(xx, zz), one);
+        __m512 r12 = _mm512_mul_ps(two, _mm512_sub_ps(yz, wx));
+        __m512 r20 = _mm512_mul_ps(two, _mm512_sub_ps(xz, wy));
+        __m512 r21 = _mm512_mul_ps(two, _mm512_add_ps(yz, wx));
+        __m512 r22 = _mm512_fnmadd_ps(two, _mm512_add_ps(xx, yy), one);
+
+        _mm512_mask_storeu_ps(out.cov[0] + i, mask, ScaledDot16(r00, r01, r02, r00, r01, r02, s0, s1, s2));
+        _mm512_mask_storeu_ps(out.cov[1] + i, mask, ScaledDot16(r00, r01, r02, r10, r11, r12, s0, s1, s2));
+        _mm512_mask_storeu_ps(out.cov[2] + i, mask, ScaledDot16(r00, r01, r02, r20, r21, r22, s0, s1, s2));
+        _mm512_mask_storeu_ps(out.cov[3] + i, mask, ScaledDot16(r10, r11, r12, r10, r11, r12, s0, s1, s2));
+        _mm512_mask_storeu_ps(out.cov[4] + i, mask, ScaledDot16(r10, r11, r12, r20, r21, r22, s0, s1, s2));
+        _mm512_mask_storeu_ps(out.cov[5] + i, mask, ScaledDot16(r20, r21, r22, r20, r21, r22, s0, s1, s2));
+    }
+}
+
+#endif  // SPLATMATH_X86
+
+enum class SplatMathISA
+{
+    Scalar,
+    AVX2,
+    AVX512
+};
+
+static SplatMathISA DetectISA()
+{
+#ifdef SPLATMATH_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+    {
+        return SplatMathISA::AVX512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+        return SplatMathISA::AVX2;
+    }
+#endif
+    return SplatMathISA::Scalar;
+}
+
+static SplatMathISA GetISA()
+{
+    static const SplatMathISA isa = DetectISA();
+    return isa;
+}
+
+void ActivateSplats(const SplatParamsBatch& in, const SplatActivatedBatch& out, size_t count)
+{
+    switch (GetISA())
+    {
+#ifdef SPLATMATH_X86
+    case SplatMathISA::AVX512:
+        ActivateSplatsAVX512(in, out, count);
+        break;
+    case SplatMathISA::AVX2:
+        ActivateSplatsAVX2(in, out, count);
+        break;
+#endif
+    default:
+        ActivateSplatsScalar(in, out, 0, count);
+        break;
+    }
+}
+
+void DeactivateSplats(const SplatActivatedBatch& in, const SplatParamsBatch& out, size_t count)
+{
+#ifdef SPLATMATH_X86
+    // the off-diagonal terms converge to zero, flush their squares to zero instead of taking the slow denormal path.
+    unsigned int csr = _mm_getcsr();
+    _mm_setcsr(csr | 0x8040);  // FTZ | DAZ
+#endif
+
+    switch (GetISA())
+    {
+#ifdef SPLATMATH_X86
+    case SplatMathISA::AVX512:  // the 8 wide kernel is already bound by sqrt/div throughput
+    case SplatMathISA::AVX2:
+        DeactivateSplatsAVX2(in, out, count);
+        break;
+#endif
+    default:
+        DeactivateSplatsScalar(in, out, 0, count);
+        break;
+    }
+
+#ifdef SPLATMATH_X86
+    _mm_setcsr(csr);
+#endif
+}
+
+const char* GetSplatMathISA()
+{
+    switch (GetISA())
+    {
+    case SplatMathISA::AVX512:
+        return "avx512";
+    case SplatMathISA::AVX2:
+        return "avx2";
+    default:
+        return "scalar";
+    }
+}
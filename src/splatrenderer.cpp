@@ -16,11 +16,81 @@
 #define ZoneScopedNC(NAME, COLOR)
 #endif
 
+#include <cpusort.h>
+#include <splathalf.h>
+#include <threadpool.h>
 #include <util.h>
 
-#include <radix_sort.hpp>
+static const size_t POS_GRAIN_SIZE = 16384;
 
-static const uint32_t NUM_BLOCKS_PER_WORKGROUP = 1024;
+// layout of indirectArgsBuffer, filled on the gpu by presort_args_compute.glsl
+struct DrawElementsIndirectCommand
+{
+    uint32_t count;
+    uint32_t instanceCount;
+    uint32_t firstIndex;
+    int32_t baseVertex;
+    uint32_t baseInstance;
+};
+
+struct DrawArraysIndirectCommand
+{
+    uint32_t count;
+    uint32_t instanceCount;
+    uint32_t first;
+    uint32_t baseInstance;
+};
+
+struct SortIndirectArgs
+{
+    DrawElementsIndirectCommand draw;
+    uint32_t sortNumGroups[3];  // DispatchIndirectCommand for the radix sort passes
+    uint32_t quantizeNumGroups[3];  // DispatchIndirectCommand for presort_quantize_compute.glsl
+    DrawArraysIndirectCommand quadDraw;  // one instanced 4 vertex strip per visible splat, for RasterMode::InstancedQuads
+};
+
+static const uint32_t QUANTIZE_LOCAL_SIZE = 256;
+
+// pixel size of the tiles of tile_keys_compute.glsl and tile_raster_compute.glsl
+static const uint32_t RASTER_TILE_SIZE = 16;
+
+// layout of projectedSplatBuffer, see splat_vert.glsl with TILE_PROJECT
+struct ProjectedSplat
+{
+    glm::vec4 clipPos;
+    glm::vec4 cov2;
+    glm::vec4 color;
+    glm::vec4 p;
+};
+
+// layout of preprocessedSplatBuffer, see preprocess_compute.glsl
+struct PreprocessedSplat
+{
+    glm::vec4 center;
+    glm::vec4 conic;
+    glm::vec4 color;
+};
+
+// inserts splat_common.glsl at /*%%SPLAT_COMMON%%*/, it needs the defines of the shader it goes into
+static bool AddSplatCommon(Program* prog)
+{
+    std::string common;
+    if (!LoadFile("shaders_gs/splat_common.glsl", common))
+    {
+        spdlog::error("Failed to load shaders_gs/splat_common.glsl");
+        return false;
+    }
+    prog->AddMacro("SPLAT_COMMON", common);
+    return true;
+}
+
+// angle of the rotation between two camera orientations
+static float CameraRotationDeg(const glm::mat4& cameraMatA, const glm::mat4& cameraMatB)
+{
+    glm::mat3 delta = glm::transpose(glm::mat3(cameraMatA)) * glm::mat3(cameraMatB);
+    float cosAngle = glm::clamp((delta[0][0] + delta[1][1] + delta[2][2] - 1.0f) * 0.5f, -1.0f, 1.0f);
+    return glm::degrees(acosf(cosAngle));
+}
 
 static void SetupAttrib(int loc, const BinaryAttribute& attrib, int32_t count, size_t stride)
 {
@@ -29,43 +99,174 @@ static void SetupAttrib(int loc, const BinaryAttribute& attrib, int32_t count, s
     glEnableVertexAttribArray(loc);
 }
 
-SplatRenderer::SplatRenderer()
+static void SetupHalfAttrib(int loc, size_t offset, int32_t count, size_t stride)
+{
+    glVertexAttribPointer(loc, count, GL_HALF_FLOAT, GL_FALSE, (uint32_t)stride, (void*)offset);
+    glEnableVertexAttribArray(loc);
+}
+
+SplatRenderer::SplatRenderer() : tileColorTexture(0), tileWidth(0), tileHeight(0), tileDepthBits(0),
+                                 tileCountPending(), tileCountIndex(0), tileKeysOverflow(0),
+                                 drawQueries(), drawQueryPending(), drawQueryIndex(0), drawGpuMs(0.0),
+                                 fragmentQueries(), fragmentQueryPending(), fragmentQueryIndex(0)
 {
 }
 
 SplatRenderer::~SplatRenderer()
 {
+    for (int i = 0; i < MAX_SORT_VIEWS; i++)
+    {
+        sortViews[i].asyncSorter = nullptr;
+    }
+    if (tileColorTexture)
+    {
+        glDeleteTextures(1, &tileColorTexture);
+    }
+#ifndef __ANDROID__
+    if (drawQueries[0][0])
+    {
+        glDeleteQueries(NUM_DRAW_QUERIES * 2, &drawQueries[0][0]);
+    }
+    if (fragmentQueries[0][0])
+    {
+        glDeleteQueries(NUM_DRAW_QUERIES * 2, &fragmentQueries[0][0]);
+    }
+#endif
 }
 
 bool SplatRenderer::Init(std::shared_ptr<GaussianCloud> gaussianCloud,
-                         bool isFramebufferSRGBEnabledIn, bool useRgcSortOverrideIn)
+                         bool isFramebufferSRGBEnabledIn, const Options& optionsIn)
 {
     ZoneScopedNC("SplatRenderer::Init()", tracy::Color::Blue);
     GL_ERROR_CHECK("SplatRenderer::Init() begin");
 
     isFramebufferSRGBEnabled = isFramebufferSRGBEnabledIn;
-    useRgcSortOverride = useRgcSortOverrideIn;
+    opt = optionsIn;
+    for (int i = 0; i < MAX_SORT_VIEWS; i++)
+    {
+        sortViews[i] = SortedState();
+    }
+    numSortViews = 0;
+    numSortCalls = 0;
+    asyncUploadedSorter = nullptr;
+    sortStats = SortStats();
+    sortStaleness = SortStaleness();
+    if (tileColorTexture)
+    {
+        glDeleteTextures(1, &tileColorTexture);
+        tileColorTexture = 0;
+    }
+    tileWidth = 0;
+    tileHeight = 0;
+
+    if (opt.rasterMode == RasterMode::ComputeTiles && opt.asyncSort)
+    {
+        spdlog::warn("The compute tile rasterizer sorts on the gpu, ignoring async sort");
+        opt.asyncSort = false;
+    }
+
+    if (opt.fusedPreprocess && (opt.rasterMode == RasterMode::ComputeTiles || opt.asyncSort ||
+                                (opt.sortBackend.type == SortBackend::Type::Cpu && !opt.autotuneSort)))
+    {
+        spdlog::warn("The fused preprocess needs the gpu depth sort, ignoring it");
+        opt.fusedPreprocess = false;
+    }
+
+    // the vertex shader reads splats from shader storage with InstancedQuads, unless they were preprocessed
+    const bool vertexPulling = opt.rasterMode == RasterMode::InstancedQuads && !opt.fusedPreprocess;
+
+    // fragment atomics and storage are optional on GLES 3.1, so the overdraw counters are desktop only
+#ifdef __ANDROID__
+    const bool overdrawAvailable = false;
+#else
+    const bool overdrawAvailable = opt.rasterMode != RasterMode::ComputeTiles;
+#endif
 
     splatProg = std::make_shared<Program>();
-    if (isFramebufferSRGBEnabled || gaussianCloud->HasFullSH())
     {
-        std::string defines = "";
-        if (isFramebufferSRGBEnabled)
+        std::string defines = GetSplatDefines(gaussianCloud);
+        if (opt.rasterMode == RasterMode::ComputeTiles)
         {
-            defines += "#define FRAMEBUFFER_SRGB\n";
+            defines += "#define TILE_PROJECT\n";
         }
-        if (gaussianCloud->HasFullSH())
+        if (opt.rasterMode == RasterMode::InstancedQuads)
+        {
+            defines += "#define INSTANCED_QUADS\n";
+        }
+        if (opt.fusedPreprocess)
+        {
+            defines += "#define PREPROCESSED\n";
+        }
+        if (vertexPulling)
         {
-            defines += "#define FULL_SH\n";
+            defines += GetVertexPullingDefines(gaussianCloud);
         }
         splatProg->AddMacro("DEFINES", defines);
+        // the overdraw variant of LoadOverdrawSplatProg() adds OVERDRAW_DEBUG to these
+        splatDefines = defines;
+    }
+    if (!AddSplatCommon(splatProg.get()))
+    {
+        return false;
+    }
+
+    // these modes read or write shader storage in the vertex shader, which some GLES 3.1 drivers do not support
+    int numVertexStorageBlocks = 0;
+    if (opt.rasterMode == RasterMode::InstancedQuads)
+    {
+        numVertexStorageBlocks = 2;
+    }
+    else if (opt.rasterMode == RasterMode::ComputeTiles || opt.fusedPreprocess)
+    {
+        numVertexStorageBlocks = 1;
+    }
+    GLint maxVertexStorageBlocks = 0;
+    glGetIntegerv(GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS, &maxVertexStorageBlocks);
+    if (maxVertexStorageBlocks < numVertexStorageBlocks)
+    {
+        spdlog::error("The {} raster mode{} needs {} shader storage blocks in the vertex shader, the driver supports {}",
+                      GetRasterModeName(opt.rasterMode), opt.fusedPreprocess ? " with the fused preprocess" : "",
+                      numVertexStorageBlocks, maxVertexStorageBlocks);
+        return false;
+    }
+
+    if (opt.rasterMode == RasterMode::InstancedQuads)
+    {
+        // the vertex shader pulls the splat and computes the quad corners of splat_geom.glsl itself
+        if (!splatProg->LoadVertFrag("shaders_gs/splat_vert.glsl", "shaders_gs/splat_frag.glsl"))
+        {
+            spdlog::error("Error loading instanced splat shaders!");
+            return false;
+        }
+    }
+    else if (opt.rasterMode == RasterMode::ComputeTiles)
+    {
+        // only the vertex shader runs, it writes the projected splats for the tile rasterizer
+        if (!splatProg->LoadVertFrag("shaders_gs/splat_vert.glsl", "shaders_gs/tile_project_frag.glsl"))
+        {
+            spdlog::error("Error loading splat projection shaders!");
+            return false;
+        }
     }
-    if (!splatProg->LoadVertGeomFrag("shaders_gs/splat_vert.glsl", "shaders_gs/splat_geom.glsl", "shaders_gs/splat_frag.glsl"))
+    else if (!splatProg->LoadVertGeomFrag("shaders_gs/splat_vert.glsl", "shaders_gs/splat_geom.glsl", "shaders_gs/splat_frag.glsl"))
     {
         spdlog::error("Error loading splat shaders!");
         return false;
     }
 
+    preprocessProg = nullptr;
+    if (opt.fusedPreprocess)
+    {
+        // always pulls the splat data, whatever the raster mode
+        preprocessProg = std::make_shared<Program>();
+        preprocessProg->AddMacro("DEFINES", GetSplatDefines(gaussianCloud) + GetVertexPullingDefines(gaussianCloud));
+        if (!AddSplatCommon(preprocessProg.get()) || !preprocessProg->LoadCompute("shaders_gs/preprocess_compute.glsl"))
+        {
+            spdlog::error("Error loading preprocess compute shader!");
+            return false;
+        }
+    }
+
     preSortProg = std::make_shared<Program>();
     if (!preSortProg->LoadCompute("shaders_gs/presort_compute.glsl"))
     {
@@ -73,68 +274,239 @@ bool SplatRenderer::Init(std::shared_ptr<GaussianCloud> gaussianCloud,
         return false;
     }
 
-    bool useMultiRadixSort = !useRgcSortOverride;
+    preSortArgsProg = std::make_shared<Program>();
+    if (!preSortArgsProg->LoadCompute("shaders_gs/presort_args_compute.glsl"))
+    {
+        spdlog::error("Error loading pre-sort args compute shader!");
+        return false;
+    }
+
+    if (opt.depthKeyBits != 16 && opt.depthKeyBits != 24 && opt.depthKeyBits != 32)
+    {
+        spdlog::error("Unsupported depth key size {}, expected 16, 24 or 32 bits", opt.depthKeyBits);
+        return false;
+    }
+
+    preSortQuantizeProg = nullptr;
+    if (opt.depthKeyBits < 32)
+    {
+        preSortQuantizeProg = std::make_shared<Program>();
+        if (!preSortQuantizeProg->LoadCompute("shaders_gs/presort_quantize_compute.glsl"))
+        {
+            spdlog::error("Error loading pre-sort quantize compute shader!");
+            return false;
+        }
+    }
+
+    tileKeysProg = nullptr;
+    tileRangesProg = nullptr;
+    tileRasterProg = nullptr;
+    tileCompositeProg = nullptr;
+    compositeVao = nullptr;
+    if (opt.rasterMode == RasterMode::ComputeTiles)
+    {
+        tileKeysProg = std::make_shared<Program>();
+        if (!tileKeysProg->LoadCompute("shaders_gs/tile_keys_compute.glsl"))
+        {
+            spdlog::error("Error loading tile keys compute shader!");
+            return false;
+        }
+
+        tileRangesProg = std::make_shared<Program>();
+        if (!tileRangesProg->LoadCompute("shaders_gs/tile_ranges_compute.glsl"))
+        {
+            spdlog::error("Error loading tile ranges compute shader!");
+            return false;
+        }
+
+        tileRasterProg = std::make_shared<Program>();
+        if (!tileRasterProg->LoadCompute("shaders_gs/tile_raster_compute.glsl"))
+        {
+            spdlog::error("Error loading tile raster compute shader!");
+            return false;
+        }
+
+        tileCompositeProg = std::make_shared<Program>();
+        if (!tileCompositeProg->LoadVertFrag("shaders_gs/tile_composite_vert.glsl", "shaders_gs/tile_composite_frag.glsl"))
+        {
+            spdlog::error("Error loading tile composite shaders!");
+            return false;
+        }
+        compositeVao = std::make_shared<VertexArrayObject>();
+    }
 
-    if (useMultiRadixSort)
+    overdrawSplatProg = nullptr;
+    overdrawHistogramProg = nullptr;
+    overdrawHeatmapProg = nullptr;
+    if (overdrawAvailable)
     {
-        sortProg = std::make_shared<Program>();
-        if (!sortProg->LoadCompute("shaders_gs/multi_radixsort.glsl"))
+        overdrawHistogramProg = std::make_shared<Program>();
+        if (!overdrawHistogramProg->LoadCompute("shaders_gs/overdraw_histogram_compute.glsl"))
         {
-            spdlog::error("Error loading sort compute shader!");
+            spdlog::error("Error loading overdraw histogram compute shader!");
             return false;
         }
 
-        histogramProg = std::make_shared<Program>();
-        if (!histogramProg->LoadCompute("shaders_gs/multi_radixsort_histograms.glsl"))
+        overdrawHeatmapProg = std::make_shared<Program>();
+        if (!overdrawHeatmapProg->LoadVertFrag("shaders_gs/tile_composite_vert.glsl", "shaders_gs/overdraw_heatmap_frag.glsl"))
         {
-            spdlog::error("Error loading histogram compute shader!");
+            spdlog::error("Error loading overdraw heatmap shaders!");
             return false;
         }
+        compositeVao = std::make_shared<VertexArrayObject>();
     }
 
+    // if the cloud is still loading, all buffers are allocated for the final size and
+    // the resident splats are uploaded incrementally by UploadResidentSplats().
+    cloud = gaussianCloud;
+    progressive = gaussianCloud->IsLoading();
+
+    // the planar layout already holds the positions as a tightly packed vec4 stream, so the pre-sort
+    // reads them straight from gaussianDataBuffer instead of a separate copy in posBuffer.
+    sharedPosStream = gaussianCloud->IsPlanar() && !opt.halfPrecision;
+
     // build posVec
     size_t numGaussians = gaussianCloud->GetNumGaussians();
-    posVec.reserve(numGaussians);
-    gaussianCloud->ForEachPosWithAlpha([this](const float* pos)
+    posVec.clear();
+    if (progressive)
     {
-        posVec.emplace_back(glm::vec4(pos[0], pos[1], pos[2], 1.0f));
-    });
+        numUploaded = 0;
+        if (!sharedPosStream)
+        {
+            posVec.reserve(numGaussians);
+        }
+    }
+    else if (sharedPosStream)
+    {
+        numUploaded = numGaussians;
+    }
+    else
+    {
+        posVec.resize(numGaussians);
+        ThreadPool::Get().ParallelFor(numGaussians, POS_GRAIN_SIZE, [this, gaussianCloud](size_t begin, size_t end)
+        {
+            glm::vec4* dst = posVec.data() + begin;
+            gaussianCloud->ForEachPosWithAlphaInRange(begin, end, [&dst](const float* pos)
+            {
+                *dst++ = glm::vec4(pos[0], pos[1], pos[2], 1.0f);
+            });
+        });
+        numUploaded = numGaussians;
+    }
 
     BuildVertexArrayObject(gaussianCloud);
 
-    depthVec.resize(numGaussians);
-
-    if (useMultiRadixSort)
+    if (vertexPulling || opt.fusedPreprocess)
     {
-        spdlog::info("Using multi_radixsort.glsl");
-
-        keyBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, depthVec, GL_DYNAMIC_STORAGE_BIT);
-        keyBuffer2 = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, depthVec, GL_DYNAMIC_STORAGE_BIT);
-
-        const uint32_t NUM_ELEMENTS = static_cast<uint32_t>(numGaussians);
-        const uint32_t NUM_WORKGROUPS = (NUM_ELEMENTS + numBlocksPerWorkgroup - 1) / numBlocksPerWorkgroup;
-        const uint32_t RADIX_SORT_BINS = 256;
-
-        std::vector<uint32_t> histogramVec(NUM_WORKGROUPS * RADIX_SORT_BINS, 0);
-        histogramBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, histogramVec, GL_DYNAMIC_STORAGE_BIT);
+        GLint64 maxStorageBlockSize = 0;
+        glGetInteger64v(GL_MAX_SHADER_STORAGE_BLOCK_SIZE, &maxStorageBlockSize);
+        if ((GLint64)(numGaussians * gpuStride) > maxStorageBlockSize)
+        {
+            spdlog::error("The splat data ({} MB) is larger than the largest shader storage block ({} MB), try --half",
+                          (numGaussians * gpuStride) / 1000000, maxStorageBlockSize / 1000000);
+            return false;
+        }
+    }
 
-        valBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, indexVec, GL_DYNAMIC_STORAGE_BIT);
-        valBuffer2 = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, indexVec, GL_DYNAMIC_STORAGE_BIT);
-        posBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, posVec);
+    if (sharedPosStream)
+    {
+        posBuffer = nullptr;
+    }
+    else if (progressive)
+    {
+        posBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, nullptr, numGaussians * sizeof(glm::vec4), GL_DYNAMIC_STORAGE_BIT);
     }
     else
     {
-        spdlog::info("Using rgc::radix_sort");
-        keyBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, depthVec, GL_DYNAMIC_STORAGE_BIT);
-        valBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, indexVec, GL_DYNAMIC_STORAGE_BIT);
         posBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, posVec);
+    }
 
-        sorter = std::make_shared<rgc::radix_sort::sorter>(numGaussians);
+    // the sorted val buffer is drawn from directly, see SetSortedElementBuffer().
+    SortBackend::Params sortParams = opt.sortBackend;
+    maxSortKeys = numGaussians;
+    uint32_t numSortBytes = opt.depthKeyBits / 8;
+    if (opt.rasterMode == RasterMode::ComputeTiles)
+    {
+        // one 32 bit key per splat and overlapped tile instead of one depth key per splat
+        maxSortKeys = std::min(numGaussians * opt.avgTilesPerSplat, (size_t)std::numeric_limits<uint32_t>::max());
+        numSortBytes = 4;
+        if (sortParams.type == SortBackend::Type::Cpu && !opt.autotuneSort)
+        {
+            spdlog::warn("The compute tile rasterizer sorts on the gpu, using the {} sort", SortBackend::GetTypeName(SortBackend::Type::MultiRadix));
+            sortParams = { SortBackend::Type::MultiRadix, 0 };
+        }
+    }
+
+    if (opt.asyncSort)
+    {
+        // only the cpu sorter can run off the render thread, the backend just holds the uploaded indices
+        sortParams = { SortBackend::Type::Cpu, 0 };
+    }
+    else if (opt.autotuneSort)
+    {
+        sortParams = SortBackend::Autotune(maxSortKeys, numSortBytes, opt.sortTuneCacheFile);
     }
+    sortBackend = SortBackend::Create(sortParams);
+    if (!sortBackend || !sortBackend->Init(maxSortKeys))
+    {
+        spdlog::error("Error initializing sort backend!");
+        return false;
+    }
+    spdlog::info("Using {} sort", sortBackend->GetDescription());
+
+    SetSortedElementBuffer(sortBackend->GetValBuffer());
 
     atomicCounterVec.resize(1, 0);
     atomicCounterBuffer = std::make_shared<BufferObject>(GL_ATOMIC_COUNTER_BUFFER, atomicCounterVec, GL_DYNAMIC_STORAGE_BIT | GL_MAP_READ_BIT);
 
+    // only ever written on the gpu, read back by the debug sort check
+    indirectArgsVec.resize(sizeof(SortIndirectArgs) / sizeof(uint32_t), 0);
+    indirectArgsBuffer = std::make_shared<BufferObject>(GL_DRAW_INDIRECT_BUFFER, indirectArgsVec, GL_DYNAMIC_STORAGE_BIT | GL_MAP_READ_BIT);
+
+    // min and max depth bits, reset before every pre-sort
+    depthRangeVec = { std::numeric_limits<uint32_t>::max(), 0 };
+    depthRangeBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, depthRangeVec, GL_DYNAMIC_STORAGE_BIT);
+    validateKeyBuffer = nullptr;
+
+    projectedSplatBuffer = nullptr;
+    tileKeysOverflow = 0;
+    for (int i = 0; i < NUM_TILE_COUNT_READS; i++)
+    {
+        tileCountBuffers[i] = nullptr;
+        tileCountPending[i] = false;
+    }
+    tileCountIndex = 0;
+    if (opt.rasterMode == RasterMode::ComputeTiles)
+    {
+        projectedSplatBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, nullptr,
+                                                              std::max(numGaussians, (size_t)1) * sizeof(ProjectedSplat), 0);
+        for (int i = 0; i < NUM_TILE_COUNT_READS; i++)
+        {
+            tileCountBuffers[i] = std::make_shared<BufferObject>(GL_COPY_WRITE_BUFFER, atomicCounterVec, GL_DYNAMIC_STORAGE_BIT | GL_MAP_READ_BIT);
+        }
+    }
+
+    preprocessedSplatBuffer = nullptr;
+    if (opt.fusedPreprocess)
+    {
+        preprocessedSplatBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, nullptr,
+                                                                 std::max(numGaussians, (size_t)1) * sizeof(PreprocessedSplat), 0);
+    }
+
+    // the per pixel counts are allocated for the viewport by BeginOverdraw()
+    overdrawStats = OverdrawStats();
+    overdrawPixelVec.clear();
+    overdrawPixelBuffer = nullptr;
+    overdrawCounterBuffer = nullptr;
+    overdrawHistogramBuffer = nullptr;
+    if (overdrawHistogramProg)
+    {
+        overdrawCounterVec.assign(2, 0);
+        overdrawCounterBuffer = std::make_shared<BufferObject>(GL_ATOMIC_COUNTER_BUFFER, overdrawCounterVec, GL_DYNAMIC_STORAGE_BIT | GL_MAP_READ_BIT);
+        overdrawHistogramVec.assign(1 + OverdrawStats::NUM_BINS, 0);
+        overdrawHistogramBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, overdrawHistogramVec, GL_DYNAMIC_STORAGE_BIT | GL_MAP_READ_BIT);
+    }
+
     GL_ERROR_CHECK("SplatRenderer::Init() end");
 
     return true;
@@ -148,18 +520,101 @@ void SplatRenderer::Sort(const glm::mat4& cameraMat, const glm::mat4& projMat,
 
     GL_ERROR_CHECK("SplatRenderer::Sort() begin");
 
-    const size_t numPoints = posVec.size();
+    UploadResidentSplats();
+
+    const size_t numPoints = numUploaded;
+    if (numPoints == 0)
+    {
+        for (int i = 0; i < numSortViews; i++)
+        {
+            sortViews[i].valid = false;
+        }
+        return;
+    }
+
     glm::mat4 viewMat = glm::inverse(cameraMat);
     glm::mat4 modelViewMat = viewMat * modelMat;
+    SortedState& view = GetSortView(viewport);
+
+    if (opt.asyncSort)
+    {
+        SortAsync(view, cameraMat, projMat * modelViewMat, nearFar, numPoints);
+        return;
+    }
+
+    if (opt.rasterMode == RasterMode::ComputeTiles)
+    {
+        // the tile keys depend on the exact pose, so they are never reused
+        sortStats.numSorted++;
+        SortTiles(cameraMat, projMat, modelMat, viewport, nearFar, numPoints);
+        return;
+    }
+
+    if (CanReuseSort(view, cameraMat, projMat, modelMat, nearFar))
+    {
+        sortStats.numReused++;
+        view.numReusedSinceSort++;
+        if (view.saved)
+        {
+            RestoreSort(view);
+        }
+        return;
+    }
+    sortStats.numSorted++;
+    view.cameraMat = cameraMat;
+    view.projMat = projMat;
+    view.modelMat = modelMat;
+    view.nearFar = nearFar;
+    view.numPoints = numPoints;
+    view.valid = true;
+    view.numReusedSinceSort = 0;
+
+    if (CpuSplatSorter* cpuSorter = sortBackend->GetCpuSorter())
+    {
+        SortOnCpu(cpuSorter, projMat * modelViewMat, nearFar, numPoints);
+        FinishSort(view, numPoints);
+        return;
+    }
+
+    // quantizing depth / far into fewer than 32 bits shows artifacts on some datasets, so smaller keys
+    // quantize the visible depth range instead, see presort_quantize_compute.glsl.
+    const bool depthRangeKeys = opt.depthKeyBits < 32;
+    const uint32_t NUM_BYTES = opt.depthKeyBits / 8;
+    const uint32_t MAX_DEPTH = depthRangeKeys ? (1u << opt.depthKeyBits) - 1 : std::numeric_limits<uint32_t>::max();
+
+    if (preprocessProg)
+    {
+        ZoneScopedNC("preprocess", tracy::Color::Red4);
+
+        // writes the keys, vals, depth range and count of the pre-sort below, but only for splats that cover a pixel
+        SetSplatUniforms(preprocessProg, cameraMat, projMat, modelMat, viewport, nearFar);
+        preprocessProg->SetUniform("nearFar", nearFar);
+        preprocessProg->SetUniform("keyMax", MAX_DEPTH);
+        preprocessProg->SetUniform("numPoints", (uint32_t)numPoints);
+        preprocessProg->SetUniform("depthRangeKeys", depthRangeKeys ? 1u : 0u);
+
+        atomicCounterVec[0] = 0;
+        atomicCounterBuffer->Update(atomicCounterVec);
+
+        if (depthRangeKeys)
+        {
+            depthRangeBuffer->Update(depthRangeVec);
+        }
 
-    bool useMultiRadixSort = !useRgcSortOverride;
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, preprocessedSplatBuffer->GetObj());  // writeonly
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, gaussianDataBuffer->GetObj());  // readonly
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, sortBackend->GetKeyBuffer()->GetObj());  // writeonly
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, depthRangeBuffer->GetObj());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, sortBackend->GetValBuffer()->GetObj());  // writeonly
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, atomicCounterBuffer->GetObj());
 
-    // 24 bit radix sort still has some artifacts on some datasets, so use 32 bit sort.
-    //const uint32_t NUM_BYTES = useMultiRadixSort ? 3 : 4;
-    //const uint32_t MAX_DEPTH = useMultiRadixSort ? 16777215 : std::numeric_limits<uint32_t>::max();
-    const uint32_t NUM_BYTES = 4;
-    const uint32_t MAX_DEPTH = std::numeric_limits<uint32_t>::max();
+        const int LOCAL_SIZE = 256;
+        glDispatchCompute(((GLuint)numPoints + (LOCAL_SIZE - 1)) / LOCAL_SIZE, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
 
+        GL_ERROR_CHECK("SplatRenderer::Sort() preprocess");
+    }
+    else
     {
         ZoneScopedNC("pre-sort", tracy::Color::Red4);
 
@@ -167,14 +622,32 @@ void SplatRenderer::Sort(const glm::mat4& cameraMat, const glm::mat4& projMat,
         preSortProg->SetUniform("modelViewProj", projMat * modelViewMat);
         preSortProg->SetUniform("nearFar", nearFar);
         preSortProg->SetUniform("keyMax", MAX_DEPTH);
+        preSortProg->SetUniform("numPoints", (uint32_t)numPoints);
+        preSortProg->SetUniform("depthRangeKeys", depthRangeKeys ? 1u : 0u);
 
         // reset counter back to zero
         atomicCounterVec[0] = 0;
         atomicCounterBuffer->Update(atomicCounterVec);
 
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, posBuffer->GetObj());  // readonly
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, keyBuffer->GetObj());  // writeonly
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, valBuffer->GetObj());  // writeonly
+        if (depthRangeKeys)
+        {
+            depthRangeBuffer->Update(depthRangeVec);
+        }
+
+        if (sharedPosStream)
+        {
+            // the position stream is at the front of the planar data, see GaussianCloud::InitAttribs()
+            const size_t posOffset = cloud->GetPosWithAlphaAttrib().offset;
+            const size_t posSize = cloud->GetNumGaussians() * cloud->GetPosWithAlphaStride();
+            glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, gaussianDataBuffer->GetObj(), posOffset, posSize);  // readonly
+        }
+        else
+        {
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, posBuffer->GetObj());  // readonly
+        }
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, sortBackend->GetKeyBuffer()->GetObj());  // writeonly
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, sortBackend->GetValBuffer()->GetObj());  // writeonly
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, depthRangeBuffer->GetObj());
         glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, 4, atomicCounterBuffer->GetObj());
 
         const int LOCAL_SIZE = 256;
@@ -185,122 +658,202 @@ void SplatRenderer::Sort(const glm::mat4& cameraMat, const glm::mat4& projMat,
     }
 
     {
-        ZoneScopedNC("get-count", tracy::Color::Green);
+        ZoneScopedNC("pre-sort-args", tracy::Color::Green);
+
+        // the visible count stays on the gpu, it sizes the sort passes and the draw through indirectArgsBuffer.
+        // backends like rgc::radix_sort always sort numPoints keys, so the unused tail of the keys is pushed to the end.
+        preSortArgsProg->Bind();
+        preSortArgsProg->SetUniform("numPoints", (uint32_t)numPoints);
+        preSortArgsProg->SetUniform("keysPerWorkgroup", sortBackend->GetKeysPerWorkgroup());
+        preSortArgsProg->SetUniform("padKeys", sortBackend->NeedsPaddedKeys() ? 1u : 0u);
+        preSortArgsProg->SetUniform("quantizeLocalSize", QUANTIZE_LOCAL_SIZE);
 
-        atomicCounterBuffer->Read(atomicCounterVec);
-        sortCount = atomicCounterVec[0];
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, atomicCounterBuffer->GetObj());  // readonly
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, sortBackend->GetKeyBuffer()->GetObj());  // writeonly
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, indirectArgsBuffer->GetObj());  // writeonly
 
-        assert(sortCount <= (uint32_t)numPoints);
+        const int LOCAL_SIZE = 256;
+        const GLuint numGroups = sortBackend->NeedsPaddedKeys() ? ((GLuint)numPoints + (LOCAL_SIZE - 1)) / LOCAL_SIZE : 1;
+        glDispatchCompute(numGroups, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
 
-        GL_ERROR_CHECK("SplatRenderer::Render() get-count");
+        GL_ERROR_CHECK("SplatRenderer::Sort() pre-sort-args");
     }
 
-    if (useMultiRadixSort)
+    if (depthRangeKeys)
     {
-        ZoneScopedNC("sort", tracy::Color::Red4);
+        ZoneScopedNC("pre-sort-quantize", tracy::Color::Green);
 
-        const uint32_t NUM_ELEMENTS = static_cast<uint32_t>(sortCount);
-        const uint32_t NUM_WORKGROUPS = (NUM_ELEMENTS + numBlocksPerWorkgroup - 1) / numBlocksPerWorkgroup;
+        preSortQuantizeProg->Bind();
+        preSortQuantizeProg->SetUniform("keyMax", MAX_DEPTH);
+        preSortQuantizeProg->SetUniform("logDepth", opt.logDepthKeys ? 1u : 0u);
 
-        sortProg->Bind();
-        sortProg->SetUniform("g_num_elements", NUM_ELEMENTS);
-        sortProg->SetUniform("g_num_workgroups", NUM_WORKGROUPS);
-        sortProg->SetUniform("g_num_blocks_per_workgroup", numBlocksPerWorkgroup);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, sortBackend->GetKeyBuffer()->GetObj());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, depthRangeBuffer->GetObj());  // readonly
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, indirectArgsBuffer->GetObj());  // readonly
 
-        histogramProg->Bind();
-        histogramProg->SetUniform("g_num_elements", NUM_ELEMENTS);
-        //histogramProg->SetUniform("g_num_workgroups", NUM_WORKGROUPS);
-        histogramProg->SetUniform("g_num_blocks_per_workgroup", numBlocksPerWorkgroup);
+        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, indirectArgsBuffer->GetObj());
+        glDispatchComputeIndirect(offsetof(SortIndirectArgs, quantizeNumGroups));
+        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
 
-        for (uint32_t i = 0; i < NUM_BYTES; i++)
-        {
-            histogramProg->Bind();
-            histogramProg->SetUniform("g_shift", 8 * i);
+        GL_ERROR_CHECK("SplatRenderer::Sort() pre-sort-quantize");
+    }
 
-            if (i == 0 || i == 2)
-            {
-                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, keyBuffer->GetObj());
-            }
-            else
-            {
-                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, keyBuffer2->GetObj());
-            }
-            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, histogramBuffer->GetObj());
+    {
+        ZoneScopedNC("sort", tracy::Color::Red4);
+        sortBackend->Sort(indirectArgsBuffer, offsetof(SortIndirectArgs, sortNumGroups), NUM_BYTES, (uint32_t)numPoints);
+        GL_ERROR_CHECK("SplatRenderer::Sort() sort");
+    }
 
-            glDispatchCompute(NUM_WORKGROUPS, 1, 1);
+    // draw straight from the sorted indices
+    SetSortedElementBuffer(sortBackend->GetSortedValBuffer());
+    if (validateSort)
+    {
+        ValidateSort(sortBackend->GetSortedKeyBuffer(), numPoints);
+    }
+    glMemoryBarrier(GL_ELEMENT_ARRAY_BARRIER_BIT);
+    FinishSort(view, numPoints);
+}
 
-            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+void SplatRenderer::ValidateSort(std::shared_ptr<BufferObject> sortedKeyBuffer, size_t numPoints)
+{
+    ZoneScopedNC("validate-sort", tracy::Color::Yellow);
 
-            sortProg->Bind();
-            sortProg->SetUniform("g_shift", 8 * i);
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
 
-            if ((i % 2) == 0)  // even
-            {
-                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, keyBuffer->GetObj());
-                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, keyBuffer2->GetObj());
-                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, valBuffer->GetObj());
-                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, valBuffer2->GetObj());
-            }
-            else  // odd
-            {
-                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, keyBuffer2->GetObj());
-                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, keyBuffer->GetObj());
-                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, valBuffer2->GetObj());
-                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, valBuffer->GetObj());
-            }
-            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, histogramBuffer->GetObj());
+    indirectArgsBuffer->Read(indirectArgsVec);
+    const uint32_t sortCount = indirectArgsVec[0];
 
-            glDispatchCompute(NUM_WORKGROUPS, 1, 1);
+    // the key buffers are not mappable, so copy the sorted keys into a buffer that is
+    std::vector<uint32_t> sortedKeyVec(maxSortKeys, 0);
+    if (!validateKeyBuffer)
+    {
+        validateKeyBuffer = std::make_shared<BufferObject>(GL_COPY_WRITE_BUFFER, sortedKeyVec, GL_DYNAMIC_STORAGE_BIT | GL_MAP_READ_BIT);
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, sortedKeyBuffer->GetObj());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, validateKeyBuffer->GetObj());
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, numPoints * sizeof(uint32_t));
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    validateKeyBuffer->Read(sortedKeyVec);
 
-            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
-        }
+    GL_ERROR_CHECK("SplatRenderer::ValidateSort() READ buffer");
 
-        GL_ERROR_CHECK("SplatRenderer::Sort() sort");
+    LogSortCheck(sortedKeyVec.data(), sortCount);
+}
 
-        // indicate if keys are sorted properly or not.
-        if (false)
+void SplatRenderer::LogSortCheck(const uint32_t* sortedKeys, uint32_t sortCount) const
+{
+    // equal neighbours are splats the keys can no longer order, they grow as the key size shrinks
+    bool sorted = true;
+    uint32_t numTies = 0;
+    for (uint32_t i = 1; i < sortCount; i++)
+    {
+        if (sortedKeys[i - 1] > sortedKeys[i])
+        {
+            sorted = false;
+        }
+        else if (sortedKeys[i - 1] == sortedKeys[i])
         {
-            std::vector<uint32_t> sortedKeyVec(numPoints, 0);
-            keyBuffer->Read(sortedKeyVec);
+            numTies++;
+        }
+    }
 
-            GL_ERROR_CHECK("SplatRenderer::Sort() READ buffer");
+    spdlog::info("{} {} keys, {} equal neighbours, {} bit keys", sorted ? "o" : "x", sortCount, numTies, opt.depthKeyBits);
+}
 
-            bool sorted = true;
-            for (uint32_t i = 1; i < sortCount; i++)
-            {
-                if (sortedKeyVec[i - 1] > sortedKeyVec[i])
-                {
-                    sorted = false;
-                    break;
-                }
-            }
+void SplatRenderer::SortOnCpu(CpuSplatSorter* cpuSorter, const glm::mat4& modelViewProj, const glm::vec2& nearFar, size_t numPoints)
+{
+    ZoneScopedNC("cpu-sort", tracy::Color::Red4);
 
-            spdlog::info("{}", sorted ? "o" : "x");
-        }
-    }
-    else
+    CpuSplatSorter::Options cpuOptions;
+    cpuOptions.depthKeyBits = opt.depthKeyBits;
+    cpuOptions.logDepthKeys = opt.logDepthKeys;
+    const size_t sortCount = cpuSorter->Sort(GetCpuPositions(), numPoints, modelViewProj, nearFar, cpuOptions);
+
+    UploadSortedIndices(cpuSorter->GetSortedIndices().data(), sortCount);
+    if (validateSort)
     {
-        ZoneScopedNC("sort", tracy::Color::Red4);
-        sorter->sort(keyBuffer->GetObj(), valBuffer->GetObj(), sortCount);
-        GL_ERROR_CHECK("SplatRenderer::Sort() rgc sort");
+        LogSortCheck(cpuSorter->GetSortedKeys().data(), (uint32_t)sortCount);
     }
+}
+
+void SplatRenderer::SortAsync(SortedState& view, const glm::mat4& cameraMat, const glm::mat4& modelViewProj,
+                              const glm::vec2& nearFar, size_t numPoints)
+{
+    ZoneScopedNC("async-sort", tracy::Color::Red4);
 
+    // every view has its own worker, so the eyes in VR never draw each other's order
+    if (!view.asyncSorter)
     {
-        ZoneScopedNC("copy-sorted", tracy::Color::DarkGreen);
+        view.asyncSorter = std::make_unique<AsyncSplatSorter>();
+    }
+    AsyncSplatSorter* sorter = view.asyncSorter.get();
 
-        if (useMultiRadixSort && (NUM_BYTES % 2) == 1)  // odd
+    CpuSplatSorter::Options cpuOptions;
+    cpuOptions.depthKeyBits = opt.depthKeyBits;
+    cpuOptions.logDepthKeys = opt.logDepthKeys;
+    const uint64_t requestId = sorter->Request(GetCpuPositions(), numPoints, cameraMat, modelViewProj, nearFar, cpuOptions);
+
+    // there is nothing to draw before the first order, so wait for that one
+    const bool hasOrder = sorter->GetCurrent().requestId != 0;
+    if (sorter->AcquireNewest(!hasOrder))
+    {
+        sortStats.numSorted++;
+        const AsyncSplatSorter::Result& result = sorter->GetCurrent();
+        UploadSortedIndices(result.indices.data(), result.count);
+        asyncUploadedSorter = sorter;
+        if (validateSort)
         {
-            glBindBuffer(GL_COPY_READ_BUFFER, valBuffer2->GetObj());
+            LogSortCheck(result.keys.data(), (uint32_t)result.count);
         }
-        else
+    }
+    else
+    {
+        sortStats.numReused++;
+        if (asyncUploadedSorter != sorter)
         {
-            glBindBuffer(GL_COPY_READ_BUFFER, valBuffer->GetObj());
+            // another view uploaded its order since, so this one is uploaded again
+            const AsyncSplatSorter::Result& result = sorter->GetCurrent();
+            UploadSortedIndices(result.indices.data(), result.count);
+            asyncUploadedSorter = sorter;
         }
-        glBindBuffer(GL_COPY_WRITE_BUFFER, splatVao->GetElementBuffer()->GetObj());
-        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sortCount * sizeof(uint32_t));
-
-        GL_ERROR_CHECK("SplatRenderer::Sort() copy-sorted");
     }
+
+    const AsyncSplatSorter::Result& result = sorter->GetCurrent();
+    sortStaleness.frames = (uint32_t)(requestId - result.requestId);
+    sortStaleness.translation = glm::length(glm::vec3(cameraMat[3]) - glm::vec3(result.cameraMat[3]));
+    sortStaleness.angleDeg = CameraRotationDeg(result.cameraMat, cameraMat);
+    sortStaleness.sortSeconds = result.sortSeconds;
+}
+
+const glm::vec4* SplatRenderer::GetCpuPositions() const
+{
+    // the planar position stream of the cloud, or the copy in posVec
+    if (sharedPosStream)
+    {
+        const uint8_t* rawData = (const uint8_t*)cloud->GetRawDataPtr();
+        return (const glm::vec4*)(rawData + cloud->GetPosWithAlphaAttrib().offset);
+    }
+    return posVec.data();
+}
+
+void SplatRenderer::UploadSortedIndices(const uint32_t* sortedIndices, size_t sortCount)
+{
+    ZoneScopedNC("sort-upload", tracy::Color::Green);
+
+    if (sortCount > 0)
+    {
+        sortBackend->GetValBuffer()->Update(0, sortedIndices, sortCount * sizeof(uint32_t));
+    }
+    DrawElementsIndirectCommand draw = { (uint32_t)sortCount, 1, 0, 0, 0 };
+    indirectArgsBuffer->Update(offsetof(SortIndirectArgs, draw), &draw, sizeof(draw));
+    DrawArraysIndirectCommand quadDraw = { 4, (uint32_t)sortCount, 0, 0 };
+    indirectArgsBuffer->Update(offsetof(SortIndirectArgs, quadDraw), &quadDraw, sizeof(quadDraw));
+    SetSortedElementBuffer(sortBackend->GetValBuffer());
+
+    GL_ERROR_CHECK("SplatRenderer::UploadSortedIndices()");
 }
 
 
@@ -312,28 +865,609 @@ void SplatRenderer::Render(const glm::mat4& cameraMat, const glm::mat4& projMat,
 
     GL_ERROR_CHECK("SplatRenderer::Render() begin");
 
+    if (numUploaded == 0)
+    {
+        return;
+    }
+
+    BeginDrawTimer();
+
+    if (opt.rasterMode == RasterMode::ComputeTiles)
+    {
+        RenderTiles(viewport);
+    }
+    else
     {
         ZoneScopedNC("draw", tracy::Color::Red4);
-        float width = viewport.z;
-        float height = viewport.w;
-        float aspectRatio = width / height;
-        glm::mat4 viewMat = glm::inverse(cameraMat);
-        glm::vec3 eye = glm::vec3(cameraMat[3]);
-
-        splatProg->Bind();
-        splatProg->SetUniform("modelMat", modelMat);
-        splatProg->SetUniform("viewMat", viewMat);
-        splatProg->SetUniform("projMat", projMat);
-        splatProg->SetUniform("viewport", viewport);
-        splatProg->SetUniform("projParams", glm::vec4(0.0f, nearFar.x, nearFar.y, 0.0f));
-        splatProg->SetUniform("eye", eye);
+        // the counters of the overdraw variant have side effects that disable early depth tests, so they are
+        // only ever bound while overdrawDebug is set
+        const bool countingOverdraw = overdrawDebug && LoadOverdrawSplatProg();
+        SetSplatUniforms(countingOverdraw ? overdrawSplatProg : splatProg, cameraMat, projMat, modelMat, viewport, nearFar);
 
+        const bool countingFragments = countFragments;
+        if (countingFragments)
+        {
+            BeginFragmentCount();
+        }
+        if (countingOverdraw)
+        {
+            BeginOverdraw(viewport);
+        }
+
+        // count written by the pre-sort of this frame, see presort_args_compute.glsl
         splatVao->Bind();
-        glDrawElements(GL_POINTS, sortCount, GL_UNSIGNED_INT, nullptr);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectArgsBuffer->GetObj());
+        if (preprocessedSplatBuffer)
+        {
+            // the sorted indices point at the records of preprocess_compute.glsl
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, preprocessedSplatBuffer->GetObj());  // readonly
+        }
+        if (opt.rasterMode == RasterMode::InstancedQuads)
+        {
+            // instance i draws the splat at sorted index i
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, splatVao->GetElementBuffer()->GetObj());  // readonly
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, gaussianDataBuffer->GetObj());  // readonly
+            glDrawArraysIndirect(GL_TRIANGLE_STRIP, (const void*)offsetof(SortIndirectArgs, quadDraw));
+        }
+        else
+        {
+            glDrawElementsIndirect(GL_POINTS, GL_UNSIGNED_INT, (const void*)offsetof(SortIndirectArgs, draw));
+        }
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
         splatVao->Unbind();
 
+        if (countingFragments)
+        {
+            EndFragmentCount();
+        }
+        if (countingOverdraw)
+        {
+            EndOverdraw(viewport);
+        }
+
         GL_ERROR_CHECK("SplatRenderer::Render() draw");
     }
+
+    EndDrawTimer();
+}
+
+void SplatRenderer::BeginDrawTimer()
+{
+#ifndef __ANDROID__
+    // timestamps instead of a GL_TIME_ELAPSED query, which could not nest inside one of the caller
+    if (!drawQueries[0][0])
+    {
+        glGenQueries(NUM_DRAW_QUERIES * 2, &drawQueries[0][0]);
+    }
+
+    // the timestamps of NUM_DRAW_QUERIES calls ago are done by now, unless the gpu is that far behind
+    uint32_t* queries = drawQueries[drawQueryIndex];
+    if (drawQueryPending[drawQueryIndex])
+    {
+        GLint available = 0;
+        glGetQueryObjectiv(queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available)
+        {
+            GLuint64 start = 0, end = 0;
+            glGetQueryObjectui64v(queries[0], GL_QUERY_RESULT, &start);
+            glGetQueryObjectui64v(queries[1], GL_QUERY_RESULT, &end);
+            drawGpuMs = (end - start) / 1.0e6;
+        }
+    }
+    glQueryCounter(queries[0], GL_TIMESTAMP);
+#endif
+}
+
+void SplatRenderer::EndDrawTimer()
+{
+#ifndef __ANDROID__
+    glQueryCounter(drawQueries[drawQueryIndex][1], GL_TIMESTAMP);
+    drawQueryPending[drawQueryIndex] = true;
+    drawQueryIndex = (drawQueryIndex + 1) % NUM_DRAW_QUERIES;
+#endif
+}
+
+void SplatRenderer::BeginFragmentCount()
+{
+#ifndef __ANDROID__
+    if (!fragmentQueries[0][0])
+    {
+        glGenQueries(NUM_DRAW_QUERIES * 2, &fragmentQueries[0][0]);
+    }
+
+    // read back like the draw timer, samples passed leaves out the fragments splat_frag.glsl discarded
+    uint32_t* queries = fragmentQueries[fragmentQueryIndex];
+    if (fragmentQueryPending[fragmentQueryIndex])
+    {
+        GLint available = 0;
+        glGetQueryObjectiv(queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available)
+        {
+            GLuint64 numShaded = 0, numBlended = 0;
+            glGetQueryObjectui64v(queries[0], GL_QUERY_RESULT, &numShaded);
+            glGetQueryObjectui64v(queries[1], GL_QUERY_RESULT, &numBlended);
+            fragmentStats.numShaded = numShaded;
+            fragmentStats.numBlended = numBlended;
+        }
+    }
+    glBeginQuery(GL_FRAGMENT_SHADER_INVOCATIONS, queries[0]);
+    glBeginQuery(GL_SAMPLES_PASSED, queries[1]);
+#endif
+}
+
+void SplatRenderer::EndFragmentCount()
+{
+#ifndef __ANDROID__
+    glEndQuery(GL_SAMPLES_PASSED);
+    glEndQuery(GL_FRAGMENT_SHADER_INVOCATIONS);
+    fragmentQueryPending[fragmentQueryIndex] = true;
+    fragmentQueryIndex = (fragmentQueryIndex + 1) % NUM_DRAW_QUERIES;
+#endif
+}
+
+bool SplatRenderer::LoadOverdrawSplatProg()
+{
+    if (overdrawSplatProg)
+    {
+        return true;
+    }
+    if (!overdrawHistogramProg)
+    {
+        return false;
+    }
+
+    std::shared_ptr<Program> prog = std::make_shared<Program>();
+    prog->AddMacro("DEFINES", splatDefines + "#define OVERDRAW_DEBUG\n");
+    bool loaded = AddSplatCommon(prog.get());
+    if (loaded && opt.rasterMode == RasterMode::InstancedQuads)
+    {
+        loaded = prog->LoadVertFrag("shaders_gs/splat_vert.glsl", "shaders_gs/splat_frag.glsl");
+    }
+    else if (loaded)
+    {
+        loaded = prog->LoadVertGeomFrag("shaders_gs/splat_vert.glsl", "shaders_gs/splat_geom.glsl", "shaders_gs/splat_frag.glsl");
+    }
+
+    // splatVao was set up with the attribute locations of splatProg
+    if (loaded && !prog->HasSameAttribs(*splatProg))
+    {
+        spdlog::error("The overdraw splat shaders have different attribute locations than the splat shaders");
+        loaded = false;
+    }
+
+    if (!loaded)
+    {
+        spdlog::error("Error loading overdraw splat shaders, overdrawDebug is not available");
+        overdrawHistogramProg = nullptr;
+        overdrawHeatmapProg = nullptr;
+        return false;
+    }
+
+    overdrawSplatProg = prog;
+    return true;
+}
+
+void SplatRenderer::BeginOverdraw(const glm::vec4& viewport)
+{
+    const size_t numPixels = (size_t)std::max(viewport.z, 1.0f) * (size_t)std::max(viewport.w, 1.0f);
+    if (overdrawPixelVec.size() != numPixels)
+    {
+        overdrawPixelVec.assign(numPixels, 0);
+        overdrawPixelBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, overdrawPixelVec, GL_DYNAMIC_STORAGE_BIT);
+    }
+    else
+    {
+        overdrawPixelBuffer->Update(overdrawPixelVec);
+    }
+    overdrawCounterBuffer->Update(overdrawCounterVec);
+
+    glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, 0, overdrawCounterBuffer->GetObj());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, overdrawPixelBuffer->GetObj());
+
+    GL_ERROR_CHECK("SplatRenderer::BeginOverdraw()");
+}
+
+void SplatRenderer::EndOverdraw(const glm::vec4& viewport)
+{
+    ZoneScopedNC("overdraw", tracy::Color::Yellow);
+
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_ATOMIC_COUNTER_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    const uint32_t numPixels = (uint32_t)overdrawPixelVec.size();
+    overdrawHistogramBuffer->Update(overdrawHistogramVec);
+
+    overdrawHistogramProg->Bind();
+    overdrawHistogramProg->SetUniform("numPixels", numPixels);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, overdrawPixelBuffer->GetObj());  // readonly
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, overdrawHistogramBuffer->GetObj());
+
+    const int LOCAL_SIZE = 256;
+    glDispatchCompute((numPixels + (LOCAL_SIZE - 1)) / LOCAL_SIZE, 1, 1);
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    // opaque, so nothing of the splats below shows through the blending
+    overdrawHeatmapProg->Bind();
+    overdrawHeatmapProg->SetUniform("viewport", viewport);
+    overdrawHeatmapProg->SetUniform("maxOverdraw", overdrawHeatmapMax);
+
+    compositeVao->Bind();
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    compositeVao->Unbind();
+
+    // waits for the gpu, this is a debug mode
+    std::vector<uint32_t> counters(overdrawCounterVec.size(), 0);
+    overdrawCounterBuffer->Read(counters);
+    std::vector<uint32_t> histogram(overdrawHistogramVec.size(), 0);
+    overdrawHistogramBuffer->Read(histogram);
+
+    overdrawStats.numShaded += counters[0];
+    overdrawStats.numDiscarded += counters[1];
+    overdrawStats.maxPerPixel = std::max(overdrawStats.maxPerPixel, histogram[0]);
+    for (int i = 0; i < OverdrawStats::NUM_BINS; i++)
+    {
+        overdrawStats.histogram[i] += histogram[1 + i];
+    }
+
+    GL_ERROR_CHECK("SplatRenderer::EndOverdraw()");
+}
+
+const char* SplatRenderer::GetRasterModeName(RasterMode mode)
+{
+    switch (mode)
+    {
+    case RasterMode::GeometryShader:
+        return "geometry";
+    case RasterMode::InstancedQuads:
+        return "quads";
+    case RasterMode::ComputeTiles:
+        return "compute";
+    default:
+        return "unknown";
+    }
+}
+
+bool SplatRenderer::ParseRasterMode(const std::string& name, RasterMode* modeOut)
+{
+    for (int i = 0; i < (int)RasterMode::NumModes; i++)
+    {
+        if (name == GetRasterModeName((RasterMode)i))
+        {
+            *modeOut = (RasterMode)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string SplatRenderer::GetSplatDefines(std::shared_ptr<GaussianCloud> gaussianCloud) const
+{
+    std::string defines = "";
+    if (isFramebufferSRGBEnabled)
+    {
+        defines += "#define FRAMEBUFFER_SRGB\n";
+    }
+    if (gaussianCloud->HasFullSH())
+    {
+        defines += "#define FULL_SH\n";
+    }
+    if (opt.halfPrecision)
+    {
+        defines += "#define HALF_PRECISION\n";
+    }
+    return defines;
+}
+
+std::string SplatRenderer::GetVertexPullingDefines(std::shared_ptr<GaussianCloud> gaussianCloud) const
+{
+    // offsets of the first splat and strides, in 32 bit words of gaussianDataBuffer
+    std::string defines = "#define VERTEX_PULLING\n";
+    auto addDefine = [&defines](const char* name, size_t bytes)
+    {
+        assert((bytes % sizeof(uint32_t)) == 0);
+        defines += std::string("#define ") + name + " " + std::to_string(bytes / sizeof(uint32_t)) + "u\n";
+    };
+
+    if (opt.halfPrecision)
+    {
+        const size_t stride = GetHalfGaussianStride(*gaussianCloud);
+        addDefine("POS_OFFSET", offsetof(HalfGaussianData, posWithAlpha));
+        addDefine("R_SH0_OFFSET", offsetof(HalfGaussianData, r_sh0));
+        addDefine("G_SH0_OFFSET", offsetof(HalfGaussianData, g_sh0));
+        addDefine("B_SH0_OFFSET", offsetof(HalfGaussianData, b_sh0));
+        if (gaussianCloud->HasFullSH())
+        {
+            addDefine("R_SH1_OFFSET", offsetof(FullHalfGaussianData, r_sh1));
+            addDefine("R_SH2_OFFSET", offsetof(FullHalfGaussianData, r_sh2));
+            addDefine("R_SH3_OFFSET", offsetof(FullHalfGaussianData, r_sh3));
+            addDefine("G_SH1_OFFSET", offsetof(FullHalfGaussianData, g_sh1));
+            addDefine("G_SH2_OFFSET", offsetof(FullHalfGaussianData, g_sh2));
+            addDefine("G_SH3_OFFSET", offsetof(FullHalfGaussianData, g_sh3));
+            addDefine("B_SH1_OFFSET", offsetof(FullHalfGaussianData, b_sh1));
+            addDefine("B_SH2_OFFSET", offsetof(FullHalfGaussianData, b_sh2));
+            addDefine("B_SH3_OFFSET", offsetof(FullHalfGaussianData, b_sh3));
+        }
+        addDefine("COV3_CHOL0_OFFSET", offsetof(HalfGaussianData, cov3_chol0));
+        addDefine("COV3_CHOL1_OFFSET", offsetof(HalfGaussianData, cov3_chol1));
+        addDefine("POS_STRIDE", stride);
+        addDefine("SH0_STRIDE", stride);
+        addDefine("SH_REST_STRIDE", stride);
+        addDefine("COV3_STRIDE", stride);
+    }
+    else
+    {
+        addDefine("POS_OFFSET", gaussianCloud->GetPosWithAlphaAttrib().offset);
+        addDefine("R_SH0_OFFSET", gaussianCloud->GetR_SH0Attrib().offset);
+        addDefine("G_SH0_OFFSET", gaussianCloud->GetG_SH0Attrib().offset);
+        addDefine("B_SH0_OFFSET", gaussianCloud->GetB_SH0Attrib().offset);
+        if (gaussianCloud->HasFullSH())
+        {
+            addDefine("R_SH1_OFFSET", gaussianCloud->GetR_SH1Attrib().offset);
+            addDefine("R_SH2_OFFSET", gaussianCloud->GetR_SH2Attrib().offset);
+            addDefine("R_SH3_OFFSET", gaussianCloud->GetR_SH3Attrib().offset);
+            addDefine("G_SH1_OFFSET", gaussianCloud->GetG_SH1Attrib().offset);
+            addDefine("G_SH2_OFFSET", gaussianCloud->GetG_SH2Attrib().offset);
+            addDefine("G_SH3_OFFSET", gaussianCloud->GetG_SH3Attrib().offset);
+            addDefine("B_SH1_OFFSET", gaussianCloud->GetB_SH1Attrib().offset);
+            addDefine("B_SH2_OFFSET", gaussianCloud->GetB_SH2Attrib().offset);
+            addDefine("B_SH3_OFFSET", gaussianCloud->GetB_SH3Attrib().offset);
+        }
+        addDefine("COV3_COL0_OFFSET", gaussianCloud->GetCov3_Col0Attrib().offset);
+        addDefine("COV3_COL1_OFFSET", gaussianCloud->GetCov3_Col1Attrib().offset);
+        addDefine("COV3_COL2_OFFSET", gaussianCloud->GetCov3_Col2Attrib().offset);
+        addDefine("POS_STRIDE", gaussianCloud->GetPosWithAlphaStride());
+        addDefine("SH0_STRIDE", gaussianCloud->GetSH0Stride());
+        addDefine("SH_REST_STRIDE", gaussianCloud->GetSHRestStride());
+        addDefine("COV3_STRIDE", gaussianCloud->GetCov3Stride());
+    }
+    return defines;
+}
+
+void SplatRenderer::SetSplatUniforms(std::shared_ptr<Program> prog, const glm::mat4& cameraMat, const glm::mat4& projMat,
+                                     const glm::mat4& modelMat, const glm::vec4& viewport, const glm::vec2& nearFar)
+{
+    glm::mat4 viewMat = glm::inverse(cameraMat);
+    glm::vec3 eye = glm::vec3(cameraMat[3]);
+
+    prog->Bind();
+    prog->SetUniform("modelMat", modelMat);
+    prog->SetUniform("viewMat", viewMat);
+    prog->SetUniform("projMat", projMat);
+    prog->SetUniform("viewport", viewport);
+    prog->SetUniform("projParams", glm::vec4(0.0f, nearFar.x, nearFar.y, 0.0f));
+    prog->SetUniform("eye", eye);
+    prog->SetUniform("opacityBounds", opacityBounds ? 1u : 0u);
+}
+
+void SplatRenderer::SortTiles(const glm::mat4& cameraMat, const glm::mat4& projMat, const glm::mat4& modelMat,
+                              const glm::vec4& viewport, const glm::vec2& nearFar, size_t numPoints)
+{
+    ResizeTiles((uint32_t)viewport.z, (uint32_t)viewport.w);
+    ReadTileCount();
+    const uint32_t numTilesX = (tileWidth + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+    const uint32_t numTilesY = (tileHeight + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+
+    {
+        ZoneScopedNC("tile-project", tracy::Color::Red4);
+
+        // splat_vert.glsl does the projection, covariance and sh of the geometry shader path and writes the
+        // result to projectedSplatBuffer, nothing is rasterized
+        SetSplatUniforms(splatProg, cameraMat, projMat, modelMat, viewport, nearFar);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, projectedSplatBuffer->GetObj());  // writeonly
+
+        glEnable(GL_RASTERIZER_DISCARD);
+        splatVao->Bind();
+        glDrawArrays(GL_POINTS, 0, (GLsizei)numPoints);
+        splatVao->Unbind();
+        glDisable(GL_RASTERIZER_DISCARD);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        GL_ERROR_CHECK("SplatRenderer::SortTiles() project");
+    }
+
+    {
+        ZoneScopedNC("tile-keys", tracy::Color::Red4);
+
+        tileKeysProg->Bind();
+        tileKeysProg->SetUniform("numPoints", (uint32_t)numPoints);
+        tileKeysProg->SetUniform("maxInstances", (uint32_t)maxSortKeys);
+        tileKeysProg->SetUniform("viewport", viewport);
+        tileKeysProg->SetUniform("numTiles", glm::uvec2(numTilesX, numTilesY));
+        tileKeysProg->SetUniform("depthBits", tileDepthBits);
+        tileKeysProg->SetUniform("depthKeyMax", (1u << tileDepthBits) - 1);
+        tileKeysProg->SetUniform("nearFar", nearFar);
+        tileKeysProg->SetUniform("opacityBounds", opacityBounds ? 1u : 0u);
+
+        atomicCounterVec[0] = 0;
+        atomicCounterBuffer->Update(atomicCounterVec);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, projectedSplatBuffer->GetObj());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, sortBackend->GetKeyBuffer()->GetObj());  // writeonly
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, sortBackend->GetValBuffer()->GetObj());  // writeonly
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, atomicCounterBuffer->GetObj());
+
+        const int LOCAL_SIZE = 256;
+        glDispatchCompute(((GLuint)numPoints + (LOCAL_SIZE - 1)) / LOCAL_SIZE, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+        // the instance count includes the ones past maxInstances, ReadTileCount() checks it a few calls later
+        glBindBuffer(GL_COPY_READ_BUFFER, atomicCounterBuffer->GetObj());
+        glBindBuffer(GL_COPY_WRITE_BUFFER, tileCountBuffers[tileCountIndex]->GetObj());
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sizeof(uint32_t));
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        tileCountPending[tileCountIndex] = true;
+        tileCountIndex = (tileCountIndex + 1) % NUM_TILE_COUNT_READS;
+
+        GL_ERROR_CHECK("SplatRenderer::SortTiles() keys");
+    }
+
+    {
+        ZoneScopedNC("tile-sort-args", tracy::Color::Green);
+
+        // same args as the depth sort, the draw count is the number of tile keys
+        preSortArgsProg->Bind();
+        preSortArgsProg->SetUniform("numPoints", (uint32_t)maxSortKeys);
+        preSortArgsProg->SetUniform("keysPerWorkgroup", sortBackend->GetKeysPerWorkgroup());
+        preSortArgsProg->SetUniform("padKeys", sortBackend->NeedsPaddedKeys() ? 1u : 0u);
+        preSortArgsProg->SetUniform("quantizeLocalSize", QUANTIZE_LOCAL_SIZE);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, atomicCounterBuffer->GetObj());  // readonly
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, sortBackend->GetKeyBuffer()->GetObj());  // writeonly
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, indirectArgsBuffer->GetObj());  // writeonly
+
+        const int LOCAL_SIZE = 256;
+        const GLuint numGroups = sortBackend->NeedsPaddedKeys() ? ((GLuint)maxSortKeys + (LOCAL_SIZE - 1)) / LOCAL_SIZE : 1;
+        glDispatchCompute(numGroups, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+        GL_ERROR_CHECK("SplatRenderer::SortTiles() sort args");
+    }
+
+    {
+        ZoneScopedNC("tile-sort", tracy::Color::Red4);
+        sortBackend->Sort(indirectArgsBuffer, offsetof(SortIndirectArgs, sortNumGroups), 4, (uint32_t)maxSortKeys);
+        GL_ERROR_CHECK("SplatRenderer::SortTiles() sort");
+    }
+
+    {
+        ZoneScopedNC("tile-ranges", tracy::Color::Green);
+
+        tileRangeBuffer->Update(tileRangeVec);
+
+        tileRangesProg->Bind();
+        tileRangesProg->SetUniform("depthBits", tileDepthBits);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, sortBackend->GetSortedKeyBuffer()->GetObj());  // readonly
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, tileRangeBuffer->GetObj());  // writeonly
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, indirectArgsBuffer->GetObj());  // readonly
+
+        // one invocation per key, like presort_quantize_compute.glsl
+        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, indirectArgsBuffer->GetObj());
+        glDispatchComputeIndirect(offsetof(SortIndirectArgs, quantizeNumGroups));
+        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        GL_ERROR_CHECK("SplatRenderer::SortTiles() ranges");
+    }
+
+    if (validateSort)
+    {
+        ValidateSort(sortBackend->GetSortedKeyBuffer(), maxSortKeys);
+    }
+}
+
+void SplatRenderer::ReadTileCount()
+{
+    // the count copied NUM_TILE_COUNT_READS calls ago is done by now, unless the gpu is that far behind
+    if (!tileCountPending[tileCountIndex])
+    {
+        return;
+    }
+    tileCountPending[tileCountIndex] = false;
+
+    std::vector<uint32_t> countVec(1, 0);
+    tileCountBuffers[tileCountIndex]->Read(countVec);
+    const size_t count = countVec[0];
+    if (count <= maxSortKeys || count <= tileKeysOverflow)
+    {
+        return;
+    }
+
+    // the instances past maxSortKeys were dropped for a few frames, grow by a quarter more so a slowly
+    // rising count does not reallocate every frame
+    const size_t newMaxSortKeys = std::min(count + count / 4, (size_t)std::numeric_limits<uint32_t>::max());
+    std::shared_ptr<SortBackend> newSortBackend = SortBackend::Create(sortBackend->GetParams());
+    if (newMaxSortKeys <= maxSortKeys || !newSortBackend || !newSortBackend->Init(newMaxSortKeys))
+    {
+        spdlog::warn("{} tile keys do not fit into {}, increase avgTilesPerSplat", count, maxSortKeys);
+        tileKeysOverflow = count;
+        return;
+    }
+
+    spdlog::info("Growing the tile keys from {} to {}", maxSortKeys, newMaxSortKeys);
+    sortBackend = newSortBackend;
+    maxSortKeys = newMaxSortKeys;
+    validateKeyBuffer = nullptr;
+    SetSortedElementBuffer(sortBackend->GetValBuffer());
+}
+
+void SplatRenderer::RenderTiles(const glm::vec4& viewport)
+{
+    {
+        ZoneScopedNC("tile-raster", tracy::Color::Red4);
+
+        const uint32_t numTilesX = (tileWidth + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+        const uint32_t numTilesY = (tileHeight + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+
+        tileRasterProg->Bind();
+        tileRasterProg->SetUniform("numTiles", glm::uvec2(numTilesX, numTilesY));
+        tileRasterProg->SetUniform("viewportSize", glm::uvec2(tileWidth, tileHeight));
+
+        glBindImageTexture(0, tileColorTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, projectedSplatBuffer->GetObj());  // readonly
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, sortBackend->GetSortedValBuffer()->GetObj());  // readonly
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, tileRangeBuffer->GetObj());  // readonly
+
+        glDispatchCompute(numTilesX, numTilesY, 1);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+        GL_ERROR_CHECK("SplatRenderer::RenderTiles() raster");
+    }
+
+    {
+        ZoneScopedNC("tile-composite", tracy::Color::Red4);
+
+        tileCompositeProg->Bind();
+        tileCompositeProg->SetUniform("viewport", viewport);
+        tileCompositeProg->SetUniform("tileColor", 0);
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, tileColorTexture);
+        compositeVao->Bind();
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        compositeVao->Unbind();
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        GL_ERROR_CHECK("SplatRenderer::RenderTiles() composite");
+    }
+}
+
+void SplatRenderer::ResizeTiles(uint32_t width, uint32_t height)
+{
+    width = std::max(width, 1u);
+    height = std::max(height, 1u);
+    if (width == tileWidth && height == tileHeight)
+    {
+        return;
+    }
+    tileWidth = width;
+    tileHeight = height;
+
+    const uint32_t numTiles = ((width + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE) * ((height + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE);
+    tileRangeVec.assign(numTiles * 2, 0);
+    tileRangeBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, tileRangeVec, GL_DYNAMIC_STORAGE_BIT);
+
+    // the tile index takes the bits it needs, the rest of the 32 bit key is depth
+    uint32_t tileBits = 1;
+    while ((1u << tileBits) < numTiles)
+    {
+        tileBits++;
+    }
+    tileDepthBits = 32 - tileBits;
+
+    if (tileColorTexture)
+    {
+        glDeleteTextures(1, &tileColorTexture);
+    }
+    glGenTextures(1, &tileColorTexture);
+    glBindTexture(GL_TEXTURE_2D, tileColorTexture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA16F, width, height);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    spdlog::debug("Tile rasterizer: {}x{} pixels, {} tiles, {} bit depth keys", width, height, numTiles, tileDepthBits);
+
+    GL_ERROR_CHECK("SplatRenderer::ResizeTiles()");
 }
 
 void SplatRenderer::BuildVertexArrayObject(std::shared_ptr<GaussianCloud> gaussianCloud)
@@ -341,45 +1475,269 @@ void SplatRenderer::BuildVertexArrayObject(std::shared_ptr<GaussianCloud> gaussi
     splatVao = std::make_shared<VertexArrayObject>();
 
     // allocate large buffer to hold interleaved vertex data
-    gaussianDataBuffer = std::make_shared<BufferObject>(GL_ARRAY_BUFFER,
-                                                        gaussianCloud->GetRawDataPtr(),
-                                                        gaussianCloud->GetTotalSize(), 0);
-
     const size_t numGaussians = gaussianCloud->GetNumGaussians();
-
-    // build element array
-    indexVec.reserve(numGaussians);
-    assert(numGaussians <= std::numeric_limits<uint32_t>::max());
-    for (uint32_t i = 0; i < (uint32_t)numGaussians; i++)
+    gpuStride = opt.halfPrecision ? GetHalfGaussianStride(*gaussianCloud) : gaussianCloud->GetStride();
+    if (progressive || opt.halfPrecision)
     {
-        indexVec.push_back(i);
+        gaussianDataBuffer = std::make_shared<BufferObject>(GL_ARRAY_BUFFER, nullptr,
+                                                            numGaussians * gpuStride, GL_DYNAMIC_STORAGE_BIT);
+        if (!progressive)
+        {
+            UploadSplatData(0, numGaussians);
+        }
+    }
+    else
+    {
+        gaussianDataBuffer = std::make_shared<BufferObject>(GL_ARRAY_BUFFER,
+                                                            gaussianCloud->GetRawDataPtr(),
+                                                            gaussianCloud->GetTotalSize(), 0);
+    }
+    spdlog::info("Splat data uses {:.1f} MB on the gpu ({} bytes per splat{}{})", (numGaussians * gpuStride) / 1.0e6,
+                 gpuStride, opt.halfPrecision ? ", half precision" : "", sharedPosStream ? ", planar" : "");
+    if (opt.rasterMode == RasterMode::InstancedQuads || opt.fusedPreprocess)
+    {
+        // splat_vert.glsl reads the splat data or the preprocessed splats as shader storage, the vao has no attributes
+        return;
     }
-    auto indexBuffer = std::make_shared<BufferObject>(GL_ELEMENT_ARRAY_BUFFER, indexVec, GL_DYNAMIC_STORAGE_BIT);
 
     splatVao->Bind();
     gaussianDataBuffer->Bind();
 
-    const size_t stride = gaussianCloud->GetStride();
-    SetupAttrib(splatProg->GetAttribLoc("position"), gaussianCloud->GetPosWithAlphaAttrib(), 4, stride);
-    SetupAttrib(splatProg->GetAttribLoc("r_sh0"), gaussianCloud->GetR_SH0Attrib(), 4, stride);
-    SetupAttrib(splatProg->GetAttribLoc("g_sh0"), gaussianCloud->GetG_SH0Attrib(), 4, stride);
-    SetupAttrib(splatProg->GetAttribLoc("b_sh0"), gaussianCloud->GetB_SH0Attrib(), 4, stride);
-    if (gaussianCloud->HasFullSH())
+    if (opt.halfPrecision)
+    {
+        const size_t stride = gpuStride;
+        BinaryAttribute posWithAlphaAttrib(BinaryAttribute::Type::Float, offsetof(HalfGaussianData, posWithAlpha));
+        SetupAttrib(splatProg->GetAttribLoc("position"), posWithAlphaAttrib, 4, stride);
+        SetupHalfAttrib(splatProg->GetAttribLoc("r_sh0"), offsetof(HalfGaussianData, r_sh0), 4, stride);
+        SetupHalfAttrib(splatProg->GetAttribLoc("g_sh0"), offsetof(HalfGaussianData, g_sh0), 4, stride);
+        SetupHalfAttrib(splatProg->GetAttribLoc("b_sh0"), offsetof(HalfGaussianData, b_sh0), 4, stride);
+        if (gaussianCloud->HasFullSH())
+        {
+            SetupHalfAttrib(splatProg->GetAttribLoc("r_sh1"), offsetof(FullHalfGaussianData, r_sh1), 4, stride);
+            SetupHalfAttrib(splatProg->GetAttribLoc("r_sh2"), offsetof(FullHalfGaussianData, r_sh2), 4, stride);
+            SetupHalfAttrib(splatProg->GetAttribLoc("r_sh3"), offsetof(FullHalfGaussianData, r_sh3), 4, stride);
+            SetupHalfAttrib(splatProg->GetAttribLoc("g_sh1"), offsetof(FullHalfGaussianData, g_sh1), 4, stride);
+            SetupHalfAttrib(splatProg->GetAttribLoc("g_sh2"), offsetof(FullHalfGaussianData, g_sh2), 4, stride);
+            SetupHalfAttrib(splatProg->GetAttribLoc("g_sh3"), offsetof(FullHalfGaussianData, g_sh3), 4, stride);
+            SetupHalfAttrib(splatProg->GetAttribLoc("b_sh1"), offsetof(FullHalfGaussianData, b_sh1), 4, stride);
+            SetupHalfAttrib(splatProg->GetAttribLoc("b_sh2"), offsetof(FullHalfGaussianData, b_sh2), 4, stride);
+            SetupHalfAttrib(splatProg->GetAttribLoc("b_sh3"), offsetof(FullHalfGaussianData, b_sh3), 4, stride);
+        }
+        SetupHalfAttrib(splatProg->GetAttribLoc("cov3_chol0"), offsetof(HalfGaussianData, cov3_chol0), 4, stride);
+        SetupHalfAttrib(splatProg->GetAttribLoc("cov3_chol1"), offsetof(HalfGaussianData, cov3_chol1), 4, stride);
+    }
+    else
     {
-        SetupAttrib(splatProg->GetAttribLoc("r_sh1"), gaussianCloud->GetR_SH1Attrib(), 4, stride);
-        SetupAttrib(splatProg->GetAttribLoc("r_sh2"), gaussianCloud->GetR_SH2Attrib(), 4, stride);
-        SetupAttrib(splatProg->GetAttribLoc("r_sh3"), gaussianCloud->GetR_SH3Attrib(), 4, stride);
-        SetupAttrib(splatProg->GetAttribLoc("g_sh1"), gaussianCloud->GetG_SH1Attrib(), 4, stride);
-        SetupAttrib(splatProg->GetAttribLoc("g_sh2"), gaussianCloud->GetG_SH2Attrib(), 4, stride);
-        SetupAttrib(splatProg->GetAttribLoc("g_sh3"), gaussianCloud->GetG_SH3Attrib(), 4, stride);
-        SetupAttrib(splatProg->GetAttribLoc("b_sh1"), gaussianCloud->GetB_SH1Attrib(), 4, stride);
-        SetupAttrib(splatProg->GetAttribLoc("b_sh2"), gaussianCloud->GetB_SH2Attrib(), 4, stride);
-        SetupAttrib(splatProg->GetAttribLoc("b_sh3"), gaussianCloud->GetB_SH3Attrib(), 4, stride);
-    }
-    SetupAttrib(splatProg->GetAttribLoc("cov3_col0"), gaussianCloud->GetCov3_Col0Attrib(), 3, stride);
-    SetupAttrib(splatProg->GetAttribLoc("cov3_col1"), gaussianCloud->GetCov3_Col1Attrib(), 3, stride);
-    SetupAttrib(splatProg->GetAttribLoc("cov3_col2"), gaussianCloud->GetCov3_Col2Attrib(), 3, stride);
-
-    splatVao->SetElementBuffer(indexBuffer);
+        // each attrib steps with the stride of its stream, which is gpuStride unless the cloud is planar
+        const size_t posStride = gaussianCloud->GetPosWithAlphaStride();
+        const size_t sh0Stride = gaussianCloud->GetSH0Stride();
+        const size_t shRestStride = gaussianCloud->GetSHRestStride();
+        const size_t cov3Stride = gaussianCloud->GetCov3Stride();
+        SetupAttrib(splatProg->GetAttribLoc("position"), gaussianCloud->GetPosWithAlphaAttrib(), 4, posStride);
+        SetupAttrib(splatProg->GetAttribLoc("r_sh0"), gaussianCloud->GetR_SH0Attrib(), 4, sh0Stride);
+        SetupAttrib(splatProg->GetAttribLoc("g_sh0"), gaussianCloud->GetG_SH0Attrib(), 4, sh0Stride);
+        SetupAttrib(splatProg->GetAttribLoc("b_sh0"), gaussianCloud->GetB_SH0Attrib(), 4, sh0Stride);
+        if (gaussianCloud->HasFullSH())
+        {
+            SetupAttrib(splatProg->GetAttribLoc("r_sh1"), gaussianCloud->GetR_SH1Attrib(), 4, shRestStride);
+            SetupAttrib(splatProg->GetAttribLoc("r_sh2"), gaussianCloud->GetR_SH2Attrib(), 4, shRestStride);
+            SetupAttrib(splatProg->GetAttribLoc("r_sh3"), gaussianCloud->GetR_SH3Attrib(), 4, shRestStride);
+            SetupAttrib(splatProg->GetAttribLoc("g_sh1"), gaussianCloud->GetG_SH1Attrib(), 4, shRestStride);
+            SetupAttrib(splatProg->GetAttribLoc("g_sh2"), gaussianCloud->GetG_SH2Attrib(), 4, shRestStride);
+            SetupAttrib(splatProg->GetAttribLoc("g_sh3"), gaussianCloud->GetG_SH3Attrib(), 4, shRestStride);
+            SetupAttrib(splatProg->GetAttribLoc("b_sh1"), gaussianCloud->GetB_SH1Attrib(), 4, shRestStride);
+            SetupAttrib(splatProg->GetAttribLoc("b_sh2"), gaussianCloud->GetB_SH2Attrib(), 4, shRestStride);
+            SetupAttrib(splatProg->GetAttribLoc("b_sh3"), gaussianCloud->GetB_SH3Attrib(), 4, shRestStride);
+        }
+        SetupAttrib(splatProg->GetAttribLoc("cov3_col0"), gaussianCloud->GetCov3_Col0Attrib(), 3, cov3Stride);
+        SetupAttrib(splatProg->GetAttribLoc("cov3_col1"), gaussianCloud->GetCov3_Col1Attrib(), 3, cov3Stride);
+        SetupAttrib(splatProg->GetAttribLoc("cov3_col2"), gaussianCloud->GetCov3_Col2Attrib(), 3, cov3Stride);
+    }
+
     gaussianDataBuffer->Unbind();
+    splatVao->Unbind();
+}
+
+bool SplatRenderer::CanReuseSort(const SortedState& view, const glm::mat4& cameraMat, const glm::mat4& projMat,
+                                 const glm::mat4& modelMat, const glm::vec2& nearFar) const
+{
+    // the preprocessed splats hold screen space positions, so they are only valid for the pose they were made for
+    if (!sortReuse.enabled || opt.fusedPreprocess || !view.valid || view.numPoints != numUploaded ||
+        view.projMat != projMat || view.modelMat != modelMat || view.nearFar != nearFar)
+    {
+        return false;
+    }
+    if (sortReuse.maxFrames > 0 && view.numReusedSinceSort >= sortReuse.maxFrames)
+    {
+        return false;
+    }
+
+    if (glm::length(glm::vec3(cameraMat[3]) - glm::vec3(view.cameraMat[3])) > sortReuse.maxTranslation)
+    {
+        return false;
+    }
+
+    return CameraRotationDeg(view.cameraMat, cameraMat) <= sortReuse.maxAngleDeg;
+}
+
+SplatRenderer::SortedState& SplatRenderer::GetSortView(const glm::vec4& viewport)
+{
+    numSortCalls++;
+
+    // views that were not drawn in the last MAX_SORT_VIEWS calls are gone, like the old size of a resized window
+    int numLive = 0;
+    for (int i = 0; i < numSortViews; i++)
+    {
+        if (numSortCalls - sortViews[i].lastUse <= (uint64_t)MAX_SORT_VIEWS)
+        {
+            if (numLive != i)
+            {
+                std::swap(sortViews[numLive], sortViews[i]);
+            }
+            numLive++;
+        }
+    }
+    numSortViews = numLive;
+
+    int slot = -1;
+    for (int i = 0; i < numSortViews; i++)
+    {
+        if (sortViews[i].viewport == viewport)
+        {
+            slot = i;
+        }
+    }
+    if (slot < 0)
+    {
+        // more views than slots replace the least recently used one, they just never reuse a sort
+        if (numSortViews < MAX_SORT_VIEWS)
+        {
+            slot = numSortViews++;
+        }
+        else
+        {
+            slot = sortViews[0].lastUse <= sortViews[1].lastUse ? 0 : 1;
+        }
+        // the buffers and the async worker of the old view are kept, its saved order is not
+        std::shared_ptr<BufferObject> valBuffer = sortViews[slot].valBuffer;
+        std::shared_ptr<BufferObject> argsBuffer = sortViews[slot].argsBuffer;
+        std::unique_ptr<AsyncSplatSorter> asyncSorter = std::move(sortViews[slot].asyncSorter);
+        sortViews[slot] = SortedState();
+        sortViews[slot].viewport = viewport;
+        sortViews[slot].valBuffer = valBuffer;
+        sortViews[slot].argsBuffer = argsBuffer;
+        sortViews[slot].asyncSorter = std::move(asyncSorter);
+    }
+    sortViews[slot].lastUse = numSortCalls;
+    return sortViews[slot];
+}
+
+void SplatRenderer::FinishSort(SortedState& view, size_t numPoints)
+{
+    // the sort backend only holds the order of the view sorted last, the other views keep theirs if it was saved
+    for (int i = 0; i < numSortViews; i++)
+    {
+        if (&sortViews[i] != &view && !sortViews[i].saved)
+        {
+            sortViews[i].valid = false;
+        }
+    }
+
+    // a single view draws straight from the sort backend, so the copies are only made for several views
+    view.saved = false;
+    if (!sortReuse.enabled || opt.fusedPreprocess || numSortViews < 2)
+    {
+        return;
+    }
+
+    ZoneScopedNC("save-sort", tracy::Color::Green);
+
+    if (!view.valBuffer)
+    {
+        const size_t valSize = std::max(maxSortKeys, (size_t)1) * sizeof(uint32_t);
+        view.valBuffer = std::make_shared<BufferObject>(GL_ELEMENT_ARRAY_BUFFER, nullptr, valSize, 0);
+        view.argsBuffer = std::make_shared<BufferObject>(GL_DRAW_INDIRECT_BUFFER, nullptr, sizeof(SortIndirectArgs), 0);
+    }
+
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_COPY_READ_BUFFER, splatVao->GetElementBuffer()->GetObj());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, view.valBuffer->GetObj());
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, numPoints * sizeof(uint32_t));
+    glBindBuffer(GL_COPY_READ_BUFFER, indirectArgsBuffer->GetObj());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, view.argsBuffer->GetObj());
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sizeof(SortIndirectArgs));
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    view.saved = true;
+
+    GL_ERROR_CHECK("SplatRenderer::FinishSort()");
+}
+
+void SplatRenderer::RestoreSort(const SortedState& view)
+{
+    // draw from the saved indices, with the draw count of the sort that made them
+    SetSortedElementBuffer(view.valBuffer);
+    glBindBuffer(GL_COPY_READ_BUFFER, view.argsBuffer->GetObj());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, indirectArgsBuffer->GetObj());
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sizeof(SortIndirectArgs));
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    GL_ERROR_CHECK("SplatRenderer::RestoreSort()");
+}
+
+void SplatRenderer::SetSortedElementBuffer(std::shared_ptr<BufferObject> sortedValBuffer)
+{
+    if (splatVao->GetElementBuffer() != sortedValBuffer)
+    {
+        splatVao->SetElementBuffer(sortedValBuffer);
+    }
+}
+
+void SplatRenderer::UploadResidentSplats()
+{
+    size_t numResident = cloud->GetNumResidentGaussians();
+    if (numResident <= numUploaded)
+    {
+        return;
+    }
+
+    ZoneScopedNC("upload-resident", tracy::Color::DarkGreen);
+
+    UploadSplatData(numUploaded, numResident);
+
+    if (!sharedPosStream)
+    {
+        cloud->ForEachPosWithAlphaInRange(numUploaded, numResident, [this](const float* pos)
+        {
+            posVec.emplace_back(glm::vec4(pos[0], pos[1], pos[2], 1.0f));
+        });
+        posBuffer->Update(numUploaded * sizeof(glm::vec4), &posVec[numUploaded], (numResident - numUploaded) * sizeof(glm::vec4));
+    }
+
+    numUploaded = numResident;
+
+    GL_ERROR_CHECK("SplatRenderer::UploadResidentSplats()");
+}
+
+void SplatRenderer::UploadSplatData(size_t begin, size_t end)
+{
+    if (!opt.halfPrecision)
+    {
+        const uint8_t* rawPtr = (const uint8_t*)cloud->GetRawDataPtr();
+        cloud->ForEachDataRange(begin, end, [this, rawPtr](size_t offset, size_t size)
+        {
+            gaussianDataBuffer->Update(offset, rawPtr + offset, size);
+        });
+        return;
+    }
+
+    ZoneScopedNC("pack-half", tracy::Color::DarkGreen);
+
+    std::vector<uint8_t> halfData((end - begin) * gpuStride);
+    ThreadPool::Get().ParallelFor(end - begin, POS_GRAIN_SIZE, [this, begin, &halfData](size_t rangeBegin, size_t rangeEnd)
+    {
+        PackHalfGaussians(*cloud, begin + rangeBegin, begin + rangeEnd, halfData.data() + rangeBegin * gpuStride);
+    });
+    gaussianDataBuffer->Update(begin * gpuStride, halfData.data(), halfData.size());
 }
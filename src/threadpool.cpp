@@ -0,0 +1,142 @@
+#include <threadpool.h>
+
+#include <algorithm>
+
+#ifdef TRACY_ENABLE
+#include <tracy/Tracy.hpp>
+#else
+#define ZoneScoped
+#define ZoneScopedNC(NAME, COLOR)
+#endif
+
+// true while a thread is executing chunks of a ParallelFor() job.
+static thread_local bool insideJob = false;
+
+ThreadPool::ThreadPool(uint32_t numThreadsIn) :
+    numWaitingCallers(0),
+    jobCb(nullptr),
+    jobCount(0),
+    jobGrainSize(1),
+    nextChunk(0),
+    jobId(0),
+    activeWorkers(0),
+    quit(false)
+{
+    uint32_t numThreads = numThreadsIn ? numThreadsIn : std::max(1u, std::thread::hardware_concurrency());
+    workers.reserve(numThreads - 1);
+    for (uint32_t i = 1; i < numThreads; i++)
+    {
+        workers.emplace_back(&ThreadPool::WorkerMain, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wakeCv.notify_all();
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+}
+
+ThreadPool& ThreadPool::Get()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::ParallelFor(size_t count, size_t grainSize, const RangeCallback& cb)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    grainSize = std::max<size_t>(grainSize, 1);
+    if (insideJob || workers.empty() || count <= grainSize)
+    {
+        cb(0, count);
+        return;
+    }
+
+    ZoneScopedNC("ThreadPool::ParallelFor", tracy::Color::Orange);
+
+    numWaitingCallers++;
+    std::lock_guard<std::mutex> jobLock(jobMutex);
+    numWaitingCallers--;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobCb = &cb;
+        jobCount = count;
+        jobGrainSize = grainSize;
+        nextChunk = 0;
+        jobId++;
+    }
+    wakeCv.notify_all();
+
+    RunChunks();
+
+    // wait for workers still finishing their last chunk, then retire the job,
+    // so late-waking workers never see a dangling callback.
+    std::unique_lock<std::mutex> lock(mutex);
+    doneCv.wait(lock, [this]() { return activeWorkers == 0; });
+    jobCb = nullptr;
+}
+
+void ThreadPool::WaitForOtherCallers() const
+{
+    // the waiting callers get jobMutex as soon as the current job is done, so this never spins for long
+    while (numWaitingCallers.load() > 0)
+    {
+        std::this_thread::yield();
+    }
+}
+
+void ThreadPool::WorkerMain()
+{
+    uint64_t seenJobId = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeCv.wait(lock, [this, seenJobId]() { return quit || jobId != seenJobId; });
+            if (quit)
+            {
+                return;
+            }
+            seenJobId = jobId;
+            if (!jobCb)
+            {
+                continue;
+            }
+            activeWorkers++;
+        }
+
+        RunChunks();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            activeWorkers--;
+        }
+        doneCv.notify_one();
+    }
+}
+
+void ThreadPool::RunChunks()
+{
+    insideJob = true;
+    const size_t numChunks = (jobCount + jobGrainSize - 1) / jobGrainSize;
+    size_t chunk;
+    while ((chunk = nextChunk.fetch_add(1)) < numChunks)
+    {
+        size_t begin = chunk * jobGrainSize;
+        size_t end = std::min(begin + jobGrainSize, jobCount);
+        (*jobCb)(begin, end);
+    }
+    insideJob = false;
+}
@@ -156,6 +156,13 @@ void BufferObject::Update(const std::vector<uint32_t>& data)
 	Unbind();
 }
 
+void BufferObject::Update(size_t offset, const void* data, size_t size)
+{
+	Bind();
+    glBufferSubData(target, offset, size, data);
+	Unbind();
+}
+
 void BufferObject::Read(std::vector<uint32_t>& data)
 {
 	Bind();